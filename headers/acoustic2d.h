@@ -7,8 +7,22 @@
 #include "petscmat.h"
 #include "fem/dof_handler.h"
 #include "fem/csr_pattern.h"
+#include "fem/function.h"
+#include "csr_assembler.h"
+#include "dof_renumbering.h"
+#include "async_writer.h"
+#include "solution_file.h"
+#include "vtk_series.h"
+#include "output_window.h"
+#include "receivers.h"
+#include "parameters.h"
 
-class Parameters;
+class LeapfrogOperator;
+class Q1Stencil;
+class DoFPartition;
+class StripPartition;
+class MeshPartition;
+class SeparableFunction;
 
 
 class Acoustic2D
@@ -26,11 +40,33 @@ public:
   ~Acoustic2D();
 
             /**
-             * The main function launching the calculations
+             * The main function launching the calculations.
+             * In a distributed run the cells and the dofs of the triangular mesh
+             * are distributed between MPI processes (see MeshPartition)
              */
   void solve_triangles();
   void solve_rectangles();
 
+            /**
+             * Solve the problem on the rectangular grid by several MPI processes.
+             * The grid is split into horizontal strips (see StripPartition), and each process
+             * creates only its strip of the mesh, the coefficients of its cells, its rows
+             * of the distributed (MPIAIJ) matrices and its part of the ghosted vectors.
+             * The explicit scheme is used
+             */
+  void solve_rectangles_distributed();
+
+            /**
+             * Impose the Dirichlet boundary condition on the system matrix (with ones on diagonal).
+             * In case of symmetric storage the columns of the boundary nodes are zeroed too
+             * (the values of the boundary nodes must be zero then), and the matrix
+             * is converted to the symmetric format (MATSEQSBAIJ) keeping the upper triangular part only
+             * @param b_nodes - the list of boundary nodes
+             * @param symmetric_storage - whether the matrix is converted to the symmetric format
+             * @param system_mat - the matrix (it's replaced by a new one in case of symmetric storage)
+             */
+  static void dirichlet_matrix(const std::vector<int> &b_nodes, bool symmetric_storage, Mat *system_mat);
+
 
 private:
             /**
@@ -68,6 +104,85 @@ private:
              */
   std::vector<double> _coef_beta;
 
+            /**
+             * Matrix-free mass and stiffness operators of the rectangular grid.
+             * It's used instead of the global matrices if MATRIX_FREE parameter is true,
+             * otherwise it's NULL
+             */
+  Q1Stencil *_stencil;
+
+            /**
+             * The assembler keeping the arrays of the global matrices (they are created
+             * over these arrays without copying). It's NULL if the matrices are not assembled
+             */
+  CSRAssembler *_assembler;
+
+            /**
+             * The permutation of the dofs applied to the global matrices and vectors
+             */
+  DoFRenumbering _renumbering;
+
+            /**
+             * The vector in the original numbering of the dofs used for the output
+             * (it's NULL if the dofs are not renumbered)
+             */
+  Vec _natural_vec;
+
+            /**
+             * The partition of the grid between MPI processes in a distributed run
+             * (NULL otherwise). In this case _fmesh is the strip of this process
+             */
+  StripPartition *_partition;
+
+            /**
+             * The partition of the triangular mesh between MPI processes in a distributed run
+             * (NULL otherwise). In this case _fmesh is the whole mesh, and _renumbering
+             * is the numbering of the dofs of the partition
+             */
+  MeshPartition *_mesh_partition;
+
+            /**
+             * The asynchronous output of the time loop (see start_output).
+             * It's NULL if the results are written synchronously
+             */
+  AsyncWriter *_output;
+
+            /**
+             * The binary file with the snapshots of the solution of the time loop
+             * (see open_solution_file). It's NULL if the solutions are saved into text files
+             */
+  SolutionWriter *_sol_writer;
+
+            /**
+             * The binary VTK files of the time loop on the rectangular grid (see open_vtk_series).
+             * It's NULL if the results are written by fem::Result
+             */
+  VTKSeries *_vtk_series;
+
+            /**
+             * The part of the rectangular grid saved by the output (see setup_output_window).
+             * It's NULL if the whole grid is saved
+             */
+  OutputWindow *_window;
+
+            /**
+             * The positions of the vertices of the output window in the vectors saved into
+             * the solution files and into the VTK series (see open_solution_file and open_vtk_series)
+             */
+  std::vector<unsigned int> _sol_vertices, _vtk_vertices;
+
+            /**
+             * The position of the first value written into the VTK series without the output window
+             * (the values of the ghost rows below the strip are skipped)
+             */
+  unsigned int _vtk_shift;
+
+            /**
+             * The receivers recording the solution on every time step of the time loop
+             * (see setup_receivers). It's NULL if there are no receivers
+             */
+  Receivers *_receivers;
+
   Acoustic2D(const Acoustic2D&); /** copy constructor */
   Acoustic2D& operator=(const Acoustic2D&); /** copy assignment operator */
 
@@ -77,10 +192,389 @@ private:
              */
   //void find_bound_nodes(std::vector<int> &b_nodes) const;
 
-  void solve_explicit_triangles(const fem::DoFHandler &dof_handler, const fem::CSRPattern &csr_pattern);
-  void solve_explicit_rectangles(const fem::DoFHandler &dof_handler, const fem::CSRPattern &csr_pattern);
+            /**
+             * Assemble the global mass and stiffness matrices with the given sparse pattern
+             * in the numbering of the dofs defined by renumber_dofs.
+             * The same code is used for all types of cells (Triangle, Rectangle)
+             * @param cells - the cells of the mesh
+             * @param csr_pattern - the sparse pattern of the matrices
+             * @param coef_alpha - the coefficients of the mass matrix (one per cell)
+             * @param coef_beta - the coefficients of the stiffness matrix (one per cell)
+             */
+  template <class Cell>
+  void assemble_matrices(const std::vector<Cell> &cells, const fem::CSRPattern &csr_pattern,
+                         const double *coef_alpha, const double *coef_beta);
+
+            /**
+             * Compute the renumbering of the dofs chosen by the parameters (DOF_ORDERING).
+             * It should be called before the assembling of the matrices
+             * @param dof_handler - the handler of degrees of freedom
+             * @param csr_pattern - the sparse pattern in the original numbering
+             */
+  void renumber_dofs(const fem::DoFHandler &dof_handler, const fem::CSRPattern &csr_pattern);
+
+            /**
+             * Fill up the coefficients of the cells of the rectangular grid according to the parameters:
+             * import them from a file, distribute them according to the layers file,
+             * or take the values of the main domain and the inclusion
+             */
+  void setup_coefficients();
+
+            /**
+             * The limits of the whole domain. They are the limits of the mesh,
+             * except a distributed run, where the mesh is only a strip of the domain
+             */
+  void domain_limits(fem::Point &min_point, fem::Point &max_point) const;
+
+            /**
+             * The vector in the original numbering of the dofs (for the output).
+             * If the dofs are renumbered, the values are copied into _natural_vec
+             */
+  Vec natural_order(Vec x) const;
+
+            /**
+             * Launch the time loop of the scheme chosen by the parameters
+             */
+  void solve(const fem::DoFHandler &dof_handler, const fem::CSRPattern &csr_pattern);
+
+            /**
+             * Explicit scheme (for both triangular and rectangular meshes)
+             */
+  void solve_explicit(const fem::DoFHandler &dof_handler);
+
+            /**
+             * Implicit (Crank-Nicolson like) scheme. The system matrix is constant,
+             * and it's factorized only once before the time loop
+             */
   void solve_crank_nicolson(const fem::DoFHandler &dof_handler, const fem::CSRPattern &csr_pattern);
 
+            /**
+             * Distribute the triangular mesh between MPI processes (see MeshPartition),
+             * create the ghosted vectors, and assemble the rows of the distributed matrices
+             * owned by this process. Each process assembles the cells touching its dofs only
+             * @param csr_pattern - the sparse pattern of the whole mesh
+             * @param coef_alpha, coef_beta - the coefficients of the cells of the whole mesh
+             */
+  void distribute_triangles(const fem::CSRPattern &csr_pattern, const double *coef_alpha, const double *coef_beta);
+
+            /**
+             * The partition of a distributed run: the strips of the rectangular grid
+             * or the partition of the triangular mesh
+             */
+  const DoFPartition& dof_partition() const;
+
+            /**
+             * Explicit scheme of a distributed run on the part of the mesh of this process.
+             * The vectors are ghosted, and the operator of the scheme exchanges
+             * the ghost values while it computes the rows of the process (see GhostedLeapfrogOperator)
+             * @param dof_handler - the handler of degrees of freedom of the part of the mesh
+             */
+  void solve_explicit_distributed(const fem::DoFHandler &dof_handler);
+
+            /**
+             * Assemble the load vector of the spatial part of the right hand side function
+             * in a distributed run. The cells add their local vectors to the owned rows only,
+             * so no communication is required
+             * @param function - the right hand side function
+             * @param dof_handler - the handler of degrees of freedom of the part of the mesh
+             * @param load - output vector (it's zeroed before assembling)
+             */
+  void assemble_distributed_load(const SeparableFunction &function, const fem::DoFHandler &dof_handler, Vec load) const;
+
+            /**
+             * Add the local vectors of the cells touching the owned dofs to the load vector
+             * @param cells - the cells of the mesh (Triangle, Rectangle)
+             * @param points - the points where the dofs of the cells are
+             * @param function - the spatial part of the right hand side function
+             * @param load - output vector
+             */
+  template <class Cell>
+  void add_distributed_load(const std::vector<Cell> &cells, const std::vector<fem::Point> &points,
+                            const fem::Function &function, Vec load) const;
+
+            /**
+             * Save the results of a distributed run. Each process writes its own files:
+             * the strip of the grid (including the ghost rows, so the pieces have no gaps between them)
+             * res-<step>-p<rank>.vts, and the values of the owned dofs sol-<step>-p<rank>.dat.
+             * The owned dofs are the contiguous range of the dofs, so the .dat files of all processes
+             * concatenated in the order of the ranks are the same as the .dat file of a serial run
+             * @param dof_handler - the handler of degrees of freedom of the strip
+             * @param time_step - the number of the current time step
+             * @param solution - the (ghosted) solution on the current time step
+             * @param strip_solution - the sequential vector for the values of the strip
+             */
+  void save_results_distributed(const fem::DoFHandler &dof_handler, unsigned int time_step,
+                                Vec solution, Vec strip_solution) const;
+
+            /**
+             * Save the results of a distributed run on the triangular mesh. The solution is gathered
+             * by the first process, and it writes the same files as a serial run (see save_results)
+             * @param dof_handler - the handler of degrees of freedom
+             * @param time_step - the number of the current time step
+             * @param solution - the (distributed) solution on the current time step
+             * @param gather - the scatter of the distributed vectors to the first process
+             * @param gathered_solution - the sequential vector for the values of the whole mesh
+             *                            (it's empty on the other processes)
+             */
+  void save_results_gathered(const fem::DoFHandler &dof_handler, unsigned int time_step,
+                             Vec solution, VecScatter gather, Vec gathered_solution) const;
+
+            /**
+             * Assemble the global vector of the right hand side
+             * @param function - the right hand side function
+             * @param dof_handler - the handler of degrees of freedom
+             * @param time - the time moment when the function is evaluated
+             * @param rhs - output vector (it's zeroed before assembling)
+             */
+  void assemble_rhs(const fem::Function &function, const fem::DoFHandler &dof_handler,
+                    double time, Vec rhs) const;
+
+            /**
+             * Add the local rhs vectors of the cells to the global one
+             * @param cells - the cells of the mesh (Triangle, Rectangle)
+             * @param points - the points where the dofs of the cells are
+             * @param function - the right hand side function
+             * @param time - the time moment when the function is evaluated
+             * @param rhs - output vector
+             */
+  template <class Cell>
+  void add_local_rhs(const std::vector<Cell> &cells, const std::vector<fem::Point> &points,
+                     const fem::Function &function, double time, Vec rhs) const;
+
+            /**
+             * Assemble the load vector of the spatial part of the right hand side function.
+             * It's possible only if the function is separable (f(x, t) = g(x) * w(t)),
+             * and then the load vector is computed only once for the whole time loop.
+             * @param function - the right hand side function
+             * @param dof_handler - the handler of degrees of freedom
+             * @return the load vector, or NULL if the function is not separable
+             */
+  Vec source_load_vector(const fem::Function &function, const fem::DoFHandler &dof_handler) const;
+
+            /**
+             * Get the global vector of the right hand side at some time moment.
+             * If there is a precomputed load vector (see source_load_vector)
+             * it's just scaled by the time part of the function,
+             * otherwise the vector is assembled cell by cell
+             * @param function - the right hand side function
+             * @param source_load - the load vector of the spatial part of the function (or NULL)
+             * @param dof_handler - the handler of degrees of freedom
+             * @param time - the time moment
+             * @param rhs - output vector
+             */
+  void rhs_vector(const fem::Function &function, Vec source_load, const fem::DoFHandler &dof_handler,
+                  double time, Vec rhs) const;
+
+            /**
+             * Create the operator of the three-level scheme (A = a_mass M + a_stiff K,
+             * B = b_mass M + b_stiff K) based on the global matrices, or on the matrix-free
+             * stencil if it's used. The returned object should be deleted by the caller
+             * @param mass_diag - the diagonal of the lumped mass matrix (or NULL)
+             */
+  LeapfrogOperator* leapfrog_operator(double a_mass, double a_stiff,
+                                      double b_mass, double b_stiff,
+                                      Vec mass_diag = NULL) const;
+
+            /**
+             * Apply the operator of the three-level scheme together with the right hand side:
+             * y = dt^2 f(time) + A u1 + B u2
+             * @param leapfrog - the operator (A, B)
+             * @param function - the right hand side function
+             * @param source_load - the load vector of the spatial part of the function (or NULL)
+             * @param dof_handler - the handler of degrees of freedom
+             * @param time - the time moment of the rhs function
+             * @param u1 - the solution on the previous time step
+             * @param u2 - the solution on the preprevious time step
+             * @param y - output vector
+             */
+  void apply_leapfrog(const LeapfrogOperator &leapfrog, const fem::Function &function, Vec source_load,
+                      const fem::DoFHandler &dof_handler, double time, Vec u1, Vec u2, Vec y) const;
+
+            /**
+             * The time loop of the explicit scheme with lumped mass matrix executed by N_THREADS threads.
+             * The threads are created once for the whole loop, and each of them computes
+             * its own part of the rows of the solution (see LeapfrogOperator::apply_part)
+             * including the scaling of the source load and the boundary values.
+             * The threads are synchronized only once per time step, and the results
+             * are saved by the master thread while the others compute the next step.
+             * The threads are pinned according to PIN_MAP, and the arrays of the operator
+             * and the vectors are placed in the memory of the threads which work with them
+             * @param leapfrog - the operator of the scheme (it must be partitioned)
+             * @param function - the right hand side function (it must be separable)
+             * @param source_load - the load vector of the spatial part of the function
+             * @param dof_handler - the handler of degrees of freedom
+             * @param b_vertices, b_nodes - the boundary vertices and the corresponding dofs
+             * @param solution, solution_1, solution_2 - the solutions on the current, previous and preprevious
+             *                                           time steps. They are rotated as in the sequential loop
+             */
+  void time_loop_threaded(LeapfrogOperator &leapfrog, const fem::Function &function, Vec source_load,
+                          const fem::DoFHandler &dof_handler,
+                          const std::vector<int> &b_vertices, const std::vector<int> &b_nodes,
+                          Vec &solution, Vec &solution_1, Vec &solution_2) const;
+
+            /**
+             * Measure and print the time of application of the operator of the explicit scheme
+             * (with consistent mass matrix) in all available formats: PETSc AIJ matrices
+             * (separate MatMult calls), fused CSR, symmetric CSR and SELL-C-sigma,
+             * or the matrix-free stencil. The strong scaling of the operator used in the threaded
+             * time loop is measured as well (if OpenMP is available)
+             * @param n_runs - the number of applications of each operator
+             */
+  void benchmark_operators(unsigned int n_runs) const;
+
+            /**
+             * Whether the results of the time step are saved according to the parameters
+             * (vtk_step for the VTK files, sol_step for the solution files, output_step for any of them)
+             */
+  bool output_step(unsigned int time_step) const;
+  bool vtk_step(unsigned int time_step) const;
+  bool sol_step(unsigned int time_step) const;
+
+            /**
+             * Save the solution on the current time step (.vts/.vtu and .dat files)
+             * if it's required by the parameters. If there is the asynchronous output,
+             * the solution is only copied into the snapshot handed over to the I/O threads
+             * @param dof_handler - the handler of degrees of freedom
+             * @param time_step - the number of the current time step
+             * @param solution - the solution on the current time step
+             */
+  void save_results(const fem::DoFHandler &dof_handler, unsigned int time_step, Vec solution) const;
+
+            /**
+             * Write the files of the solution (see save_results), or of the strip of a distributed run
+             * (see save_results_distributed)
+             * @param dof_handler - the handler of degrees of freedom
+             * @param time_step - the number of the time step
+             * @param solution - the solution in the original numbering of the dofs (or the values of the strip)
+             */
+  void write_results(const fem::DoFHandler &dof_handler, unsigned int time_step, Vec solution) const;
+
+            /**
+             * Write the VTK files of the solution by fem::Result, if there is no VTK series.
+             * fem::Result writes the vectors by PETSc, so it's always called by the time loop
+             * (see write_results)
+             */
+  void write_result_files(const fem::DoFHandler &dof_handler, unsigned int time_step, Vec solution) const;
+
+            /**
+             * Write the files which don't need PETSc: the VTK series and the solution files.
+             * It's the function of the I/O threads of the asynchronous output (see write_results)
+             * @param time_step - the number of the time step
+             * @param values - the solution in the original numbering of the dofs (or the values of the strip)
+             * @param n_values - the number of the values
+             */
+  void write_snapshot(unsigned int time_step, const double *values, unsigned int n_values) const;
+
+            /**
+             * Create the asynchronous output for the time loop if there are I/O threads (IO_THREADS),
+             * otherwise the results are written synchronously
+             * @param n_values - the number of the values of each snapshot
+             * @param write - the function writing the snapshot (it's called by the I/O threads, see write_snapshot)
+             */
+  void start_output(unsigned int n_values, const AsyncWriter::WriteFunction &write);
+
+            /**
+             * Wait until all snapshots are written, destroy the asynchronous output,
+             * and close the binary solution file and the VTK series
+             */
+  void finish_output();
+
+            /**
+             * Create the binary file for the solutions of the time loop (SOL_DIR/sol.bin, or sol-p<piece>.bin
+             * for a part of the domain) if the solutions are saved in binary format (SOL_FORMAT).
+             * It must be called after start_output, and the file is closed by finish_output
+             * @param n_values - the number of the values of each solution
+             * @param piece - the rank of the process whose part of the domain is saved (-1 for the whole domain)
+             */
+  void open_solution_file(unsigned int n_values, int piece = -1);
+
+            /**
+             * Define the output window of the rectangular grid (OUT_X_BEG, ..., OUT_STRIDE).
+             * If it's the whole grid, nothing is changed in the output
+             */
+  void setup_output_window();
+
+            /**
+             * Save the solution of the time step into the binary solution file (if it's open)
+             * or into the text file. If there is the output window, its vertices are saved only
+             * @param time_step - the time step
+             * @param values - the solution
+             * @param first, n - the range of the values saved without the output window
+             * @param fname - the name of the text file
+             */
+  void write_solution(unsigned int time_step, const double *values, unsigned int first, unsigned int n,
+                      const std::string &fname) const;
+
+            /**
+             * Write the solution of the time step into the VTK series (the vertices of the output window only)
+             */
+  void write_vtk_step(unsigned int time_step, const double *values) const;
+
+            /**
+             * Create the binary VTK series (VTU_DIR/res.pvd, or res-p<piece>.pvd for a strip) for the results
+             * on the rectangular grid if it's required by the parameters (VTK_BINARY), or if there is
+             * the output window (fem::Result saves the whole grid only). The coefficients
+             * are written here once (if EXPORT_COEFFICIENTS). It must be called after start_output,
+             * and the index of the series is written by finish_output
+             * @param cell_row_beg, cell_row_end - the rows of the cells of the grid (or the own cells of the strip,
+             *                                    so the pieces of the strips share the border rows of the vertices only)
+             * @param first_vrow - the row of the vertices (and the cells) the values of the vectors begin with
+             * @param piece - the rank of the process whose strip is written (-1 for the whole domain)
+             */
+  void open_vtk_series(unsigned int cell_row_beg, unsigned int cell_row_end, unsigned int first_vrow = 0, int piece = -1);
+
+            /**
+             * Create the receivers of the time loop (RECEIVERS_FILE and RECEIVER_LINES), if any.
+             * They are located in the whole domain: in the rectangular grid by its parameters
+             * (so the strip of a distributed run is not used), or in the triangular mesh.
+             * It must be called after start_output, and the traces are written by finish_output
+             * @param first_dof, n_owned_dofs - the dofs owned by this process (all dofs in a sequential run)
+             */
+  void setup_receivers(unsigned int first_dof, unsigned int n_owned_dofs);
+
+            /**
+             * Record the solution of the time step at the receivers (if there are any).
+             * It's called on every time step, including the initial ones
+             * @param solution - the solution (its local part is the owned dofs)
+             */
+  void record_receivers(Vec solution) const;
+
+            /**
+             * Write the traces of the receivers into SEISMOGRAM_FILE. In a distributed run
+             * the parts of the traces recorded by the processes are summed up,
+             * and the first process writes them
+             */
+  void write_receivers() const;
+
+            /**
+             * Save the final solution on the triangular mesh into the file near the mesh file
+             * (<mesh>_sol.dat) in the original numbering of the dofs
+             * @param dof_handler - the handler of degrees of freedom
+             * @param solution - the solution
+             */
+  void save_mesh_solution(const fem::DoFHandler &dof_handler, Vec solution) const;
+
+            /**
+             * Compute the diagonal of the lumped mass matrix.
+             * The lumping is done by summation of the rows of the global mass matrix.
+             * The diagonal entries corresponding to the boundary nodes are equal to 1,
+             * so the Dirichlet boundary condition is imposed in the same way
+             * as it's done for the consistent mass matrix (with ones on diagonal).
+             * @param b_nodes - the list of boundary nodes
+             * @param mass_diag - output vector (the memory should be allocated before)
+             */
+  void lumped_mass_diagonal(const std::vector<int> &b_nodes, Vec mass_diag) const;
+
+            /**
+             * Impose the Dirichlet boundary condition on the system matrix (see dirichlet_matrix)
+             * with the storage chosen by SYMMETRIC_STORAGE. The columns of the boundary nodes
+             * are eliminated only once, so the symmetric storage requires the boundary function
+             * to be zero on all time steps (it's checked here)
+             * @param b_nodes - the list of boundary nodes
+             * @param system_mat - the matrix (it's replaced by a new one in case of symmetric storage)
+             */
+  void dirichlet_system_matrix(const std::vector<int> &b_nodes, Mat *system_mat) const;
+
   void coefficients_initialization();
   void create_3_bin_layers_file() const;
   void create_slop_bin_layers_file() const;
@@ -88,8 +582,43 @@ private:
 
   void export_coefficients_per_vertex(const std::string &filename) const;
   void export_coefficients_per_cell(const std::string &filename) const;
+            /**
+             * Import the coefficients saved per vertex in text format,
+             * or saved in binary format (either per vertex or per cell)
+             */
   void import_coefficients_per_vertex(const std::string &filename);
+
+            /**
+             * Convert vertex-wise distribution of the coefficients to cell-wise one
+             * @param coeff_a_vert, coeff_b_vert - the values of the coefficients in the vertices
+             */
+  void coefficients_from_vertices(const double *coeff_a_vert, const double *coeff_b_vert);
+
+            /**
+             * The name of the file in COEF_DIR where the coefficients distributed
+             * according to the layers file are cached. The name contains the hash
+             * of everything the distribution depends on: the contents of the layers file,
+             * the domain extents, the number of cells and the USE_AVERAGED flag
+             */
+  std::string coefficients_cache_file() const;
 };
 
 
+
+
+
+template <class Cell>
+void Acoustic2D::assemble_matrices(const std::vector<Cell> &cells, const fem::CSRPattern &csr_pattern,
+                                   const double *coef_alpha, const double *coef_beta)
+{
+  // assemble the matrices by several threads directly into the arrays of the sparse format
+  delete _assembler;
+  _assembler = new CSRAssembler(csr_pattern, _renumbering);
+  _assembler->assemble(cells, _fmesh.vertices(), coef_alpha, coef_beta, _param->N_THREADS);
+
+  // the matrices share the arrays of the assembler
+  _assembler->create_matrices(&_global_mass_mat, &_global_stiff_mat);
+}
+
+
 #endif // ACOUSTIC2D_H
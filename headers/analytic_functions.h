@@ -11,11 +11,41 @@ public:
   double value(const fem::Point &p, const double t = 0) const;
 };
 
-class RHSFunction : public fem::Function
+/**
+ * A function which is a product of a spatial part and a time part:
+ * f(x, t) = g(x) * w(t).
+ * Such functions allow to assemble the load vector of the spatial part only once
+ */
+class SeparableFunction : public fem::Function
 {
 public:
-  RHSFunction(const Parameters &param);
   double value(const fem::Point &p, const double t = 0) const;
+  virtual double spatial_value(const fem::Point &p) const = 0;
+  virtual double time_value(const double t) const = 0;
+};
+
+/**
+ * The spatial part g(x) of a separable function
+ */
+class SpatialPart : public fem::Function
+{
+public:
+  SpatialPart(const SeparableFunction &function);
+  double value(const fem::Point &p, const double t = 0) const;
+
+private:
+  const SeparableFunction &_function;
+};
+
+/**
+ * The source: Gaussian function in space multiplied by Ricker wavelet in time
+ */
+class RHSFunction : public SeparableFunction
+{
+public:
+  RHSFunction(const Parameters &param);
+  double spatial_value(const fem::Point &p) const;
+  double time_value(const double t) const;
 
 private:
   // parameters of Ricker wavelet
@@ -0,0 +1,249 @@
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <cstddef>
+#include <stdint.h>
+
+
+/**
+ * Bounded lock-free queue for several producers and several consumers.
+ * Each slot of the ring buffer has a sequence number telling whether the slot
+ * is ready to be written (for the position of the producer) or to be read
+ * (for the position of the consumer), so the producers and the consumers
+ * only compete for the positions by compare-and-swap
+ * (see D. Vyukov, "Bounded MPMC queue").
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+            /**
+             * Constructor
+             * @param capacity - the maximal number of the elements (it's rounded up to a power of 2)
+             */
+  BoundedQueue(unsigned int capacity)
+    : _slots(NULL), _mask(0)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size *= 2;
+    _mask = size - 1;
+    _slots = new Slot[size];
+    for (size_t i = 0; i < size; ++i)
+      _slots[i].sequence.store(i, std::memory_order_relaxed);
+    _push_pos.store(0, std::memory_order_relaxed);
+    _pop_pos.store(0, std::memory_order_relaxed);
+  }
+
+            /**
+             * Destructor
+             */
+  ~BoundedQueue()
+  {
+    delete[] _slots;
+  }
+
+            /**
+             * Add the element to the queue
+             * @return false if the queue is full
+             */
+  bool push(const T &value)
+  {
+    size_t pos = _push_pos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true)
+    {
+      slot = &_slots[pos & _mask];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+      if (diff == 0) // the slot is free, and we try to take the position
+      {
+        if (_push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0) // the slot hasn't been read yet - the queue is full
+        return false;
+      else // another producer has taken the position
+        pos = _push_pos.load(std::memory_order_relaxed);
+    }
+    slot->value = value;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+            /**
+             * Take the element from the queue
+             * @return false if the queue is empty
+             */
+  bool pop(T &value)
+  {
+    size_t pos = _pop_pos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true)
+    {
+      slot = &_slots[pos & _mask];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+      if (diff == 0) // the slot is written, and we try to take the position
+      {
+        if (_pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0) // the slot hasn't been written yet - the queue is empty
+        return false;
+      else // another consumer has taken the position
+        pos = _pop_pos.load(std::memory_order_relaxed);
+    }
+    value = slot->value;
+    slot->sequence.store(pos + _mask + 1, std::memory_order_release); // the slot is free for the next round
+    return true;
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+            /**
+             * The ring buffer
+             */
+  Slot *_slots;
+
+            /**
+             * The size of the ring buffer minus 1
+             */
+  size_t _mask;
+
+            /**
+             * The positions of the producers and the consumers.
+             * They are separated by the padding, so they don't share a cache line
+             */
+  std::atomic<size_t> _push_pos;
+  char _padding[64];
+  std::atomic<size_t> _pop_pos;
+
+  BoundedQueue(const BoundedQueue&); /** copy constructor */
+  BoundedQueue& operator=(const BoundedQueue&); /** copy assignment operator */
+};
+
+
+
+/**
+ * Asynchronous output of the results of the time loop.
+ * The time loop copies the values to be saved (a snapshot) into one of the buffers,
+ * hands it over to the I/O threads through the lock-free queue, and continues immediately.
+ * The I/O threads write the snapshots by the given function and return the buffers
+ * to the queue of the free ones. If all buffers are being written, the time loop waits
+ * for a free one (back-pressure), so the memory of the output is limited by the number of buffers.
+ * With two buffers one snapshot is written while the next one is computed (double buffering).
+ */
+class AsyncWriter
+{
+public:
+            /**
+             * The function writing the snapshot: the number of the time step and the values
+             * (the buffer of n_values values). It's called by the I/O threads, so it must only read
+             * the values and the objects which are not changed by the time loop. PETSc is not thread-safe,
+             * therefore the function must not call it (the vectors are written by the time loop)
+             */
+  typedef std::function<void(unsigned int time_step, const double *values)> WriteFunction;
+
+            /**
+             * Constructor. The buffers are created here
+             * @param n_values - the number of the values in a snapshot
+             * @param n_buffers - the number of the buffers for the snapshots
+             * @param n_threads - the number of the I/O threads
+             * @param write - the function writing the snapshot
+             */
+  AsyncWriter(unsigned int n_values, unsigned int n_buffers, unsigned int n_threads, const WriteFunction &write);
+
+            /**
+             * Destructor. All snapshots are written before the I/O threads are stopped
+             */
+  ~AsyncWriter();
+
+            /**
+             * Get a free buffer for the next snapshot. It waits if all buffers are being written
+             * @return the array of n_values values
+             */
+  double* acquire();
+
+            /**
+             * Hand the acquired buffer over to the I/O threads
+             * @param time_step - the number of the time step of the snapshot
+             */
+  void submit(unsigned int time_step);
+
+            /**
+             * Wait until all submitted snapshots are written
+             */
+  void flush();
+
+private:
+            /**
+             * The buffers of the snapshots and the time steps of the snapshots
+             */
+  std::vector<std::vector<double> > _buffers;
+  std::vector<unsigned int> _time_steps;
+
+            /**
+             * The queues of the numbers of the free buffers and the buffers to be written
+             */
+  BoundedQueue<unsigned int> _free;
+  BoundedQueue<unsigned int> _ready;
+
+            /**
+             * The buffer acquired by the time loop (or -1)
+             */
+  int _acquired;
+
+            /**
+             * The number of the snapshots submitted but not written yet
+             */
+  std::atomic<unsigned int> _n_pending;
+
+            /**
+             * Whether the I/O threads should finish
+             */
+  std::atomic<bool> _stop;
+
+            /**
+             * Whether the writing failed, and the message of the failure
+             * (it's set once by the thread which failed first)
+             */
+  std::atomic<bool> _failed;
+  std::atomic<bool> _error_taken;
+  std::string _error;
+
+  WriteFunction _write;
+
+  std::vector<std::thread> _threads;
+
+            /**
+             * The loop of the I/O thread
+             */
+  void io_loop();
+
+            /**
+             * Keep the message of the failure of the I/O thread
+             */
+  void set_failure(const std::string &error);
+
+            /**
+             * Rethrow the failure of the I/O threads in the calling thread
+             */
+  void check_failure() const;
+
+  AsyncWriter(const AsyncWriter&); /** copy constructor */
+  AsyncWriter& operator=(const AsyncWriter&); /** copy assignment operator */
+};
+
+
+#endif // ASYNC_WRITER_H
@@ -88,6 +88,149 @@ void check_csr_pattern(const fem::CSRPattern &csr_pattern, unsigned int n_points
 
 
 
+void compare_vectors(Vec a, Vec b, double rel_tol = 1e-13)
+{
+  PetscInt n_a, n_b;
+  VecGetSize(a, &n_a);
+  VecGetSize(b, &n_b);
+  EXPECT_EQ(n_a, n_b);
+
+  const double *a_val, *b_val;
+  VecGetArrayRead(a, &a_val);
+  VecGetArrayRead(b, &b_val);
+  for (PetscInt i = 0; i < std::min(n_a, n_b); ++i)
+    EXPECT_NEAR(a_val[i], b_val[i], rel_tol * (1. + fabs(a_val[i])));
+  VecRestoreArrayRead(b, &b_val);
+  VecRestoreArrayRead(a, &a_val);
+}
+
+
+
+template <class Cell>
+void assemble_serially(const std::vector<Cell> &cells, const double *coef_alpha, const double *coef_beta, Mat mass_mat, Mat stiff_mat)
+{
+  const unsigned int n_dofs = Cell::n_dofs_first;
+  double **local_mass_mat = new double*[n_dofs];
+  double **local_stiff_mat = new double*[n_dofs];
+  for (unsigned int i = 0; i < n_dofs; ++i)
+  {
+    local_mass_mat[i] = new double[n_dofs];
+    local_stiff_mat[i] = new double[n_dofs];
+  }
+  for (unsigned int cell = 0; cell < cells.size(); ++cell)
+  {
+    cells[cell].local_mass_matrix(coef_alpha[cell], local_mass_mat);
+    cells[cell].local_stiffness_matrix(coef_beta[cell], local_stiff_mat);
+    for (unsigned int i = 0; i < n_dofs; ++i)
+      for (unsigned int j = 0; j < n_dofs; ++j)
+      {
+        MatSetValue(mass_mat, cells[cell].dof(i), cells[cell].dof(j), local_mass_mat[i][j], ADD_VALUES);
+        MatSetValue(stiff_mat, cells[cell].dof(i), cells[cell].dof(j), local_stiff_mat[i][j], ADD_VALUES);
+      }
+  }
+  for (unsigned int i = 0; i < n_dofs; ++i)
+  {
+    delete[] local_mass_mat[i];
+    delete[] local_stiff_mat[i];
+  }
+  delete[] local_mass_mat;
+  delete[] local_stiff_mat;
+  MatAssemblyBegin(mass_mat, MAT_FINAL_ASSEMBLY);
+  MatAssemblyEnd(mass_mat, MAT_FINAL_ASSEMBLY);
+  MatAssemblyBegin(stiff_mat, MAT_FINAL_ASSEMBLY);
+  MatAssemblyEnd(stiff_mat, MAT_FINAL_ASSEMBLY);
+}
+
+
+
+/**
+ * The mass and stiffness matrices of the rectangular grid of the first order
+ * with different coefficients in different cells, and the vectors to apply
+ * the operators of the time schemes to. It's the common setup of the tests
+ * comparing the storages and the orderings of the matrices
+ */
+class GridMatrices
+{
+public:
+  GridMatrices(double x_end, double y_end, unsigned int nx, unsigned int ny)
+    : fmesh(),
+      fe(1),
+      dof_handler(&fmesh)
+  {
+    fmesh.create_rectangular_grid(0, x_end, 0, y_end, nx, ny);
+    dof_handler.distribute_dofs(fe, fem::CG);
+    csr_pattern.make_sparse_format(dof_handler, fem::CG);
+    n_dofs = dof_handler.n_dofs();
+
+    coef_alpha.resize(fmesh.n_rectangles());
+    coef_beta.resize(fmesh.n_rectangles());
+    for (unsigned int cell = 0; cell < fmesh.n_rectangles(); ++cell)
+    {
+      coef_alpha[cell] = 1. + 0.2 * (cell % 3);
+      coef_beta[cell]  = 3. + 0.5 * (cell % 4);
+    }
+
+    MatCreateSeqAIJ(PETSC_COMM_WORLD, csr_pattern.order(), csr_pattern.order(), 0, csr_pattern.nnz(), &mass_mat);
+    MatCreateSeqAIJ(PETSC_COMM_WORLD, csr_pattern.order(), csr_pattern.order(), 0, csr_pattern.nnz(), &stiff_mat);
+    assemble_serially(fmesh.rectangles(), &coef_alpha[0], &coef_beta[0], mass_mat, stiff_mat);
+
+    VecCreateSeq(PETSC_COMM_SELF, n_dofs, &u1);
+    VecDuplicate(u1, &u2);
+    VecDuplicate(u1, &f);
+    VecDuplicate(u1, &mass_diag);
+    for (unsigned int i = 0; i < n_dofs; ++i)
+    {
+      VecSetValue(u1, i, sin(1. + i), INSERT_VALUES);
+      VecSetValue(u2, i, cos(2. * i), INSERT_VALUES);
+      VecSetValue(f, i, 1. / (1. + i), INSERT_VALUES);
+    }
+    VecAssemblyBegin(u1);
+    VecAssemblyEnd(u1);
+    VecAssemblyBegin(u2);
+    VecAssemblyEnd(u2);
+    VecAssemblyBegin(f);
+    VecAssemblyEnd(f);
+    MatGetRowSum(mass_mat, mass_diag);
+  }
+
+  ~GridMatrices()
+  {
+    MatDestroy(&mass_mat);
+    MatDestroy(&stiff_mat);
+    VecDestroy(&u1);
+    VecDestroy(&u2);
+    VecDestroy(&f);
+    VecDestroy(&mass_diag);
+  }
+
+  fem::FineMesh fmesh;
+  fem::FiniteElement fe;
+  fem::DoFHandler dof_handler;
+  fem::CSRPattern csr_pattern;
+  unsigned int n_dofs;
+
+            /**
+             * The coefficients of the cells
+             */
+  std::vector<double> coef_alpha, coef_beta;
+
+            /**
+             * The matrices assembled serially in the natural numbering
+             */
+  Mat mass_mat, stiff_mat;
+
+            /**
+             * Two previous solutions, the rhs vector, and the lumped mass matrix
+             */
+  Vec u1, u2, f, mass_diag;
+
+private:
+  GridMatrices(const GridMatrices&); /** copy constructor */
+  GridMatrices& operator=(const GridMatrices&); /** copy assignment operator */
+};
+
+
+
 void check_elliptic_solution_triangles(bool sparse,
                                        const std::string &meshfile,
                                        const fem::Function &an_solution,
@@ -28,7 +28,32 @@ public:
   const Layer& layer_which_contains(const fem::Rectangle &cell,
                                     const std::vector<fem::Point> &points) const;
 
+            /**
+             * Check if the block contains a point (usually it's a center of a cell)
+             */
+  bool contains_point(const fem::Point &point) const;
+
+            /**
+             * Find the number of the layer containing a point.
+             * The layers are ordered from the bottom to the top, and their sloped sides
+             * are parallel, so the layer is found by binary search
+             * with respect to the position of the point relatively to the top sides.
+             * The point must belong to the block
+             */
+  unsigned int layer_number(const fem::Point &point) const;
+
+            /**
+             * Find the number of the layer containing a point in the same way as layer_number,
+             * but without throwing, so it can be called inside parallel regions
+             * @return the number of the layer, or -1 if the point is out of the block
+             *         or it's not in any layer (e.g. there is a gap between the layers)
+             */
+  int find_layer(const fem::Point &point) const;
+
   unsigned int n_layers() const;
+  const Layer& layer(unsigned int number) const;
+  double coef_alpha(unsigned int number) const;
+  double coef_beta(unsigned int number) const;
 
 
 private:
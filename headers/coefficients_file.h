@@ -0,0 +1,150 @@
+#ifndef COEFFICIENTS_FILE_H
+#define COEFFICIENTS_FILE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+/**
+ * Binary file with coefficients alpha and beta distribution on a rectangular grid.
+ * The file consists of a header of 64 bytes, and then the values of alpha and beta
+ * go one after another (first all alphas, then all betas) as arrays of doubles:
+ *
+ * magic      8 bytes   "FEM2DCO" with trailing zero
+ * version    uint32    the version of the format (VERSION)
+ * byte order uint32    0x01020304 written on the host machine (the file is not portable between the machines with different endianness)
+ * layout     uint32    PER_CELL or PER_VERTEX
+ * nx, ny     uint32    the number of cells of the grid in x- and y-directions
+ * reserved   uint32
+ * n_values   uint64    the number of values of each coefficient (nx*ny or (nx+1)*(ny+1))
+ * checksum   uint64    the checksum of the values (see checksum())
+ * reserved   2 x uint64
+ *
+ * The file is read via memory mapping, so the values are available without parsing.
+ */
+class CoefficientsFile
+{
+public:
+            /**
+             * The way the coefficients are distributed over the grid
+             */
+  enum Layout { PER_CELL = 0, PER_VERTEX = 1 };
+
+            /**
+             * The current version of the format
+             */
+  static const uint32_t VERSION = 1;
+
+            /**
+             * Open the file and map it into memory.
+             * The header and the checksum are checked
+             * @param filename - the name of the binary file
+             */
+  CoefficientsFile(const std::string &filename);
+
+            /**
+             * Destructor. The file is unmapped
+             */
+  ~CoefficientsFile();
+
+  Layout layout() const;
+  unsigned int nx() const;
+  unsigned int ny() const;
+  uint64_t n_values() const;
+
+            /**
+             * The values of the coefficients (they point to the mapped memory)
+             */
+  const double* alpha() const;
+  const double* beta() const;
+
+            /**
+             * Write the coefficients into a binary file
+             * @param filename - the name of the file
+             * @param layout - per cell or per vertex distribution
+             * @param nx, ny - the number of cells of the grid in x- and y-directions
+             * @param alpha, beta - the values of the coefficients
+             */
+  static void write(const std::string &filename, Layout layout,
+                    unsigned int nx, unsigned int ny,
+                    const std::vector<double> &alpha,
+                    const std::vector<double> &beta);
+
+            /**
+             * Check whether the file is a binary coefficients file (by its magic string)
+             */
+  static bool is_binary(const std::string &filename);
+
+            /**
+             * Convert the file from binary format to text one or vice versa.
+             * The direction of conversion is defined by the format of the input file.
+             * The text format is the one used by export_coefficients_per_* functions:
+             * the number of values, and then the values of alpha and beta in each line
+             * @param in_filename - the file to be converted
+             * @param out_filename - the converted file
+             * @param nx, ny - the number of cells of the grid (they are required to convert
+             *                 text format, and the layout is defined by the number of values)
+             */
+  static void convert(const std::string &in_filename, const std::string &out_filename,
+                      unsigned int nx, unsigned int ny);
+
+            /**
+             * The checksum of the data: FNV-1a hash computed over 64-bit words
+             * @param data - the values
+             * @param n - the number of the values
+             * @param hash - the initial value of the hash (to continue hashing)
+             */
+  static uint64_t checksum(const double *data, uint64_t n, uint64_t hash = FNV_OFFSET);
+
+            /**
+             * FNV-1a hash of arbitrary data computed byte by byte
+             * (it's used to identify the input data of the coefficients distribution)
+             * @param data - the data
+             * @param n_bytes - the size of the data in bytes
+             * @param hash - the initial value of the hash (to continue hashing)
+             */
+  static uint64_t hash_bytes(const void *data, uint64_t n_bytes, uint64_t hash = FNV_OFFSET);
+
+            /**
+             * The initial value of the checksum
+             */
+  static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+
+private:
+            /**
+             * The header of the file
+             */
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t layout;
+    uint32_t nx, ny;
+    uint32_t reserved_0;
+    uint64_t n_values;
+    uint64_t checksum;
+    uint64_t reserved_1[2];
+  };
+
+  static const char MAGIC[8];
+  static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+            /**
+             * The beginning of the mapped file and its size in bytes
+             */
+  void *_data;
+  size_t _size;
+
+            /**
+             * The header in the mapped memory
+             */
+  const Header *_header;
+
+  CoefficientsFile(const CoefficientsFile&); /** copy constructor */
+  CoefficientsFile& operator=(const CoefficientsFile&); /** copy assignment operator */
+};
+
+
+#endif // COEFFICIENTS_FILE_H
@@ -0,0 +1,313 @@
+#ifndef CSR_ASSEMBLER_H
+#define CSR_ASSEMBLER_H
+
+#include "fem/csr_pattern.h"
+#include "fem/point.h"
+#include "fem/auxiliary_functions.h"
+#include "dof_renumbering.h"
+#include "petscmat.h"
+#include <vector>
+#include <array>
+#include <cmath>
+#include <algorithm>
+#if defined(_OPENMP)
+  #include <omp.h>
+#endif
+
+
+/**
+ * Multithreaded assembly of the global mass and stiffness matrices.
+ * The cells are colored in such a way that no two cells of the same color
+ * share a degree of freedom. Then the cells of one color are processed
+ * by several threads simultaneously, and each thread adds its local matrices
+ * directly to the arrays of values of the CSR format. The rows touched by
+ * different cells of the same color are different, so there are no locks.
+ * Then the PETSc matrices are created directly over these arrays (without copying),
+ * and the mass and stiffness matrices share the same arrays of row beginnings
+ * and column indices.
+ * If all cells are the same up to translation (as in the uniform rectangular grid),
+ * the local matrices are computed once for the first cell, and then they are
+ * just scaled by the coefficients of each cell.
+ * The rows and columns of the matrices can be renumbered (see DoFRenumbering).
+ */
+class CSRAssembler
+{
+public:
+            /**
+             * Constructor. The arrays of the CSR format are copied from the pattern
+             * (the column indices of each row are sorted as PETSc requires)
+             * and the arrays of values are allocated and filled with zeros
+             * @param csr_pattern - the sparse pattern of the matrices
+             * @param renumbering - the permutation of the dofs applied to the rows and columns
+             */
+  CSRAssembler(const fem::CSRPattern &csr_pattern, const DoFRenumbering &renumbering = DoFRenumbering());
+
+            /**
+             * Color the cells greedily: each cell gets the smallest color
+             * which is not used by the cells sharing any dof with it.
+             * The cells of each color are listed in ascending order
+             * @param cells - the cells of the mesh (Triangle, Rectangle)
+             * @param n_dofs - the total number of dofs
+             * @return the lists of cells for each color
+             */
+  template <class Cell>
+  static std::vector<std::vector<unsigned int> > color_cells(const std::vector<Cell> &cells, unsigned int n_dofs);
+
+            /**
+             * Check whether all cells are the same up to translation,
+             * i.e. the vertices of each cell are placed relative to its first vertex
+             * in the same way as the vertices of the first cell.
+             * In this case the local matrices of all cells are the same
+             * @param cells - the cells of the mesh (Triangle, Rectangle)
+             * @param points - the vertices of the mesh
+             */
+  template <class Cell>
+  static bool congruent_cells(const std::vector<Cell> &cells, const std::vector<fem::Point> &points);
+
+            /**
+             * Assemble the mass and the stiffness matrices
+             * @param cells - the cells of the mesh (Triangle, Rectangle)
+             * @param points - the vertices of the mesh
+             * @param coef_alpha - the coefficients of the mass matrix (one per cell)
+             * @param coef_beta - the coefficients of the stiffness matrix (one per cell)
+             * @param n_threads - the number of threads (0 means the default number of OpenMP threads).
+             *                    Without OpenMP the assembly is serial
+             */
+  template <class Cell>
+  void assemble(const std::vector<Cell> &cells, const std::vector<fem::Point> &points,
+                const double *coef_alpha, const double *coef_beta, unsigned int n_threads);
+
+            /**
+             * Create the assembled PETSc matrices over the arrays of the assembler.
+             * The arrays are not copied, so the assembler must live longer than the matrices,
+             * and the matrices must not get new nonzero entries
+             * @param mass - output mass matrix
+             * @param stiff - output stiffness matrix
+             */
+  void create_matrices(Mat *mass, Mat *stiff);
+
+            /**
+             * Create the distributed (MPIAIJ) matrices from the rows [row_beg, row_end)
+             * of the assembled matrices, when the assembled dofs are a contiguous range
+             * of the global dofs (as the strips of StripPartition are). The arrays are copied,
+             * so the assembler can be destroyed after that
+             * @param comm - the communicator of the matrices
+             * @param row_beg, row_end - the rows owned by this process
+             * @param dof_shift - the global dof corresponding to the dof 0 of the assembler
+             * @param n_dofs - the global number of dofs
+             * @param mass - output mass matrix
+             * @param stiff - output stiffness matrix
+             */
+  void create_distributed_matrices(MPI_Comm comm, unsigned int row_beg, unsigned int row_end,
+                                   unsigned int dof_shift, unsigned int n_dofs,
+                                   Mat *mass, Mat *stiff) const;
+
+            /**
+             * The position of the entry (row, col) in the arrays of values
+             */
+  unsigned int position(unsigned int row, unsigned int col) const;
+
+private:
+            /**
+             * The CSR format: the beginnings of the rows and the column indices
+             */
+  std::vector<PetscInt> _row;
+  std::vector<PetscInt> _col;
+
+            /**
+             * The values of the mass and the stiffness matrices
+             */
+  std::vector<double> _mass;
+  std::vector<double> _stiff;
+
+            /**
+             * The permutation of the dofs
+             */
+  DoFRenumbering _renumbering;
+
+            /**
+             * The position of the entry (row, col) in the arrays of values, or -1 if it's not
+             * in the sparse pattern. It doesn't throw, so it's used by the threads of the assembling
+             */
+  PetscInt find(unsigned int row, unsigned int col) const;
+};
+
+
+
+template <class Cell>
+std::vector<std::vector<unsigned int> > CSRAssembler::color_cells(const std::vector<Cell> &cells, unsigned int n_dofs)
+{
+  typedef unsigned long long Mask;
+  const unsigned int max_n_colors = 8 * sizeof(Mask);
+
+  // the colors of the cells containing each dof
+  std::vector<Mask> dof_colors(n_dofs, 0);
+  std::vector<std::vector<unsigned int> > colors;
+
+  for (unsigned int cell = 0; cell < cells.size(); ++cell)
+  {
+    Mask used = 0;
+    for (unsigned int i = 0; i < cells[cell].n_dofs(); ++i)
+      used |= dof_colors[cells[cell].dof(i)];
+
+    unsigned int color = 0;
+    while (color < max_n_colors && (used & (Mask(1) << color)))
+      ++color;
+    require(color < max_n_colors, "Too many colors are required to color the cells");
+
+    if (color == colors.size())
+      colors.push_back(std::vector<unsigned int>());
+    colors[color].push_back(cell);
+
+    for (unsigned int i = 0; i < cells[cell].n_dofs(); ++i)
+      dof_colors[cells[cell].dof(i)] |= (Mask(1) << color);
+  }
+
+  return colors;
+}
+
+
+
+template <class Cell>
+bool CSRAssembler::congruent_cells(const std::vector<Cell> &cells, const std::vector<fem::Point> &points)
+{
+  if (cells.empty())
+    return false;
+
+  constexpr unsigned int n_vertices = Cell::n_vertices;
+  constexpr unsigned int dim = 2;
+
+  // the placement of the vertices of the first cell relative to its first vertex
+  const Cell &first = cells[0];
+  std::array<std::array<double, dim>, n_vertices> offset;
+  double size = 0.;
+  for (unsigned int i = 0; i < n_vertices; ++i)
+  {
+    for (unsigned int d = 0; d < dim; ++d)
+    {
+      offset[i][d] = points[first.vertex(i)].coord(d) - points[first.vertex(0)].coord(d);
+      size = std::max(size, fabs(offset[i][d]));
+    }
+  }
+
+  const double tol = 1e-12 * size;
+  for (unsigned int cell = 1; cell < cells.size(); ++cell)
+  {
+    const fem::Point &origin = points[cells[cell].vertex(0)];
+    for (unsigned int i = 1; i < n_vertices; ++i)
+    {
+      const fem::Point &vert = points[cells[cell].vertex(i)];
+      for (unsigned int d = 0; d < dim; ++d)
+        if (fabs(vert.coord(d) - origin.coord(d) - offset[i][d]) > tol)
+          return false;
+    }
+  }
+
+  return true;
+}
+
+
+
+template <class Cell>
+void CSRAssembler::assemble(const std::vector<Cell> &cells, const std::vector<fem::Point> &points,
+                            const double *coef_alpha, const double *coef_beta, unsigned int n_threads)
+{
+  // the size of the local matrices is known at compile time,
+  // so the loops over them are unrolled by the compiler
+  constexpr unsigned int n_dofs = Cell::n_dofs_first;
+  typedef std::array<std::array<double, n_dofs>, n_dofs> LocalMatrix;
+
+  const std::vector<std::vector<unsigned int> > colors = color_cells(cells, _row.size() - 1);
+
+  // the reference local matrices (with coefficients equal to 1), if all cells are the same
+  const bool uniform = congruent_cells(cells, points);
+  LocalMatrix ref_mass, ref_stiff;
+  if (uniform)
+  {
+    std::array<double*, n_dofs> ref_mass_rows, ref_stiff_rows; // the element interface requires double**
+    for (unsigned int i = 0; i < n_dofs; ++i)
+    {
+      ref_mass_rows[i] = ref_mass[i].data();
+      ref_stiff_rows[i] = ref_stiff[i].data();
+    }
+    cells[0].local_mass_matrix(1., ref_mass_rows.data());
+    cells[0].local_stiffness_matrix(1., ref_stiff_rows.data());
+  }
+
+  // an exception can't leave the parallel region, so the entries out of the sparse pattern
+  // are counted by the threads, and they are reported after the region
+  unsigned int n_missing = 0;
+
+#if defined(_OPENMP)
+  if (n_threads == 0)
+    n_threads = omp_get_max_threads();
+  #pragma omp parallel num_threads(n_threads)
+#endif
+  {
+    // each thread has its own local matrices
+    LocalMatrix local_mass, local_stiff;
+    std::array<double*, n_dofs> local_mass_mat, local_stiff_mat;
+    for (unsigned int i = 0; i < n_dofs; ++i)
+    {
+      local_mass_mat[i] = local_mass[i].data();
+      local_stiff_mat[i] = local_stiff[i].data();
+    }
+
+    for (unsigned int c = 0; c < colors.size(); ++c)
+    {
+      const std::vector<unsigned int> &color_cells = colors[c];
+      const int n_color_cells = color_cells.size();
+
+      // the cells of one color don't share dofs, so they are processed independently.
+      // the implicit barrier at the end of the loop separates the colors
+#if defined(_OPENMP)
+      #pragma omp for schedule(static)
+#endif
+      for (int k = 0; k < n_color_cells; ++k)
+      {
+        const unsigned int cell = color_cells[k];
+        const Cell &element = cells[cell];
+        if (uniform)
+        {
+          for (unsigned int i = 0; i < n_dofs; ++i)
+          {
+            for (unsigned int j = 0; j < n_dofs; ++j)
+            {
+              local_mass[i][j] = coef_alpha[cell] * ref_mass[i][j];
+              local_stiff[i][j] = coef_beta[cell] * ref_stiff[i][j];
+            }
+          }
+        }
+        else
+        {
+          element.local_mass_matrix(coef_alpha[cell], local_mass_mat.data());
+          element.local_stiffness_matrix(coef_beta[cell], local_stiff_mat.data());
+        }
+
+        for (unsigned int i = 0; i < n_dofs; ++i)
+        {
+          const unsigned int dof_i = _renumbering.new_dof(element.dof(i));
+          for (unsigned int j = 0; j < n_dofs; ++j)
+          {
+            const PetscInt pos = find(dof_i, _renumbering.new_dof(element.dof(j)));
+            if (pos < 0)
+            {
+#if defined(_OPENMP)
+              #pragma omp atomic
+#endif
+              ++n_missing;
+              continue;
+            }
+            _mass[pos] += local_mass[i][j];
+            _stiff[pos] += local_stiff[i][j];
+          }
+        }
+      }
+    }
+  }
+
+  require(n_missing == 0, d2s(n_missing) + " entries of the local matrices are not in the sparse pattern");
+}
+
+
+#endif // CSR_ASSEMBLER_H
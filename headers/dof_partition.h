@@ -0,0 +1,64 @@
+#ifndef DOF_PARTITION_H
+#define DOF_PARTITION_H
+
+#include <vector>
+
+
+/**
+ * Distribution of the dofs between MPI processes. Each process owns a contiguous range
+ * of the global dofs (the same range PETSc uses for the distributed vectors and matrices),
+ * and it keeps the part of the mesh touching its dofs. The dofs of this part are the local dofs
+ * (the dofs of the DoFHandler of the process), and they are either owned by the process,
+ * or they are the ghosts owned by other processes.
+ * The explicit scheme of a distributed run works with this interface only,
+ * so it's the same for the strips of the rectangular grid (StripPartition)
+ * and for the unstructured meshes (MeshPartition).
+ */
+class DoFPartition
+{
+public:
+            /**
+             * Destructor
+             */
+  virtual ~DoFPartition() { }
+
+            /**
+             * The number of this process
+             */
+  virtual unsigned int rank() const = 0;
+
+            /**
+             * The total number of dofs
+             */
+  virtual unsigned int n_dofs() const = 0;
+
+            /**
+             * The first global dof owned by this process, and the number of owned dofs
+             */
+  virtual unsigned int first_dof() const = 0;
+  virtual unsigned int n_owned_dofs() const = 0;
+
+            /**
+             * The global dofs of the local part owned by other processes (in ascending order).
+             * They are the ghost values of the distributed vectors
+             */
+  virtual std::vector<int> ghost_dofs() const = 0;
+
+            /**
+             * The global number of the local dof
+             */
+  virtual unsigned int global_dof(unsigned int local_dof) const = 0;
+
+            /**
+             * Whether the local dof is owned by this process
+             */
+  virtual bool owns_dof(unsigned int local_dof) const = 0;
+
+            /**
+             * The owned local dofs lying on the boundary of the whole domain
+             */
+  virtual std::vector<int> boundary_dofs() const = 0;
+};
+
+
+#endif // DOF_PARTITION_H
@@ -0,0 +1,114 @@
+#ifndef DOF_RENUMBERING_H
+#define DOF_RENUMBERING_H
+
+#include "fem/csr_pattern.h"
+#include "fem/point.h"
+#include "petscvec.h"
+#include <vector>
+
+
+/**
+ * Permutation of the degrees of freedom improving the locality of the memory accesses
+ * of the sparse matrix operations. The dofs of the fem library (and the mesh vertices
+ * they are associated with) keep their numbers, and the permutation is applied
+ * where the global matrices and vectors are indexed. The vectors are returned
+ * to the original numbering for the output.
+ *
+ * The orderings:
+ * reverse Cuthill-McKee - for unstructured meshes, it reduces the bandwidth of the matrices;
+ * Morton (Z-order curve) and tiled - for structured grids, the neighbouring vertices
+ * are kept close to each other in both directions.
+ */
+class DoFRenumbering
+{
+public:
+            /**
+             * The size (in vertices) of the square tile of the tiled ordering
+             */
+  static const unsigned int TILE_SIZE = 64;
+
+            /**
+             * Constructor. The identity permutation (the natural ordering)
+             */
+  DoFRenumbering();
+
+            /**
+             * Constructor
+             * @param new_dofs - the new number of each dof (it must be a permutation)
+             */
+  DoFRenumbering(const std::vector<int> &new_dofs);
+
+            /**
+             * Reverse Cuthill-McKee ordering based on the graph of the sparse pattern.
+             * Each connected component starts from a pseudo-peripheral vertex,
+             * and the neighbours are numbered in the order of increasing degree
+             */
+  static DoFRenumbering cuthill_mckee(const fem::CSRPattern &csr_pattern);
+
+            /**
+             * Morton (Z-order) ordering of the vertices of the structured grid
+             * @param dofs - the coordinates of the dofs (they must be the vertices of the grid)
+             * @param nx, ny - the number of cells in x- and y-directions
+             */
+  static DoFRenumbering morton(const std::vector<fem::Point> &dofs, unsigned int nx, unsigned int ny);
+
+            /**
+             * Tiled ordering of the vertices of the structured grid: the grid is split into
+             * the square tiles of TILE_SIZE x TILE_SIZE vertices, the tiles are numbered row by row,
+             * and the vertices inside each tile are numbered row by row as well
+             * @param dofs - the coordinates of the dofs (they must be the vertices of the grid)
+             * @param nx, ny - the number of cells in x- and y-directions
+             */
+  static DoFRenumbering tiled(const std::vector<fem::Point> &dofs, unsigned int nx, unsigned int ny);
+
+            /**
+             * Whether the permutation is the identity
+             */
+  bool natural() const;
+
+            /**
+             * The new number of the dof
+             */
+  unsigned int new_dof(unsigned int dof) const
+  {
+    return (_new_dofs.empty() ? dof : _new_dofs[dof]);
+  }
+
+            /**
+             * The new numbers of the list of dofs
+             */
+  std::vector<int> new_dofs(const std::vector<int> &dofs) const;
+
+            /**
+             * Return the values of the vector to the original numbering
+             * @param x - the vector in the new numbering
+             * @param natural_x - output vector in the original numbering (the memory should be allocated before)
+             */
+  void to_natural(Vec x, Vec natural_x) const;
+
+            /**
+             * The bandwidth of the sparse pattern after the renumbering
+             * (the maximal distance between the row and the column of a nonzero entry)
+             */
+  unsigned int bandwidth(const fem::CSRPattern &csr_pattern) const;
+
+private:
+            /**
+             * The new number of each dof (empty for the natural ordering)
+             */
+  std::vector<int> _new_dofs;
+
+            /**
+             * The indices (ix, iy) of the grid vertices corresponding to the dofs
+             */
+  static void grid_indices(const std::vector<fem::Point> &dofs, unsigned int nx, unsigned int ny,
+                           std::vector<unsigned int> &ix, std::vector<unsigned int> &iy);
+
+            /**
+             * The permutation numbering the dofs in the order of increasing keys
+             */
+  static std::vector<int> sort_by_keys(const std::vector<unsigned long long> &keys);
+};
+
+
+#endif // DOF_RENUMBERING_H
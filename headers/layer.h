@@ -27,13 +27,15 @@ public:
             /**
              * Initialization of the (sloped) layer
              * @param number - the number of the layer
-             * @param thickness_percent - the vector of all thicknesses of all layers in the domain bounded by 2 points
+             * @param y_bottom - the bottom limit of the layer when it's distributed horizontally
+             * @param y_top - the top limit of the layer when it's distributed horizontally
+             *                (the limits of all layers are computed at once by the block of layers)
              * @param min_point - the min point of the domain where the layers are supposed to be
              * @param max_point - the max point of the domain where the layers are supposed to be
              * @param angle - the slope angle in degrees (in respect of OX axis - so the angle 0 means horizontal layer),
              *                the possible range of the angle values is (-90, 90), not including right angles
              */
-  void init(unsigned int number, const std::vector<double> &thickness_percent,
+  void init(unsigned int number, double y_bottom, double y_top,
             const fem::Point &min_point, const fem::Point &max_point,
             double angle);
 
@@ -43,11 +45,25 @@ public:
              */
   bool contains_element(const fem::Rectangle &cell, const std::vector<fem::Point> &points) const;
 
+            /**
+             * Check if this layer contains a point (usually it's a center of a cell)
+             */
+  bool contains_point(const fem::Point &point) const;
+
+            /**
+             * Check if a point is not above the top side of the layer
+             */
+  bool below_top(const fem::Point &point) const;
+
+            /**
+             * Check if a point is not below the bottom side of the layer
+             */
+  bool above_bottom(const fem::Point &point) const;
+
   double thickness() const;
 
 private:
   unsigned int _number;
-  double _thickness_percent;
   double _thickness;
   double _angle;
   double _angle_rad_abs;
@@ -89,4 +105,14 @@ private:
 //  //void calc_transformation();
 };
 
+
+
+/**
+ * The center of a rectangular cell.
+ * We think that a cell belongs to a layer (or a block of layers)
+ * if a center of the cell belongs to it
+ */
+fem::Point cell_center(const fem::Rectangle &cell, const std::vector<fem::Point> &points);
+
+
 #endif // LAYER_H
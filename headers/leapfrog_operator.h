@@ -0,0 +1,376 @@
+#ifndef LEAPFROG_OPERATOR_H
+#define LEAPFROG_OPERATOR_H
+
+#include "petscvec.h"
+#include "petscmat.h"
+#include "numa_memory.h"
+#include <vector>
+#include <stdint.h>
+
+
+/**
+ * The operator of a three-level time scheme applied in one sweep:
+ * y = coef_f * f + A u1 + B u2,
+ * where u1 and u2 are the solutions on the previous and preprevious time steps,
+ * A = a_mass * M + a_stiff * K, B = b_mass * M + b_stiff * K,
+ * and M, K are the global mass and stiffness matrices.
+ *
+ * If the mass matrix is lumped (it's represented by its diagonal),
+ * B is diagonal as well, and the result is divided by the lumped mass matrix,
+ * so y is the solution on the current time step (except boundary nodes).
+ */
+class LeapfrogOperator
+{
+public:
+            /**
+             * Destructor
+             */
+  virtual ~LeapfrogOperator() { }
+
+            /**
+             * Apply the operator: y = coef_f * f + A u1 + B u2
+             * (and y = M_L^{-1} y in case of lumped mass matrix).
+             * The vectors f and y can be the same vector.
+             */
+  virtual void apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const = 0;
+
+            /**
+             * The order of the operator
+             */
+  virtual unsigned int order() const = 0;
+
+            /**
+             * Whether the operator can be applied in parts by several threads (see apply_part)
+             */
+  virtual bool partitioned() const { return false; }
+
+            /**
+             * Apply one part of the operator to the arrays of values: only the rows
+             * of this part of y are computed. Different parts don't share rows,
+             * so they are applied by different threads simultaneously without locks.
+             * The arrays f and y can be the same array
+             * @param part - the number of the part (from 0 to n_parts-1)
+             * @param n_parts - the number of parts
+             */
+  virtual void apply_part(const double *u1, const double *u2, double coef_f, const double *f, double *y,
+                          unsigned int part, unsigned int n_parts) const;
+
+            /**
+             * The part (see apply_part) where the row of y is computed
+             */
+  virtual unsigned int row_part(unsigned int row, unsigned int n_parts) const;
+
+            /**
+             * Place the arrays of the operator in the memory of the threads applying its parts:
+             * the arrays are reallocated, and each of n_parts threads (pinned according
+             * to the placement) copies the data of its part, so the pages are first touched
+             * by the thread which reads them in apply_part
+             */
+  virtual void distribute(const NumaPlacement &placement, unsigned int n_parts);
+
+protected:
+            /**
+             * The beginning of the part of the range [0, n) split into n_parts almost equal parts
+             */
+  static unsigned int part_begin(unsigned int n, unsigned int part, unsigned int n_parts);
+
+            /**
+             * The part of the range [0, n) split into n_parts almost equal parts containing i
+             */
+  static unsigned int part_of(unsigned int i, unsigned int n, unsigned int n_parts);
+};
+
+
+
+/**
+ * The leapfrog operator based on the assembled matrices.
+ * The matrices M and K have the same sparse structure, therefore
+ * A and B are kept on one CSR pattern, and the operator reads
+ * the values of both of them only once per application.
+ */
+class CSRLeapfrogOperator : public LeapfrogOperator
+{
+public:
+            /**
+             * Constructor
+             * @param mass_mat - global mass matrix
+             * @param stiff_mat - global stiffness matrix
+             * @param a_mass, a_stiff - coefficients of the operator A acting on u1
+             * @param b_mass, b_stiff - coefficients of the operator B acting on u2
+             * @param mass_diag - the diagonal of the lumped mass matrix,
+             *                    or NULL if the consistent mass matrix is used.
+             *                    In case of lumped mass matrix b_stiff must be 0
+             */
+  CSRLeapfrogOperator(Mat mass_mat, Mat stiff_mat,
+                      double a_mass, double a_stiff,
+                      double b_mass, double b_stiff,
+                      Vec mass_diag = NULL);
+
+  void apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const;
+
+  unsigned int order() const;
+
+            /**
+             * The parts are the ranges of rows
+             */
+  bool partitioned() const { return true; }
+  void apply_part(const double *u1, const double *u2, double coef_f, const double *f, double *y,
+                  unsigned int part, unsigned int n_parts) const;
+  unsigned int row_part(unsigned int row, unsigned int n_parts) const;
+  void distribute(const NumaPlacement &placement, unsigned int n_parts);
+
+private:
+            /**
+             * Compute the rows [row_beg, row_end) of y
+             */
+  void apply_rows(const double *u1, const double *u2, double coef_f, const double *f, double *y,
+                  unsigned int row_beg, unsigned int row_end) const;
+
+            /**
+             * CSR pattern shared by A and B
+             */
+  NumaArray<int> _row;
+  NumaArray<int> _col;
+
+            /**
+             * The values of the operator A
+             */
+  NumaArray<double> _a_values;
+
+            /**
+             * The values of the operator B (consistent mass),
+             * or its diagonal (lumped mass)
+             */
+  NumaArray<double> _b_values;
+
+            /**
+             * Inverse of the lumped mass matrix diagonal (empty in case of consistent mass)
+             */
+  NumaArray<double> _inv_mass;
+
+  friend class SellLeapfrogOperator; // it's converted from the CSR form
+};
+
+
+
+/**
+ * The leapfrog operator based on the assembled symmetric matrices,
+ * which are kept in the upper triangular form: the diagonals of A and B
+ * and their strictly upper triangular parts on one CSR pattern.
+ * Each off-diagonal entry is read once and applied to both positions (i, j) and (j, i),
+ * so the amount of matrix data read per application is about a half
+ * of the one read by CSRLeapfrogOperator.
+ */
+class SymmetricLeapfrogOperator : public LeapfrogOperator
+{
+public:
+            /**
+             * Constructor. The parameters are the same as for CSRLeapfrogOperator.
+             * The matrices must be symmetric - only their upper triangular parts are used
+             */
+  SymmetricLeapfrogOperator(Mat mass_mat, Mat stiff_mat,
+                            double a_mass, double a_stiff,
+                            double b_mass, double b_stiff,
+                            Vec mass_diag = NULL);
+
+  void apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const;
+
+  unsigned int order() const;
+
+private:
+            /**
+             * CSR pattern of the strictly upper triangular parts of A and B
+             */
+  std::vector<int> _row;
+  std::vector<int> _col;
+
+            /**
+             * The diagonals of the operators A and B
+             */
+  std::vector<double> _a_diag;
+  std::vector<double> _b_diag;
+
+            /**
+             * The strictly upper triangular parts of the operators A and B
+             * (the latter is empty in case of lumped mass matrix)
+             */
+  std::vector<double> _a_upper;
+  std::vector<double> _b_upper;
+
+            /**
+             * Inverse of the lumped mass matrix diagonal (empty in case of consistent mass)
+             */
+  std::vector<double> _inv_mass;
+};
+
+
+
+/**
+ * The leapfrog operator based on the assembled matrices kept in the sliced ELLPACK
+ * format (SELL-C-sigma). The rows are sorted by their lengths inside the windows
+ * of SIGMA rows, and then they are grouped into the chunks of CHUNK rows.
+ * The entries of each chunk are stored column by column (padded to the longest row
+ * of the chunk), so the inner loop goes over the rows of the chunk with unit stride,
+ * and it's vectorized by the compiler (see NATIVE_ARCH option in CMakeLists.txt).
+ * Column indices are 32-bit.
+ */
+class SellLeapfrogOperator : public LeapfrogOperator
+{
+public:
+            /**
+             * The number of rows in one chunk (the number of SIMD lanes
+             * of AVX-512 registers for doubles)
+             */
+  static const unsigned int CHUNK = 8;
+
+            /**
+             * The size of the window where the rows are sorted by their lengths
+             */
+  static const unsigned int SIGMA = 256;
+
+            /**
+             * Constructor. The parameters are the same as for CSRLeapfrogOperator
+             */
+  SellLeapfrogOperator(Mat mass_mat, Mat stiff_mat,
+                       double a_mass, double a_stiff,
+                       double b_mass, double b_stiff,
+                       Vec mass_diag = NULL);
+
+  void apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const;
+
+  unsigned int order() const;
+
+            /**
+             * The parts are the ranges of chunks
+             */
+  bool partitioned() const { return true; }
+  void apply_part(const double *u1, const double *u2, double coef_f, const double *f, double *y,
+                  unsigned int part, unsigned int n_parts) const;
+  unsigned int row_part(unsigned int row, unsigned int n_parts) const;
+  void distribute(const NumaPlacement &placement, unsigned int n_parts);
+
+            /**
+             * The ratio of the number of stored entries (including padding)
+             * to the number of nonzero entries
+             */
+  double fill_ratio() const;
+
+private:
+            /**
+             * The number of rows
+             */
+  unsigned int _n_rows;
+
+            /**
+             * The number of nonzero entries (without padding)
+             */
+  unsigned int _nnz;
+
+            /**
+             * The original numbers of the sorted rows
+             * (the size is a multiple of CHUNK, and padding rows are -1)
+             */
+  NumaArray<int> _perm;
+
+            /**
+             * The position of each row in the sorted order (the inverse of _perm)
+             */
+  std::vector<unsigned int> _slot;
+
+            /**
+             * The beginning of each chunk in the arrays of entries, and the width of each chunk
+             */
+  std::vector<unsigned int> _chunk_start;
+  std::vector<unsigned int> _chunk_width;
+
+            /**
+             * Column indices and values of A and B (the latter is empty in case of lumped mass).
+             * The entries of the chunk are stored column by column
+             */
+  NumaArray<int32_t> _col;
+  NumaArray<double> _a_values;
+  NumaArray<double> _b_values;
+
+            /**
+             * The diagonal of B, and inverse of the lumped mass matrix diagonal
+             * (both are empty in case of consistent mass)
+             */
+  NumaArray<double> _b_diag;
+  NumaArray<double> _inv_mass;
+
+            /**
+             * Compute the rows of the chunks [chunk_beg, chunk_end) of y
+             */
+  void apply_chunks(const double *u1, const double *u2, double coef_f, const double *f, double *y,
+                    unsigned int chunk_beg, unsigned int chunk_end) const;
+};
+
+
+/**
+ * The leapfrog operator based on the distributed (MPIAIJ) matrices. Each process applies
+ * its own rows of the operator to the ghosted vectors (see VecCreateGhost), whose ghost values
+ * are the entries of the other processes the rows need. The entries of the rows are split into
+ * the local part (the columns owned by the process) and the halo part (the ghost columns).
+ * The exchange of the ghost values is started first, the local part of all rows is computed
+ * while it's in progress, and then the rows having the halo entries are finished.
+ */
+class GhostedLeapfrogOperator : public LeapfrogOperator
+{
+public:
+            /**
+             * Constructor
+             * @param mass_mat - distributed mass matrix
+             * @param stiff_mat - distributed stiffness matrix
+             * @param ghosts - the ghost dofs of the vectors the operator is applied to
+             *                 (they must include all columns of the owned rows owned by other processes)
+             * @param a_mass, a_stiff - coefficients of the operator A acting on u1
+             * @param b_mass, b_stiff - coefficients of the operator B acting on u2
+             * @param mass_diag - the diagonal of the lumped mass matrix,
+             *                    or NULL if the consistent mass matrix is used.
+             *                    In case of lumped mass matrix b_stiff must be 0
+             */
+  GhostedLeapfrogOperator(Mat mass_mat, Mat stiff_mat, const std::vector<int> &ghosts,
+                          double a_mass, double a_stiff,
+                          double b_mass, double b_stiff,
+                          Vec mass_diag = NULL);
+
+            /**
+             * The vectors u1 and u2 must be ghosted with the ghosts given to the constructor.
+             * Their ghost values are updated here
+             */
+  void apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const;
+
+            /**
+             * The number of the rows owned by this process
+             */
+  unsigned int order() const;
+
+private:
+            /**
+             * The local part: the CSR format of the owned rows with local column indices
+             */
+  std::vector<int> _row;
+  std::vector<int> _col;
+  std::vector<double> _a_values;
+  std::vector<double> _b_values;
+
+            /**
+             * The halo part: the rows having ghost columns, the CSR format of their ghost entries,
+             * and the column indices in the ghost part of the vectors
+             */
+  std::vector<int> _halo_rows;
+  std::vector<int> _halo_row;
+  std::vector<int> _halo_col;
+  std::vector<double> _halo_a_values;
+  std::vector<double> _halo_b_values;
+
+            /**
+             * The inverse of the lumped mass matrix (empty in case of consistent mass).
+             * In this case B is diagonal, and _b_values keeps its diagonal
+             */
+  std::vector<double> _inv_mass;
+};
+
+
+
+#endif // LEAPFROG_OPERATOR_H
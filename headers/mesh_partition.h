@@ -0,0 +1,163 @@
+#ifndef MESH_PARTITION_H
+#define MESH_PARTITION_H
+
+#include "dof_partition.h"
+#include "dof_renumbering.h"
+#include "fem/fine_mesh.h"
+#include "fem/csr_pattern.h"
+#include "fem/mesh_element.h"
+#include <vector>
+#include <algorithm>
+
+
+/**
+ * Partition of the unstructured (triangular) mesh between MPI processes.
+ * The cells are distributed according to the partitions of the mesh file (gmsh partition tags),
+ * and each vertex is owned by the process with the smallest rank among the processes owning
+ * the cells around it. If the mesh file has no partitions (or there are fewer partitions than
+ * processes) the graph of the dofs is partitioned by recursive bisection (see graph_partition).
+ * The dofs are renumbered in such a way that the dofs of each process are a contiguous range
+ * of the global dofs (in the original order inside the range).
+ * Each process works with the cells touching its dofs: its own cells and the layer of the ghost
+ * cells around them. The local dofs are the dofs of the whole mesh (the mesh is read by each process).
+ */
+class MeshPartition : public DoFPartition
+{
+public:
+            /**
+             * Constructor
+             * @param fmesh - the triangular mesh (of the first order, so the dofs are the vertices)
+             * @param csr_pattern - the sparse pattern of the mesh (the graph of the dofs)
+             * @param rank - the number of this process
+             * @param n_ranks - the number of processes (it must not exceed the number of dofs)
+             */
+  MeshPartition(const fem::FineMesh &fmesh, const fem::CSRPattern &csr_pattern,
+                unsigned int rank, unsigned int n_ranks);
+
+  unsigned int rank() const;
+  unsigned int n_ranks() const;
+  unsigned int n_dofs() const;
+  unsigned int first_dof() const;
+  unsigned int n_owned_dofs() const;
+  std::vector<int> ghost_dofs() const;
+  unsigned int global_dof(unsigned int local_dof) const;
+  bool owns_dof(unsigned int local_dof) const;
+  std::vector<int> boundary_dofs() const;
+
+            /**
+             * Whether the cells are distributed by the partitions of the mesh file
+             * (otherwise by the graph partitioner)
+             */
+  bool from_mesh_file() const;
+
+            /**
+             * The process owning the dof
+             */
+  unsigned int owner(unsigned int dof) const;
+
+            /**
+             * The renumbering of the dofs into the global (PETSc) numbering
+             */
+  const DoFRenumbering& renumbering() const;
+
+            /**
+             * Whether the cell touches the dofs of this process, i.e. whether the cell
+             * is assembled by this process (it's an own cell or a ghost one)
+             */
+  bool local_cell(const fem::MeshElement &cell) const;
+
+            /**
+             * The owners of the dofs defined by the partitions of the mesh file:
+             * the partition p goes to the process p * n_ranks / n_partitions,
+             * and each dof goes to the process with the smallest rank among the processes of its cells
+             * @param cells - the cells of the mesh
+             * @param n_dofs - the number of dofs
+             * @param n_ranks - the number of processes
+             * @param owners - output owners of the dofs
+             * @return false if there are no partitions in the mesh or there are fewer partitions than processes
+             */
+  template <class Cell>
+  static bool tagged_partition(const std::vector<Cell> &cells, unsigned int n_dofs,
+                               unsigned int n_ranks, std::vector<int> &owners);
+
+            /**
+             * Partition of the graph of the dofs by recursive bisection.
+             * Each part is split in proportion to the numbers of the processes of its halves
+             * by the breadth-first search started from a pseudo-peripheral vertex of the part,
+             * so the halves are compact and the number of the cut edges is small
+             * @param csr_pattern - the sparse pattern (the graph of the dofs)
+             * @param n_parts - the number of parts
+             * @return the part of each dof
+             */
+  static std::vector<int> graph_partition(const fem::CSRPattern &csr_pattern, unsigned int n_parts);
+
+private:
+  unsigned int _rank, _n_ranks;
+
+            /**
+             * The process owning each dof
+             */
+  std::vector<int> _owners;
+
+            /**
+             * Whether the owners are defined by the partitions of the mesh file
+             */
+  bool _from_mesh_file;
+
+            /**
+             * The renumbering of the dofs into the global numbering
+             */
+  DoFRenumbering _renumbering;
+
+            /**
+             * The range of the owned global dofs
+             */
+  unsigned int _first_dof, _n_owned_dofs;
+
+            /**
+             * The ghost global dofs (in ascending order)
+             */
+  std::vector<int> _ghosts;
+
+            /**
+             * The owned boundary dofs
+             */
+  std::vector<int> _boundary_dofs;
+
+            /**
+             * The breadth-first search in the part of the graph
+             * @param csr_pattern - the graph
+             * @param pieces, piece - the vertices v with pieces[v] == piece are the vertices of the part
+             * @param start - the first vertex
+             * @param visited, mark - the vertices v with visited[v] == mark are already visited
+             *                        (the vertices are marked here)
+             * @param order - the reached vertices are appended to it in the order of the search
+             */
+  static void breadth_first_search(const fem::CSRPattern &csr_pattern, const std::vector<int> &pieces, int piece,
+                                   int start, std::vector<int> &visited, int mark, std::vector<int> &order);
+};
+
+
+
+template <class Cell>
+bool MeshPartition::tagged_partition(const std::vector<Cell> &cells, unsigned int n_dofs,
+                                     unsigned int n_ranks, std::vector<int> &owners)
+{
+  unsigned int n_partitions = 0;
+  for (unsigned int cell = 0; cell < cells.size(); ++cell)
+    n_partitions = std::max(n_partitions, cells[cell].partition_id() + 1);
+  if (n_partitions <= 1 || n_partitions < n_ranks)
+    return false;
+
+  owners.assign(n_dofs, n_ranks);
+  for (unsigned int cell = 0; cell < cells.size(); ++cell)
+  {
+    const int rank = (unsigned long long)cells[cell].partition_id() * n_ranks / n_partitions;
+    for (unsigned int i = 0; i < cells[cell].n_dofs(); ++i)
+      owners[cells[cell].dof(i)] = std::min(owners[cells[cell].dof(i)], rank);
+  }
+  return true;
+}
+
+
+#endif // MESH_PARTITION_H
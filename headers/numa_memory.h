@@ -0,0 +1,188 @@
+#ifndef NUMA_MEMORY_H
+#define NUMA_MEMORY_H
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+
+/**
+ * Placement of the threads and the memory on NUMA systems.
+ * Memory pages are placed on the NUMA node of the thread which touches them first,
+ * therefore the large arrays of the threaded time loop are allocated without touching
+ * (see NumaArray), and then each thread copies the part of the data it works with.
+ * To keep this placement the threads are pinned to the cores according to the pinning map,
+ * so the thread number t always runs on the core map[t % map.size()].
+ * The threads are pinned inside the parallel regions, where nothing may be thrown,
+ * so the map is checked against the cores available to the process in the constructor,
+ * and pin_thread only reports whether the thread is pinned.
+ */
+class NumaPlacement
+{
+public:
+            /**
+             * Constructor. No pinning, no huge pages
+             */
+  NumaPlacement();
+
+            /**
+             * Constructor
+             * @param pin_map - the list of cores for the threads, for example "0-15,32-47"
+             *                  (empty string means that the threads are not pinned)
+             * @param huge_pages - whether the large arrays use (transparent) huge pages
+             * It throws if some core of the map is not available to the process
+             */
+  NumaPlacement(const std::string &pin_map, bool huge_pages);
+
+            /**
+             * Whether the large arrays use huge pages
+             */
+  bool huge_pages() const;
+
+            /**
+             * Pin the calling thread to the core of the map (if the map is not empty).
+             * It doesn't throw, so it can be called inside the parallel regions
+             * @param thread - the number of the thread in the team
+             * @return false if the thread couldn't be pinned
+             */
+  bool pin_thread(unsigned int thread) const;
+
+            /**
+             * Parse the list of cores like "0-3,8,10-11"
+             */
+  static std::vector<int> parse_cores(const std::string &pin_map);
+
+            /**
+             * Allocate the memory without touching it (the pages are mapped on the first touch)
+             * @param n_bytes - the size of the memory
+             * @param huge_pages - whether the memory should use transparent huge pages
+             */
+  static void* allocate(size_t n_bytes, bool huge_pages);
+
+            /**
+             * Free the memory allocated by allocate
+             */
+  static void deallocate(void *data, size_t n_bytes);
+
+private:
+            /**
+             * The cores for the threads
+             */
+  std::vector<int> _cores;
+
+            /**
+             * Whether the large arrays use huge pages
+             */
+  bool _huge_pages;
+};
+
+
+
+/**
+ * The array of plain data which is not touched (initialized) on allocation,
+ * so its pages are placed on the NUMA nodes of the threads writing to them first.
+ */
+template <typename T>
+class NumaArray
+{
+public:
+            /**
+             * Constructor. Empty array
+             */
+  NumaArray()
+    : _data(NULL), _size(0)
+  { }
+
+            /**
+             * Destructor
+             */
+  ~NumaArray()
+  {
+    clear();
+  }
+
+            /**
+             * Allocate the memory for n elements (they are not initialized).
+             * The previous contents are freed
+             */
+  void allocate(size_t n, bool huge_pages = false)
+  {
+    clear();
+    if (n == 0)
+      return;
+    _data = static_cast<T*>(NumaPlacement::allocate(n * sizeof(T), huge_pages));
+    _size = n;
+  }
+
+            /**
+             * Allocate the memory and copy the values (by the calling thread)
+             */
+  void assign(const T *values, size_t n)
+  {
+    allocate(n);
+    if (n > 0)
+      memcpy(_data, values, n * sizeof(T));
+  }
+
+  void assign(const std::vector<T> &values)
+  {
+    assign(values.empty() ? NULL : &values[0], values.size());
+  }
+
+            /**
+             * Copy the elements [beg, end) of another array of the same size.
+             * It's used by several threads to copy their parts of the data
+             */
+  void copy_range(const NumaArray &src, size_t beg, size_t end)
+  {
+    end = std::min(end, _size);
+    if (beg < end)
+      memcpy(_data + beg, src._data + beg, (end - beg) * sizeof(T));
+  }
+
+            /**
+             * Exchange the contents of the arrays
+             */
+  void swap(NumaArray &other)
+  {
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+  }
+
+            /**
+             * Free the memory
+             */
+  void clear()
+  {
+    if (_data != NULL)
+      NumaPlacement::deallocate(_data, _size * sizeof(T));
+    _data = NULL;
+    _size = 0;
+  }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  T* data() { return _data; }
+  const T* data() const { return _data; }
+  T& operator[](size_t i) { return _data[i]; }
+  const T& operator[](size_t i) const { return _data[i]; }
+
+private:
+            /**
+             * The elements
+             */
+  T *_data;
+
+            /**
+             * The number of the elements
+             */
+  size_t _size;
+
+  NumaArray(const NumaArray&); /** copy constructor */
+  NumaArray& operator=(const NumaArray&); /** copy assignment operator */
+};
+
+
+#endif // NUMA_MEMORY_H
@@ -0,0 +1,92 @@
+#ifndef OUTPUT_WINDOW_H
+#define OUTPUT_WINDOW_H
+
+#include <vector>
+
+
+/**
+ * The part of the rectangular grid which is saved by the output: the vertices inside
+ * the rectangular window (in physical coordinates) taken with the stride in each direction.
+ * The selected vertices form the coarser uniform lattice of n_cols x n_rows vertices
+ * with the origin (x_beg, y_beg) and the spacing (hx, hy).
+ * The vertices of the grid are numbered row by row, and the values of a part of the grid
+ * (e.g. a strip of a distributed run) are the values of the consecutive rows of vertices.
+ */
+class OutputWindow
+{
+public:
+            /**
+             * Constructor
+             * @param x_beg, x_end, y_beg, y_end - the domain of the grid
+             * @param nx, ny - the number of cells of the grid in x- and y-directions
+             * @param win_x_beg, win_x_end, win_y_beg, win_y_end - the window (it's clipped by the domain)
+             * @param stride - every stride-th vertex of the window is saved in each direction
+             */
+  OutputWindow(double x_beg, double x_end, double y_beg, double y_end,
+               unsigned int nx, unsigned int ny,
+               double win_x_beg, double win_x_end, double win_y_beg, double win_y_end,
+               unsigned int stride);
+
+            /**
+             * The number of the selected vertices in x- and y-directions, and the total number of them
+             */
+  unsigned int n_cols() const;
+  unsigned int n_rows() const;
+  unsigned int n_vertices() const;
+
+            /**
+             * The first selected column and row of the vertices of the grid, and the stride
+             */
+  unsigned int col_beg() const;
+  unsigned int row_beg() const;
+  unsigned int stride() const;
+
+            /**
+             * The origin and the spacing of the lattice of the selected vertices
+             */
+  double x_beg() const;
+  double y_beg() const;
+  double hx() const;
+  double hy() const;
+
+            /**
+             * Whether the window is the whole grid (so everything is saved)
+             */
+  bool whole_grid() const;
+
+            /**
+             * The selected rows among the rows of the vertices of the grid [vrow_beg, vrow_end)
+             * @param first - output number of the first of them among the selected rows
+             * @param n - output number of them
+             */
+  void select_rows(unsigned int vrow_beg, unsigned int vrow_end, unsigned int &first, unsigned int &n) const;
+
+            /**
+             * The positions of the selected vertices of the rows [vrow_beg, vrow_end) (row by row)
+             * in the array of the values of the rows of the vertices starting from the row first_vrow
+             */
+  std::vector<unsigned int> vertices(unsigned int vrow_beg, unsigned int vrow_end, unsigned int first_vrow) const;
+
+            /**
+             * The positions of the cells of the grid representing the cells of the lattice of the selected vertices
+             * of the rows [vrow_beg, vrow_end) (the cell of the grid at the lower left corner of each coarse cell)
+             * in the array of the values of the rows of the cells starting from the row first_cell_row
+             */
+  std::vector<unsigned int> cells(unsigned int vrow_beg, unsigned int vrow_end, unsigned int first_cell_row) const;
+
+            /**
+             * Gather the values at the positions
+             * @param values - the values of the part of the grid
+             * @param positions - the positions (see vertices and cells)
+             * @param selected - output values
+             */
+  static void gather(const double *values, const std::vector<unsigned int> &positions, std::vector<double> &selected);
+
+private:
+  unsigned int _nx, _ny;
+  double _x_beg, _y_beg, _hx, _hy;
+  unsigned int _col_beg, _row_beg, _n_cols, _n_rows, _stride;
+};
+
+
+#endif // OUTPUT_WINDOW_H
@@ -13,6 +13,21 @@ enum TIME_SCHEMES
   CRANK_NICOLSON // sort of implicit scheme
 };
 
+enum DOF_ORDERINGS
+{
+  NATURAL_ORDERING, // the numbering of the mesh (gmsh nodes or row-major grid)
+  RCM_ORDERING,     // reverse Cuthill-McKee
+  MORTON_ORDERING,  // Z-order curve (rectangular grid only)
+  TILED_ORDERING    // square tiles (rectangular grid only)
+};
+
+enum SOL_FORMATS
+{
+  TEXT_SOLUTION,        // text file sol-<step>.dat for each saved time step
+  BINARY_SOLUTION,      // one binary file sol.bin with all saved time steps (see SolutionFile)
+  BINARY_FLOAT_SOLUTION // the same binary file with the values of the single precision
+};
+
 
 
 class Parameters
@@ -35,6 +50,85 @@ public:
              */
   int TIME_SCHEME;
 
+            /**
+             * Whether the mass matrix of the explicit scheme is lumped (replaced by
+             * a diagonal matrix of its row sums) or not. The lumped scheme doesn't
+             * require a solution of SLAE on each time step
+             */
+  bool MASS_LUMPING;
+
+            /**
+             * Whether the mass and stiffness matrices of the rectangular grid
+             * are assembled, or they are applied matrix-free as the Q1 stencils
+             * (explicit scheme only)
+             */
+  bool MATRIX_FREE;
+
+            /**
+             * Whether the symmetric mass and stiffness matrices are kept (and applied)
+             * in the upper triangular form only, or in the full form.
+             * It's used with the assembled matrices only (not MATRIX_FREE)
+             */
+  bool SYMMETRIC_STORAGE;
+
+            /**
+             * Whether the assembled matrices are applied in the time loop in the sliced
+             * ELLPACK format (SELL-C-sigma), or in the CSR one.
+             * It's used with the full assembled matrices only (not MATRIX_FREE, not SYMMETRIC_STORAGE)
+             */
+  bool SELL_FORMAT;
+
+            /**
+             * The number of applications of the operator of the explicit scheme in each
+             * of the available formats (PETSc AIJ, CSR, symmetric CSR, SELL-C-sigma)
+             * to compare their time before the time loop. 0 means no benchmark
+             */
+  unsigned int SPMV_BENCHMARK;
+
+            /**
+             * The ordering of the degrees of freedom in the global matrices and vectors
+             * (see DOF_ORDERINGS). It's used with the assembled matrices only (not MATRIX_FREE)
+             */
+  int DOF_ORDERING;
+
+            /**
+             * The number of threads used for assembling the matrices and in the threaded time loop
+             * (0 means the default number of OpenMP threads, i.e. all cores).
+             * The code must be compiled with OpenMP support (see USE_OPENMP in CMakeLists.txt)
+             */
+  unsigned int N_THREADS;
+
+            /**
+             * Whether the time loop of the explicit scheme with lumped mass matrix is executed
+             * by N_THREADS threads (each thread computes its own part of the rows on each time step),
+             * or sequentially with PETSc vectors. It's used with CSR and SELL-C-sigma operators
+             */
+  bool THREADED_LOOP;
+
+            /**
+             * The cores for the threads of the threaded time loop, for example "0-31,64-95"
+             * (the thread t is pinned to the t-th core of the list). Empty string means no pinning
+             */
+  std::string PIN_MAP;
+
+            /**
+             * Whether the arrays of the threaded time loop use transparent huge pages
+             */
+  bool HUGE_PAGES;
+
+            /**
+             * Whether the problem is solved by several MPI processes. Each of them has its own
+             * horizontal strip of the rectangular grid (see Acoustic2D::solve_rectangles_distributed),
+             * or its own part of the triangular mesh (see MeshPartition)
+             */
+  bool DISTRIBUTED;
+
+            /**
+             * Whether the problem is solved on the rectangular grid (N_FINE_X x N_FINE_Y cells)
+             * instead of the triangular mesh from MESH_FILE
+             */
+  bool RECT_GRID;
+
             /**
              * The limits of the 2D computational domain.
              * The points (X_BEG, Y_BEG) and (X_END, Y_END) are the mesh nodes only if the domain is rectangular.
@@ -154,6 +248,26 @@ public:
              */
   std::string COEF_DIR;
 
+            /**
+             * Whether the coefficients distribution is saved in binary format (see CoefficientsFile)
+             * or in text one. Saved files are read in any format
+             */
+  bool COEF_BINARY;
+
+            /**
+             * If it's not empty, the file with coefficients COEF_FILE is converted
+             * from text format to binary one (or vice versa) into this file, and nothing else is done
+             */
+  std::string COEF_CONVERT_FILE;
+
+            /**
+             * Whether the coefficients distributed according to the layers file are cached in COEF_DIR.
+             * The cache file is identified by the hash of the layers file contents,
+             * the domain extents, the grid (N_FINE_X, N_FINE_Y) and USE_AVERAGED,
+             * so the same distribution is computed only once
+             */
+  bool COEF_CACHE;
+
 //            /**
 //             * The layers are distributed in parallel to each other, but probably not horizontally.
 //             * This angle (in degrees, not radians) describes the slope of the layers.
@@ -218,6 +332,13 @@ public:
              */
   bool PRINT_VTU;
 
+            /**
+             * Whether the results on the rectangular grid are written as the binary VTK series (see VTKSeries):
+             * .vti files with raw binary data, the coefficients written once, and the .pvd index.
+             * Otherwise each time step is a .vts file with the whole geometry
+             */
+  bool VTK_BINARY;
+
             /**
              * Whether we need to save .dat files or not
              */
@@ -243,6 +364,58 @@ public:
              */
   unsigned int SOL_STEP;
 
+            /**
+             * The format of the saved solutions (see SOL_FORMATS)
+             */
+  int SOL_FORMAT;
+
+            /**
+             * If it's not empty, the snapshots of this binary solution file are extracted
+             * into the text files (sol-<step>.dat) in the same directory, and nothing else is done
+             */
+  std::string SOL_EXTRACT_FILE;
+
+            /**
+             * The window of the rectangular grid whose vertices are saved by the output
+             * (.vts/.vti and .dat/.bin files). It's the whole domain by default (see OutputWindow)
+             */
+  double OUT_X_BEG, OUT_X_END, OUT_Y_BEG, OUT_Y_END;
+
+            /**
+             * Every (OUT_STRIDE)-th vertex of the output window is saved in each direction.
+             * A distributed run requires 1, so the pieces of the strips are joined
+             */
+  unsigned int OUT_STRIDE;
+
+            /**
+             * The text file with the points of the receivers ("x y" per line, see Receivers::read)
+             */
+  std::string RECEIVERS_FILE;
+
+            /**
+             * The lines of the receivers: "x0,y0,x1,y1,n" separated by ';' (see Receivers::lines).
+             * The receivers of the lines are added to the receivers of RECEIVERS_FILE
+             */
+  std::string RECEIVER_LINES;
+
+            /**
+             * The name of the SEG-Y file with the traces of the receivers recorded on every time step.
+             * This file is in the RES_DIR directory
+             */
+  std::string SEISMOGRAM_FILE;
+
+            /**
+             * The number of the threads writing the results in the background while the time loop goes on.
+             * 0 means that the results are written by the time loop itself
+             */
+  unsigned int IO_THREADS;
+
+            /**
+             * The number of the buffers for the snapshots of the asynchronous output.
+             * If all of them are being written, the time loop waits for a free one
+             */
+  unsigned int IO_BUFFERS;
+
             /**
              * Constructor
              * @param argc - the number of command line arguments (+1 - the first argument is the name of the executable by default)
@@ -0,0 +1,167 @@
+#ifndef Q1_STENCIL_H
+#define Q1_STENCIL_H
+
+#include "fem/fine_mesh.h"
+#include "leapfrog_operator.h"
+#include "petscvec.h"
+#include "petscmat.h"
+#include <vector>
+
+
+/**
+ * Matrix-free mass and stiffness operators of the first order (Q1) elements
+ * on the uniform rectangular grid created by FineMesh::create_rectangular_grid.
+ * All cells of such a grid are the same, therefore the local matrices of all cells
+ * are the reference ones scaled by the cell coefficients, and the global operators
+ * are the 9-point stencils applied directly to the (nx+1)x(ny+1) array of vertices.
+ * The operators are applied row by row of cells. Each row is processed by
+ * unit-stride loops over the cells, which are vectorized by the compiler
+ * (see NATIVE_ARCH option in CMakeLists.txt to use AVX2/AVX-512 instructions).
+ */
+class Q1Stencil
+{
+public:
+            /**
+             * The number of dofs of the cell
+             */
+  static const unsigned int n_dofs = 4;
+
+            /**
+             * Constructor
+             * @param fmesh - the rectangular grid
+             * @param nx, ny - the number of cells in x- and y-directions
+             * @param coef_alpha - the coefficient of the mass matrix (one per cell)
+             * @param coef_beta - the coefficient of the stiffness matrix (one per cell)
+             */
+  Q1Stencil(const fem::FineMesh &fmesh, unsigned int nx, unsigned int ny,
+            const std::vector<double> &coef_alpha, const std::vector<double> &coef_beta);
+
+            /**
+             * The order of the operators (the number of vertices of the grid)
+             */
+  unsigned int order() const;
+
+            /**
+             * The number of vertices in one row of the grid
+             */
+  unsigned int row_length() const;
+
+            /**
+             * The number of rows of cells
+             */
+  unsigned int n_cell_rows() const;
+
+            /**
+             * y = (c_mass * M + c_stiff * K) x.
+             * The arrays x and y must not overlap
+             */
+  void mult(double c_mass, double c_stiff, const double *x, double *y) const;
+
+            /**
+             * Add the contribution of one row of cells to the vector y:
+             * y += (c_mass * M_iy + c_stiff * K_iy) x,
+             * where M_iy and K_iy are the parts of the matrices assembled from the cells of the row iy.
+             * Only the vertices of the rows iy and iy+1 are changed.
+             * The arrays x and y must not overlap
+             */
+  void add_cell_row(unsigned int iy, double c_mass, double c_stiff, const double *x, double *y) const;
+
+            /**
+             * The diagonal of the operator (c_mass * M + c_stiff * K)
+             */
+  void diagonal(double c_mass, double c_stiff, double *d) const;
+
+            /**
+             * The row sums of the mass matrix (the lumped mass matrix)
+             */
+  void mass_row_sums(double *d) const;
+
+            /**
+             * Create a shell matrix (c_mass * M + c_stiff * K) with the Dirichlet boundary condition
+             * imposed the same way as MatZeroRows does with ones on diagonal.
+             * The shell supports multiplication and extraction of the diagonal (for Jacobi preconditioner).
+             * The stencil and the list of boundary nodes must live longer than the matrix
+             */
+  void create_system_matrix(double c_mass, double c_stiff, const std::vector<int> &b_nodes, Mat *mat) const;
+
+private:
+            /**
+             * The number of cells in x- and y-directions
+             */
+  unsigned int _nx, _ny;
+
+            /**
+             * Reference local mass and stiffness matrices (with coefficients equal to 1).
+             * The local numbering of the cell (ix, iy) vertices is
+             * 0 - (ix, iy), 1 - (ix+1, iy), 2 - (ix, iy+1), 3 - (ix+1, iy+1)
+             */
+  double _mass[n_dofs][n_dofs];
+  double _stiff[n_dofs][n_dofs];
+
+            /**
+             * Coefficients of the mass and stiffness matrices (one per cell)
+             */
+  const std::vector<double> &_coef_alpha;
+  const std::vector<double> &_coef_beta;
+
+  Q1Stencil(const Q1Stencil&); /** copy constructor */
+  Q1Stencil& operator=(const Q1Stencil&); /** copy assignment operator */
+};
+
+
+
+/**
+ * The leapfrog operator based on the matrix-free Q1 stencil.
+ * The rows of the vertices are finished (including the division by the lumped
+ * mass matrix) as soon as both rows of cells around them are processed,
+ * so each vector is read from memory once per application.
+ */
+class Q1LeapfrogOperator : public LeapfrogOperator
+{
+public:
+            /**
+             * Constructor
+             * @param stencil - the matrix-free operators
+             * @param a_mass, a_stiff - coefficients of the operator A acting on u1
+             * @param b_mass, b_stiff - coefficients of the operator B acting on u2
+             * @param mass_diag - the diagonal of the lumped mass matrix,
+             *                    or NULL if the consistent mass matrix is used.
+             *                    In case of lumped mass matrix b_stiff must be 0
+             */
+  Q1LeapfrogOperator(const Q1Stencil &stencil,
+                     double a_mass, double a_stiff,
+                     double b_mass, double b_stiff,
+                     Vec mass_diag = NULL);
+
+  void apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const;
+
+  unsigned int order() const;
+
+private:
+            /**
+             * The matrix-free operators
+             */
+  const Q1Stencil &_stencil;
+
+            /**
+             * Coefficients of the operators A and B
+             */
+  double _a_mass, _a_stiff, _b_mass, _b_stiff;
+
+            /**
+             * The diagonal parts of A and B, and inverse of the lumped mass matrix
+             * (empty in case of consistent mass)
+             */
+  std::vector<double> _a_diag;
+  std::vector<double> _b_diag;
+  std::vector<double> _inv_mass;
+
+            /**
+             * Finish the row iy of vertices in case of lumped mass matrix:
+             * add the diagonal parts of A and B, and divide by the lumped mass matrix
+             */
+  void finish_lumped_row(unsigned int iy, const double *u1, const double *u2, double *y) const;
+};
+
+
+#endif // Q1_STENCIL_H
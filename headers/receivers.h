@@ -0,0 +1,164 @@
+#ifndef RECEIVERS_H
+#define RECEIVERS_H
+
+#include "fem/point.h"
+#include "fem/triangle.h"
+#include "petscvec.h"
+#include "dof_renumbering.h"
+#include <string>
+#include <vector>
+
+
+/**
+ * The receivers recording the solution at given points on every time step.
+ * Each receiver is located in the mesh only once: its value is the weighted sum
+ * of the values at (at most) MAX_VERTICES vertices - the bilinear interpolation
+ * in the cell of the rectangular grid, or the linear (barycentric) interpolation
+ * in the triangle. The weights are computed by locate_in_grid or locate_in_mesh,
+ * and the vertices are mapped to the positions in the vectors of the time loop by distribute,
+ * so a time step costs MAX_VERTICES multiplications per receiver.
+ *
+ * The traces are written at the end as one gather in SEG-Y format (rev. 1):
+ * the 3200-byte text header (ASCII), the 400-byte binary header, and then
+ * the traces, each of them is the 240-byte trace header and the samples
+ * (IEEE floats, format code 5). All numbers are big-endian.
+ */
+class Receivers
+{
+public:
+            /**
+             * The maximal number of vertices whose values define the value at a receiver
+             */
+  static const unsigned int MAX_VERTICES = 4;
+
+            /**
+             * Constructor
+             * @param points - the points of the receivers
+             */
+  Receivers(const std::vector<fem::Point> &points);
+
+            /**
+             * Read the points of the receivers from the text file. Each line is "x y",
+             * and the empty lines and the lines beginning with '#' are skipped
+             */
+  static std::vector<fem::Point> read(const std::string &filename);
+
+            /**
+             * Generate the points of the receivers on the lines. The description is a list
+             * of lines separated by ';', each of them is "x0,y0,x1,y1,n" - n receivers uniformly
+             * distributed from (x0, y0) to (x1, y1) including the ends
+             */
+  static std::vector<fem::Point> lines(const std::string &description);
+
+            /**
+             * The number of receivers
+             */
+  unsigned int n_receivers() const;
+
+            /**
+             * The point of the receiver
+             */
+  fem::Point point(unsigned int receiver) const;
+
+            /**
+             * Locate the receivers in the rectangular grid with the vertices numbered row by row
+             * (x-direction first). The cell of each receiver is found by arithmetic
+             * @param x_beg, x_end, y_beg, y_end - the domain of the grid
+             * @param nx, ny - the number of cells in x- and y-directions
+             */
+  void locate_in_grid(double x_beg, double x_end, double y_beg, double y_end,
+                      unsigned int nx, unsigned int ny);
+
+            /**
+             * Locate the receivers in the triangular mesh (of the first order, so the dofs
+             * are the vertices). The triangles are sorted into the buckets of a uniform grid
+             * covering the mesh, so each receiver is tested against the triangles of its bucket only
+             * @param vertices - the vertices of the mesh
+             * @param triangles - the triangles of the mesh
+             */
+  void locate_in_mesh(const std::vector<fem::Point> &vertices, const std::vector<fem::Triangle> &triangles);
+
+            /**
+             * The vertices and the weights of the receiver (MAX_VERTICES of each, the unused weights are zero)
+             */
+  const unsigned int* vertices(unsigned int receiver) const;
+  const double* weights(unsigned int receiver) const;
+
+            /**
+             * Map the vertices of the receivers to the positions in the vectors of the time loop.
+             * The vertices whose dofs are not owned by this process are skipped, so in a distributed run
+             * each process records its part of the sum, and the parts are summed up before writing
+             * @param renumbering - the numbering of the dofs of the vectors
+             * @param first_dof - the first dof owned by this process (the first value of the vectors)
+             * @param n_owned_dofs - the number of owned dofs
+             */
+  void distribute(const DoFRenumbering &renumbering, unsigned int first_dof, unsigned int n_owned_dofs);
+
+            /**
+             * Record the values at the receivers on the next time step
+             * @param values - the values of the owned dofs (see distribute)
+             */
+  void record(const double *values);
+
+            /**
+             * Record the values at the receivers on the next time step
+             * @param values - the vector whose local part is the owned dofs
+             */
+  void record(Vec values);
+
+            /**
+             * The number of recorded time steps (the number of samples of each trace)
+             */
+  unsigned int n_samples() const;
+
+            /**
+             * The recorded sample of the receiver
+             */
+  double sample(unsigned int receiver, unsigned int step) const;
+
+            /**
+             * All recorded samples (time step by time step). They are summed up between the processes
+             * of a distributed run before writing
+             */
+  std::vector<double>& samples();
+
+            /**
+             * Write the traces of the receivers in SEG-Y format
+             * @param filename - the name of the file
+             * @param dt - the time between the samples
+             * @param time_beg - the time of the first sample
+             */
+  void write_segy(const std::string &filename, double dt, double time_beg) const;
+
+            /**
+             * The scale of the coordinates of the receivers in the trace headers:
+             * they are integers, so the coordinates are multiplied by COORD_SCALE
+             */
+  static const int COORD_SCALE = 10000;
+
+private:
+            /**
+             * The points of the receivers
+             */
+  std::vector<fem::Point> _points;
+
+            /**
+             * MAX_VERTICES vertices and weights of each receiver
+             */
+  std::vector<unsigned int> _vertices;
+  std::vector<double> _weights;
+
+            /**
+             * MAX_VERTICES positions of the values of each receiver in the vectors of the time loop
+             * (-1 for the values which are not used)
+             */
+  std::vector<int> _positions;
+
+            /**
+             * The recorded samples (n_receivers values of each time step)
+             */
+  std::vector<double> _samples;
+};
+
+
+#endif // RECEIVERS_H
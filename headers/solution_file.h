@@ -0,0 +1,252 @@
+#ifndef SOLUTION_FILE_H
+#define SOLUTION_FILE_H
+
+#include "petscvec.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <stdint.h>
+
+
+/**
+ * Binary container with the snapshots of the solution of one run.
+ * The file is appended snapshot by snapshot during the time loop (see SolutionWriter),
+ * and it consists of a header of 64 bytes, the records of the snapshots,
+ * and the index of the snapshots written at the end:
+ *
+ * magic        8 bytes   "FEM2DSO" with trailing zero
+ * version      uint32    the version of the format (VERSION)
+ * byte order   uint32    0x01020304 written on the host machine
+ * value type   uint32    FLOAT64 or FLOAT32
+ * nx, ny       uint32    the number of cells of the rectangular grid or of the output window (0 for the triangular mesh)
+ * piece        int32     the rank of the process whose part of the domain is kept (-1 for the whole domain)
+ * n_values     uint64    the number of values in a snapshot
+ * n_snapshots  uint64    the number of snapshots (it's set when the file is closed)
+ * index offset uint64    the position of the index in the file (0 until the file is closed)
+ * reserved     uint64
+ *
+ * Each record is the time (double), the time step (uint64) and n_values values of the value type
+ * (padded to 8 bytes). All records have the same size, so the snapshot i starts at
+ * the offset 64 + i * record_size, and the file without the index (e.g. if the run was interrupted)
+ * is still read. The index keeps the time step, the time and the offset of each snapshot
+ * ordered by the time steps (24 bytes per snapshot).
+ *
+ * The file is read via memory mapping, so the values of any snapshot are available without parsing.
+ */
+class SolutionFile
+{
+public:
+            /**
+             * The type of the values of the snapshots
+             */
+  enum ValueType { FLOAT64 = 0, FLOAT32 = 1 };
+
+            /**
+             * The current version of the format
+             */
+  static const uint32_t VERSION = 1;
+
+            /**
+             * Open the file and map it into memory. The header and the index are checked
+             * @param filename - the name of the binary file
+             */
+  SolutionFile(const std::string &filename);
+
+            /**
+             * Destructor. The file is unmapped
+             */
+  ~SolutionFile();
+
+  ValueType value_type() const;
+  unsigned int nx() const;
+  unsigned int ny() const;
+  int piece() const;
+  uint64_t n_values() const;
+
+            /**
+             * The number of snapshots in the file
+             */
+  uint64_t n_snapshots() const;
+
+            /**
+             * The time step and the time of the snapshot
+             * @param snapshot - the number of the snapshot (in the order of the time steps)
+             */
+  uint64_t step(uint64_t snapshot) const;
+  double time(uint64_t snapshot) const;
+
+            /**
+             * The number of the snapshot of the time step (binary search over the index)
+             * @return -1 if there is no such time step in the file
+             */
+  long long find(uint64_t step) const;
+
+            /**
+             * The values of the snapshot of the double (FLOAT64) or float (FLOAT32) file
+             * (they point to the mapped memory)
+             */
+  const double* values(uint64_t snapshot) const;
+  const float* float_values(uint64_t snapshot) const;
+
+            /**
+             * Copy the values of the snapshot of the file of any value type
+             * @param snapshot - the number of the snapshot
+             * @param vals - output values
+             */
+  void get_values(uint64_t snapshot, std::vector<double> &vals) const;
+
+            /**
+             * Extract the snapshots of the binary file into the text files of the same layout
+             * which is used for SOL_DIR: sol-<step>.dat (or sol-<step>-p<piece>.dat for a part of the domain)
+             * with one value per line
+             * @param filename - the binary file
+             * @param out_dir - the directory for the text files
+             * @return the number of extracted snapshots
+             */
+  static uint64_t extract(const std::string &filename, const std::string &out_dir);
+
+private:
+            /**
+             * The header of the file
+             */
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t value_type;
+    uint32_t nx, ny;
+    int32_t piece;
+    uint64_t n_values;
+    uint64_t n_snapshots;
+    uint64_t index_offset;
+    uint64_t reserved;
+  };
+
+            /**
+             * The entry of the index
+             */
+  struct IndexEntry
+  {
+    uint64_t step;
+    double time;
+    uint64_t offset;
+  };
+
+  static const char MAGIC[8];
+  static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+            /**
+             * The size of a record of the snapshot with n_values values of the value type
+             */
+  static uint64_t record_size(uint64_t n_values, ValueType value_type);
+
+            /**
+             * The order of the entries of the index
+             */
+  static bool step_less(const IndexEntry &a, const IndexEntry &b);
+
+            /**
+             * The beginning of the mapped file and its size in bytes
+             */
+  void *_data;
+  size_t _size;
+
+            /**
+             * The header in the mapped memory
+             */
+  const Header *_header;
+
+            /**
+             * The index of the snapshots. If the file has an index, it's a copy of it,
+             * otherwise it's recovered from the records
+             */
+  std::vector<IndexEntry> _index;
+
+            /**
+             * The beginning of the values of the snapshot in the mapped memory
+             */
+  const char* record_values(uint64_t snapshot) const;
+
+  SolutionFile(const SolutionFile&); /** copy constructor */
+  SolutionFile& operator=(const SolutionFile&); /** copy assignment operator */
+
+  friend class SolutionWriter;
+};
+
+
+
+/**
+ * Writer of the binary container of the snapshots (see SolutionFile).
+ * The values are written directly from the arrays of the vectors (float values are converted
+ * by small chunks), and the snapshots may be appended by several threads (e.g. by the I/O threads
+ * of AsyncWriter) - the records are appended in the order of the calls.
+ */
+class SolutionWriter
+{
+public:
+            /**
+             * Constructor. The file is created, and the header is written
+             * @param filename - the name of the file
+             * @param n_values - the number of values in a snapshot
+             * @param value_type - the type of the values in the file
+             * @param nx, ny - the number of cells of the rectangular grid (0 for the triangular mesh)
+             * @param piece - the rank of the process whose part of the domain is written (-1 for the whole domain)
+             */
+  SolutionWriter(const std::string &filename, uint64_t n_values, SolutionFile::ValueType value_type,
+                 unsigned int nx = 0, unsigned int ny = 0, int piece = -1);
+
+            /**
+             * Destructor. The file is closed if it hasn't been yet
+             */
+  ~SolutionWriter();
+
+            /**
+             * Append the snapshot
+             * @param step - the time step
+             * @param time - the time of the snapshot
+             * @param values - the sequential vector
+             * @param first - the first of n_values values of the vector to be written
+             */
+  void append(uint64_t step, double time, Vec values, uint64_t first = 0);
+
+            /**
+             * Append the snapshot
+             * @param step - the time step
+             * @param time - the time of the snapshot
+             * @param values - n_values values
+             */
+  void append(uint64_t step, double time, const double *values);
+
+            /**
+             * Write the index and finalize the header
+             */
+  void close();
+
+private:
+  std::string _filename;
+  std::ofstream _out;
+  SolutionFile::Header _header;
+
+            /**
+             * The index of the written snapshots
+             */
+  std::vector<SolutionFile::IndexEntry> _index;
+
+            /**
+             * The position of the next record
+             */
+  uint64_t _offset;
+
+            /**
+             * The appending is serialized by this mutex
+             */
+  std::mutex _mutex;
+
+  SolutionWriter(const SolutionWriter&); /** copy constructor */
+  SolutionWriter& operator=(const SolutionWriter&); /** copy assignment operator */
+};
+
+
+#endif // SOLUTION_FILE_H
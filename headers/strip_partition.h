@@ -0,0 +1,130 @@
+#ifndef STRIP_PARTITION_H
+#define STRIP_PARTITION_H
+
+#include "dof_partition.h"
+#include <vector>
+
+
+/**
+ * Partition of the uniform rectangular grid (nx x ny cells) between MPI processes by horizontal strips.
+ * The vertices are numbered row by row (as FineMesh::create_rectangular_grid does), so each process
+ * owns a contiguous range of the rows of vertices, and therefore a contiguous range of the global dofs
+ * (the same range PETSc uses for the distributed vectors and matrices).
+ * Each process keeps the strip of the rows of cells touching its vertices: its own rows of vertices
+ * and at most one ghost row below and above them. The vertices of the strip are numbered row by row too,
+ * so the global dof of the local vertex differs from its local number by the constant shift.
+ * The rows of cells are owned by the process owning the lower row of their vertices.
+ */
+class StripPartition : public DoFPartition
+{
+public:
+            /**
+             * Constructor
+             * @param nx, ny - the number of cells of the whole grid in x- and y-directions
+             * @param rank - the number of this process
+             * @param n_ranks - the number of processes (it must not exceed the number of rows of vertices)
+             */
+  StripPartition(unsigned int nx, unsigned int ny, unsigned int rank, unsigned int n_ranks);
+
+  unsigned int rank() const;
+  unsigned int n_ranks() const;
+
+            /**
+             * The number of vertices in one row of the grid
+             */
+  unsigned int row_length() const;
+
+            /**
+             * The rows of vertices owned by this process [row_beg, row_end)
+             */
+  unsigned int row_beg() const;
+  unsigned int row_end() const;
+
+            /**
+             * The rows of cells of the local strip [cell_row_beg, cell_row_end)
+             */
+  unsigned int cell_row_beg() const;
+  unsigned int cell_row_end() const;
+  unsigned int n_cell_rows() const;
+
+            /**
+             * The total number of dofs (vertices) of the grid
+             */
+  unsigned int n_dofs() const;
+
+            /**
+             * The first global dof owned by this process, and the number of owned dofs
+             */
+  unsigned int first_dof() const;
+  unsigned int n_owned_dofs() const;
+
+            /**
+             * The number of the vertices of the local strip
+             */
+  unsigned int n_local_vertices() const;
+
+            /**
+             * The difference between the global dof of the vertex of the strip and its local number
+             */
+  unsigned int dof_shift() const;
+
+            /**
+             * The global dof of the local vertex (it's shifted by dof_shift)
+             */
+  unsigned int global_dof(unsigned int local_vertex) const;
+
+            /**
+             * Whether the local vertex is one of the owned rows
+             */
+  bool owns_dof(unsigned int local_vertex) const;
+
+            /**
+             * The local numbers of the owned vertices of the strip [owned_beg, owned_end)
+             */
+  unsigned int owned_beg() const;
+  unsigned int owned_end() const;
+
+            /**
+             * The global dofs of the vertices of the strip owned by other processes (in ascending order).
+             * They are the ghost values of the distributed vectors
+             */
+  std::vector<int> ghost_dofs() const;
+
+            /**
+             * The index of the value of the local vertex in the local form of the ghosted vector
+             * (the owned values go first, then the ghost values in the order of ghost_dofs)
+             */
+  unsigned int local_form_index(unsigned int local_vertex) const;
+
+            /**
+             * The local numbers of the owned vertices lying on the boundary of the whole grid
+             */
+  std::vector<int> boundary_dofs() const;
+
+            /**
+             * Whether the cell of the strip is owned by this process
+             * @param local_cell - the number of the cell in the strip (the cells are numbered row by row)
+             */
+  bool owns_cell(unsigned int local_cell) const;
+
+private:
+            /**
+             * The number of cells of the whole grid
+             */
+  unsigned int _nx, _ny;
+
+  unsigned int _rank, _n_ranks;
+
+            /**
+             * The owned rows of vertices
+             */
+  unsigned int _row_beg, _row_end;
+
+            /**
+             * The rows of cells of the strip
+             */
+  unsigned int _cell_row_beg, _cell_row_end;
+};
+
+
+#endif // STRIP_PARTITION_H
@@ -16,8 +16,26 @@
 #include "acoustic2d.h"
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <iterator>
+#include <cstring>
 #include "analytic_functions.h"
 #include "fem/function.h"
+#include "leapfrog_operator.h"
+#include "q1_stencil.h"
+#include "block_of_layers.h"
+#include "coefficients_file.h"
+#include "csr_assembler.h"
+#include "dof_renumbering.h"
+#include "numa_memory.h"
+#include "strip_partition.h"
+#include "mesh_partition.h"
+#include "async_writer.h"
+#include "solution_file.h"
+#include "vtk_series.h"
+#include "output_window.h"
+#include "receivers.h"
+#include <boost/filesystem.hpp>
+#include <sched.h>
 
 
 // =================================
@@ -638,3 +656,1099 @@ TEST(EllipticAnalyticSolutionRectanglesConstants, AnalyticFunction_constant_1)
                                      cur_error, cur_n_cells, prev_error, prev_n_cells,
                                      0, 10, 0, 10);
 }
+
+
+
+// =================================
+//
+// =================================
+TEST(Q1Stencil, compare_with_assembled_matrices)
+{
+  const unsigned int nx = 7, ny = 5;
+  fem::FineMesh fmesh;
+  fmesh.create_rectangular_grid(0, 2, 0, 1, nx, ny);
+
+  fem::FiniteElement fe(1);
+  fem::DoFHandler dof_handler(&fmesh);
+  dof_handler.distribute_dofs(fe, fem::CG);
+  fem::CSRPattern csr_pattern;
+  csr_pattern.make_sparse_format(dof_handler, fem::CG);
+
+  // different coefficients in different cells
+  std::vector<double> coef_alpha(fmesh.n_rectangles()), coef_beta(fmesh.n_rectangles());
+  for (unsigned int cell = 0; cell < fmesh.n_rectangles(); ++cell)
+  {
+    coef_alpha[cell] = 1. + 0.1 * (cell % 7);
+    coef_beta[cell]  = 2. + 0.3 * (cell % 5);
+  }
+
+  // assemble the matrices
+  Mat mass_mat, stiff_mat;
+  MatCreateSeqAIJ(PETSC_COMM_WORLD, csr_pattern.order(), csr_pattern.order(), 0, csr_pattern.nnz(), &mass_mat);
+  MatCreateSeqAIJ(PETSC_COMM_WORLD, csr_pattern.order(), csr_pattern.order(), 0, csr_pattern.nnz(), &stiff_mat);
+  double **local_mass_mat = new double*[fem::Rectangle::n_dofs_first];
+  double **local_stiff_mat = new double*[fem::Rectangle::n_dofs_first];
+  for (unsigned int i = 0; i < fem::Rectangle::n_dofs_first; ++i)
+  {
+    local_mass_mat[i] = new double[fem::Rectangle::n_dofs_first];
+    local_stiff_mat[i] = new double[fem::Rectangle::n_dofs_first];
+  }
+  for (unsigned int cell = 0; cell < fmesh.n_rectangles(); ++cell)
+  {
+    const fem::Rectangle &rectangle = fmesh.rectangle(cell);
+    rectangle.local_mass_matrix(coef_alpha[cell], local_mass_mat);
+    rectangle.local_stiffness_matrix(coef_beta[cell], local_stiff_mat);
+    for (unsigned int i = 0; i < rectangle.n_dofs(); ++i)
+      for (unsigned int j = 0; j < rectangle.n_dofs(); ++j)
+      {
+        MatSetValue(mass_mat, rectangle.dof(i), rectangle.dof(j), local_mass_mat[i][j], ADD_VALUES);
+        MatSetValue(stiff_mat, rectangle.dof(i), rectangle.dof(j), local_stiff_mat[i][j], ADD_VALUES);
+      }
+  }
+  for (unsigned int i = 0; i < fem::Rectangle::n_dofs_first; ++i)
+  {
+    delete[] local_mass_mat[i];
+    delete[] local_stiff_mat[i];
+  }
+  delete[] local_mass_mat;
+  delete[] local_stiff_mat;
+  MatAssemblyBegin(mass_mat, MAT_FINAL_ASSEMBLY);
+  MatAssemblyEnd(mass_mat, MAT_FINAL_ASSEMBLY);
+  MatAssemblyBegin(stiff_mat, MAT_FINAL_ASSEMBLY);
+  MatAssemblyEnd(stiff_mat, MAT_FINAL_ASSEMBLY);
+
+  const Q1Stencil stencil(fmesh, nx, ny, coef_alpha, coef_beta);
+  EXPECT_EQ(stencil.order(), dof_handler.n_dofs());
+
+  // some vectors
+  Vec u1, u2, f, y, y_mfree;
+  VecCreateSeq(PETSC_COMM_SELF, dof_handler.n_dofs(), &u1);
+  VecDuplicate(u1, &u2);
+  VecDuplicate(u1, &f);
+  VecDuplicate(u1, &y);
+  VecDuplicate(u1, &y_mfree);
+  for (unsigned int i = 0; i < dof_handler.n_dofs(); ++i)
+  {
+    VecSetValue(u1, i, sin(1. + i), INSERT_VALUES);
+    VecSetValue(u2, i, cos(2. * i), INSERT_VALUES);
+    VecSetValue(f, i, 1. / (1. + i), INSERT_VALUES);
+  }
+
+  // mass and stiffness matrices
+  const double *x;
+  double *y_val;
+  VecGetArrayRead(u1, &x);
+  VecGetArray(y_mfree, &y_val);
+  stencil.mult(1., 0., x, y_val);
+  VecRestoreArray(y_mfree, &y_val);
+  MatMult(mass_mat, u1, y);
+  compare_vectors(y, y_mfree);
+
+  VecGetArray(y_mfree, &y_val);
+  stencil.mult(0., 1., x, y_val);
+  VecRestoreArray(y_mfree, &y_val);
+  VecRestoreArrayRead(u1, &x);
+  MatMult(stiff_mat, u1, y);
+  compare_vectors(y, y_mfree);
+
+  // fused operator of the explicit scheme
+  const double dt = 0.01;
+  const CSRLeapfrogOperator csr_leapfrog(mass_mat, stiff_mat, 2., -dt*dt, -1., -0.25*dt*dt);
+  const Q1LeapfrogOperator q1_leapfrog(stencil, 2., -dt*dt, -1., -0.25*dt*dt);
+  csr_leapfrog.apply(u1, u2, dt*dt, f, y);
+  q1_leapfrog.apply(u1, u2, dt*dt, f, y_mfree);
+  compare_vectors(y, y_mfree);
+
+  // the same with lumped mass matrix
+  Vec mass_diag;
+  VecDuplicate(u1, &mass_diag);
+  MatGetRowSum(mass_mat, mass_diag);
+  const CSRLeapfrogOperator csr_lumped(mass_mat, stiff_mat, 2., -dt*dt, -1., 0., mass_diag);
+  const Q1LeapfrogOperator q1_lumped(stencil, 2., -dt*dt, -1., 0., mass_diag);
+  csr_lumped.apply(u1, u2, dt*dt, f, y);
+  q1_lumped.apply(u1, u2, dt*dt, f, y_mfree);
+  compare_vectors(y, y_mfree);
+
+  MatDestroy(&mass_mat);
+  MatDestroy(&stiff_mat);
+  VecDestroy(&u1);
+  VecDestroy(&u2);
+  VecDestroy(&f);
+  VecDestroy(&y);
+  VecDestroy(&y_mfree);
+  VecDestroy(&mass_diag);
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(BlockOfLayers, layer_number_is_the_same_as_linear_search)
+{
+  const unsigned int n_layers = 37;
+  std::vector<double> thickness(n_layers), coef_alpha(n_layers), coef_beta(n_layers);
+  double total = 0.;
+  for (unsigned int i = 0; i < n_layers; ++i)
+  {
+    thickness[i] = 1. + (i * 7) % 5; // different thicknesses
+    coef_alpha[i] = i;
+    coef_beta[i] = 2. * i;
+    total += thickness[i];
+  }
+  for (unsigned int i = 0; i < n_layers; ++i)
+    thickness[i] *= 100. / total; // in percent
+
+  const double angles[] = { 0., 15., -30. };
+  for (unsigned int a = 0; a < sizeof(angles) / sizeof(double); ++a)
+  {
+    BlockOfLayers block;
+    block.init(fem::Point(0, 1), fem::Point(3, 2), n_layers, angles[a], thickness, coef_alpha, coef_beta);
+
+    const unsigned int nx = 60, ny = 80;
+    for (unsigned int iy = 0; iy < ny; ++iy)
+    {
+      for (unsigned int ix = 0; ix < nx; ++ix)
+      {
+        const fem::Point point(3. * (ix + 0.5) / nx, 1. + (iy + 0.5) / ny);
+        ASSERT_TRUE(block.contains_point(point));
+
+        unsigned int linear = n_layers;
+        for (unsigned int i = 0; i < n_layers && linear == n_layers; ++i)
+          if (block.layer(i).contains_point(point))
+            linear = i;
+        if (linear == n_layers) // the point is outside of the sloped layers
+        {
+          EXPECT_EQ(block.find_layer(point), -1);
+          EXPECT_ANY_THROW(block.layer_number(point));
+          continue;
+        }
+
+        const unsigned int number = block.layer_number(point);
+        EXPECT_EQ(number, linear);
+        EXPECT_EQ(block.find_layer(point), (int)linear);
+        EXPECT_DOUBLE_EQ(block.coef_alpha(number), coef_alpha[linear]);
+      }
+    }
+    EXPECT_EQ(block.find_layer(fem::Point(1.5, 0.5)), -1); // out of the block
+  }
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(CoefficientsFile, write_read_and_convert)
+{
+  using namespace boost::filesystem;
+
+  const unsigned int nx = 4, ny = 3;
+  std::vector<double> alpha((nx + 1) * (ny + 1)), beta((nx + 1) * (ny + 1));
+  for (unsigned int i = 0; i < alpha.size(); ++i)
+  {
+    alpha[i] = 1. + 0.125 * i;
+    beta[i] = 4e+6 / (1. + i);
+  }
+
+  const std::string bin_file = (temp_directory_path() / unique_path("coef-%%%%%%.bin")).string();
+  const std::string txt_file = (temp_directory_path() / unique_path("coef-%%%%%%.dat")).string();
+  const std::string bin_file_2 = (temp_directory_path() / unique_path("coef-%%%%%%.bin")).string();
+
+  CoefficientsFile::write(bin_file, CoefficientsFile::PER_VERTEX, nx, ny, alpha, beta);
+  EXPECT_TRUE(CoefficientsFile::is_binary(bin_file));
+  {
+    const CoefficientsFile coef_file(bin_file);
+    EXPECT_EQ(coef_file.layout(), CoefficientsFile::PER_VERTEX);
+    EXPECT_EQ(coef_file.nx(), nx);
+    EXPECT_EQ(coef_file.ny(), ny);
+    EXPECT_EQ(coef_file.n_values(), alpha.size());
+    for (unsigned int i = 0; i < alpha.size(); ++i)
+    {
+      EXPECT_DOUBLE_EQ(coef_file.alpha()[i], alpha[i]);
+      EXPECT_DOUBLE_EQ(coef_file.beta()[i], beta[i]);
+    }
+  }
+
+  // binary -> text -> binary
+  CoefficientsFile::convert(bin_file, txt_file, nx, ny);
+  EXPECT_FALSE(CoefficientsFile::is_binary(txt_file));
+  CoefficientsFile::convert(txt_file, bin_file_2, nx, ny);
+  {
+    const CoefficientsFile coef_file(bin_file_2);
+    EXPECT_EQ(coef_file.layout(), CoefficientsFile::PER_VERTEX);
+    for (unsigned int i = 0; i < alpha.size(); ++i)
+    {
+      EXPECT_NEAR(coef_file.alpha()[i], alpha[i], 1e-13 * alpha[i]);
+      EXPECT_NEAR(coef_file.beta()[i], beta[i], 1e-13 * beta[i]);
+    }
+  }
+
+  remove(bin_file);
+  remove(txt_file);
+  remove(bin_file_2);
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(CSRAssembler, compare_with_serial_assembly)
+{
+  const unsigned int nx = 9, ny = 6;
+  fem::FineMesh fmesh;
+  fmesh.create_rectangular_grid(0, 1, 0, 1, nx, ny);
+
+  fem::FiniteElement fe(1);
+  fem::DoFHandler dof_handler(&fmesh);
+  dof_handler.distribute_dofs(fe, fem::CG);
+  fem::CSRPattern csr_pattern;
+  csr_pattern.make_sparse_format(dof_handler, fem::CG);
+
+  // the cells of the same color don't share dofs
+  const std::vector<std::vector<unsigned int> > colors = CSRAssembler::color_cells(fmesh.rectangles(), dof_handler.n_dofs());
+  EXPECT_EQ(colors.size(), 4u); // the rectangular grid requires 4 colors
+  unsigned int n_colored_cells = 0;
+  for (unsigned int c = 0; c < colors.size(); ++c)
+  {
+    std::vector<unsigned int> dof_used(dof_handler.n_dofs(), 0);
+    for (unsigned int k = 0; k < colors[c].size(); ++k)
+    {
+      const fem::Rectangle &rectangle = fmesh.rectangle(colors[c][k]);
+      for (unsigned int i = 0; i < rectangle.n_dofs(); ++i)
+        EXPECT_EQ(dof_used[rectangle.dof(i)]++, 0u);
+    }
+    n_colored_cells += colors[c].size();
+  }
+  EXPECT_EQ(n_colored_cells, fmesh.n_rectangles());
+
+  // the cells of the uniform grid are assembled using the reference matrices
+  EXPECT_TRUE(CSRAssembler::congruent_cells(fmesh.rectangles(), fmesh.vertices()));
+
+  std::vector<double> coef_alpha(fmesh.n_rectangles()), coef_beta(fmesh.n_rectangles());
+  for (unsigned int cell = 0; cell < fmesh.n_rectangles(); ++cell)
+  {
+    coef_alpha[cell] = 1. + 0.1 * (cell % 7);
+    coef_beta[cell]  = 2. + 0.3 * (cell % 5);
+  }
+
+  Mat mass_mat, stiff_mat, mass_threaded, stiff_threaded;
+  MatCreateSeqAIJ(PETSC_COMM_WORLD, csr_pattern.order(), csr_pattern.order(), 0, csr_pattern.nnz(), &mass_mat);
+  MatCreateSeqAIJ(PETSC_COMM_WORLD, csr_pattern.order(), csr_pattern.order(), 0, csr_pattern.nnz(), &stiff_mat);
+
+  assemble_serially(fmesh.rectangles(), &coef_alpha[0], &coef_beta[0], mass_mat, stiff_mat);
+
+  CSRAssembler assembler(csr_pattern);
+  assembler.assemble(fmesh.rectangles(), fmesh.vertices(), &coef_alpha[0], &coef_beta[0], 3);
+  assembler.create_matrices(&mass_threaded, &stiff_threaded);
+
+  Vec x, y, y_threaded;
+  VecCreateSeq(PETSC_COMM_SELF, dof_handler.n_dofs(), &x);
+  VecDuplicate(x, &y);
+  VecDuplicate(x, &y_threaded);
+  for (unsigned int i = 0; i < dof_handler.n_dofs(); ++i)
+    VecSetValue(x, i, sin(1. + i), INSERT_VALUES);
+
+  MatMult(mass_mat, x, y);
+  MatMult(mass_threaded, x, y_threaded);
+  compare_vectors(y, y_threaded);
+
+  MatMult(stiff_mat, x, y);
+  MatMult(stiff_threaded, x, y_threaded);
+  compare_vectors(y, y_threaded);
+
+  MatDestroy(&mass_mat);
+  MatDestroy(&stiff_mat);
+  MatDestroy(&mass_threaded);
+  MatDestroy(&stiff_threaded);
+  VecDestroy(&x);
+  VecDestroy(&y);
+  VecDestroy(&y_threaded);
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(SymmetricLeapfrogOperator, compare_with_full_storage)
+{
+  GridMatrices grid(1, 2, 6, 8);
+  Mat mass_mat = grid.mass_mat, stiff_mat = grid.stiff_mat;
+  Vec u1 = grid.u1, u2 = grid.u2, f = grid.f, mass_diag = grid.mass_diag;
+
+  Vec y, y_sym;
+  VecDuplicate(u1, &y);
+  VecDuplicate(u1, &y_sym);
+
+  const double dt = 0.01;
+
+  // consistent mass matrix (Crank-Nicolson like coefficients)
+  const CSRLeapfrogOperator full(mass_mat, stiff_mat, 2., -0.5*dt*dt, -1., -0.25*dt*dt);
+  const SymmetricLeapfrogOperator sym(mass_mat, stiff_mat, 2., -0.5*dt*dt, -1., -0.25*dt*dt);
+  full.apply(u1, u2, dt*dt, f, y);
+  sym.apply(u1, u2, dt*dt, f, y_sym);
+  compare_vectors(y, y_sym);
+
+  // lumped mass matrix, and the rhs vector is the output vector at the same time
+  const CSRLeapfrogOperator full_lumped(mass_mat, stiff_mat, 2., -dt*dt, -1., 0., mass_diag);
+  const SymmetricLeapfrogOperator sym_lumped(mass_mat, stiff_mat, 2., -dt*dt, -1., 0., mass_diag);
+  VecCopy(f, y);
+  VecCopy(f, y_sym);
+  full_lumped.apply(u1, u2, dt*dt, y, y);
+  sym_lumped.apply(u1, u2, dt*dt, y_sym, y_sym);
+  compare_vectors(y, y_sym);
+
+  VecDestroy(&y);
+  VecDestroy(&y_sym);
+}
+
+
+
+TEST(SellLeapfrogOperator, compare_with_csr)
+{
+  GridMatrices grid(1, 2, 6, 4); // the number of rows (35) is not a multiple of the chunk size
+  Mat mass_mat = grid.mass_mat, stiff_mat = grid.stiff_mat;
+  Vec u1 = grid.u1, u2 = grid.u2, f = grid.f, mass_diag = grid.mass_diag;
+
+  Vec y, y_sell;
+  VecDuplicate(u1, &y);
+  VecDuplicate(u1, &y_sell);
+
+  const double dt = 0.01;
+
+  // consistent mass matrix (Crank-Nicolson like coefficients)
+  const CSRLeapfrogOperator full(mass_mat, stiff_mat, 2., -0.5*dt*dt, -1., -0.25*dt*dt);
+  const SellLeapfrogOperator sell(mass_mat, stiff_mat, 2., -0.5*dt*dt, -1., -0.25*dt*dt);
+  full.apply(u1, u2, dt*dt, f, y);
+  sell.apply(u1, u2, dt*dt, f, y_sell);
+  compare_vectors(y, y_sell);
+
+  // lumped mass matrix, and the rhs vector is the output vector at the same time
+  const CSRLeapfrogOperator full_lumped(mass_mat, stiff_mat, 2., -dt*dt, -1., 0., mass_diag);
+  const SellLeapfrogOperator sell_lumped(mass_mat, stiff_mat, 2., -dt*dt, -1., 0., mass_diag);
+  VecCopy(f, y);
+  VecCopy(f, y_sell);
+  full_lumped.apply(u1, u2, dt*dt, y, y);
+  sell_lumped.apply(u1, u2, dt*dt, y_sell, y_sell);
+  compare_vectors(y, y_sell);
+
+  VecDestroy(&y);
+  VecDestroy(&y_sell);
+}
+
+
+
+TEST(DoFRenumbering, assemble_renumbered_matrices)
+{
+  const unsigned int nx = 11, ny = 7;
+  GridMatrices grid(2, 1, nx, ny);
+
+  Vec x, y, x_renum, y_renum, y_natural;
+  VecCreateSeq(PETSC_COMM_SELF, grid.n_dofs, &x);
+  VecDuplicate(x, &y);
+  VecDuplicate(x, &x_renum);
+  VecDuplicate(x, &y_renum);
+  VecDuplicate(x, &y_natural);
+
+  const DoFRenumbering orderings[] = { DoFRenumbering::cuthill_mckee(grid.csr_pattern),
+                                       DoFRenumbering::morton(grid.dof_handler.dofs(), nx, ny),
+                                       DoFRenumbering::tiled(grid.dof_handler.dofs(), nx, ny) };
+
+  for (unsigned int o = 0; o < sizeof(orderings) / sizeof(orderings[0]); ++o)
+  {
+    const DoFRenumbering &renumbering = orderings[o];
+    EXPECT_FALSE(renumbering.natural());
+
+    // the matrices assembled in the new numbering are the permuted original ones
+    CSRAssembler assembler(grid.csr_pattern, renumbering);
+    assembler.assemble(grid.fmesh.rectangles(), grid.fmesh.vertices(), &grid.coef_alpha[0], &grid.coef_beta[0], 2);
+    Mat mass_renum, stiff_renum;
+    assembler.create_matrices(&mass_renum, &stiff_renum);
+
+    for (unsigned int i = 0; i < grid.n_dofs; ++i)
+    {
+      VecSetValue(x, i, sin(1. + i), INSERT_VALUES);
+      VecSetValue(x_renum, renumbering.new_dof(i), sin(1. + i), INSERT_VALUES);
+    }
+
+    MatMult(grid.mass_mat, x, y);
+    MatMult(mass_renum, x_renum, y_renum);
+    renumbering.to_natural(y_renum, y_natural);
+    compare_vectors(y, y_natural);
+
+    MatMult(grid.stiff_mat, x, y);
+    MatMult(stiff_renum, x_renum, y_renum);
+    renumbering.to_natural(y_renum, y_natural);
+    compare_vectors(y, y_natural);
+
+    MatDestroy(&mass_renum);
+    MatDestroy(&stiff_renum);
+  }
+
+  VecDestroy(&x);
+  VecDestroy(&y);
+  VecDestroy(&x_renum);
+  VecDestroy(&y_renum);
+  VecDestroy(&y_natural);
+}
+
+
+
+TEST(LeapfrogOperator, apply_in_parts)
+{
+  GridMatrices grid(1, 1, 13, 9);
+  const unsigned int n_dofs = grid.n_dofs;
+  Mat mass_mat = grid.mass_mat, stiff_mat = grid.stiff_mat;
+  Vec u1 = grid.u1, u2 = grid.u2, f = grid.f, mass_diag = grid.mass_diag;
+
+  Vec y;
+  VecDuplicate(u1, &y);
+
+  const double dt = 0.01;
+  const CSRLeapfrogOperator csr(mass_mat, stiff_mat, 2., -dt*dt, -1., 0., mass_diag);
+  const SellLeapfrogOperator sell(mass_mat, stiff_mat, 2., -dt*dt, -1., 0., mass_diag);
+  const LeapfrogOperator *operators[] = { &csr, &sell };
+
+  const double *u1_val, *u2_val, *f_val, *y_val;
+  VecGetArrayRead(u1, &u1_val);
+  VecGetArrayRead(u2, &u2_val);
+  VecGetArrayRead(f, &f_val);
+
+  for (unsigned int o = 0; o < 2; ++o)
+  {
+    const LeapfrogOperator &leapfrog = *operators[o];
+    EXPECT_TRUE(leapfrog.partitioned());
+    leapfrog.apply(u1, u2, dt*dt, f, y);
+    VecGetArrayRead(y, &y_val);
+
+    // each part computes exactly the rows it owns, and all parts together give the whole result
+    for (unsigned int n_parts = 1; n_parts <= 5; ++n_parts)
+    {
+      for (unsigned int part = 0; part < n_parts; ++part)
+      {
+        std::vector<double> y_part(n_dofs, -1e+100);
+        leapfrog.apply_part(u1_val, u2_val, dt*dt, f_val, &y_part[0], part, n_parts);
+        for (unsigned int i = 0; i < n_dofs; ++i)
+        {
+          if (leapfrog.row_part(i, n_parts) == part)
+            EXPECT_NEAR(y_part[i], y_val[i], 1e-14 * std::max(1., fabs(y_val[i])));
+          else
+            EXPECT_EQ(y_part[i], -1e+100);
+        }
+      }
+    }
+    VecRestoreArrayRead(y, &y_val);
+  }
+
+  VecRestoreArrayRead(f, &f_val);
+  VecRestoreArrayRead(u2, &u2_val);
+  VecRestoreArrayRead(u1, &u1_val);
+
+  VecDestroy(&y);
+}
+
+
+
+TEST(NumaPlacement, parse_cores)
+{
+  EXPECT_TRUE(NumaPlacement::parse_cores("").empty());
+
+  const int expected[] = { 0, 1, 2, 3, 8, 10, 11 };
+  const std::vector<int> cores = NumaPlacement::parse_cores("0-3,8,10-11");
+  ASSERT_EQ(cores.size(), sizeof(expected) / sizeof(expected[0]));
+  for (unsigned int i = 0; i < cores.size(); ++i)
+    EXPECT_EQ(cores[i], expected[i]);
+}
+
+
+
+TEST(NumaPlacement, check_cores_of_map)
+{
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+  int available = -1, unavailable = -1;
+  for (int core = 0; core < CPU_SETSIZE; ++core)
+  {
+    if (CPU_ISSET(core, &allowed) && available < 0)
+      available = core;
+    if (!CPU_ISSET(core, &allowed))
+      unavailable = core;
+  }
+  ASSERT_GE(available, 0);
+
+  // the map is checked when the placement is created, not when the threads are pinned
+  if (unavailable >= 0)
+  {
+    EXPECT_ANY_THROW(NumaPlacement(d2s(available) + "," + d2s(unavailable), false));
+  }
+
+  const NumaPlacement placement(d2s(available), false);
+  EXPECT_TRUE(placement.pin_thread(0));
+  EXPECT_TRUE(NumaPlacement().pin_thread(0)); // nothing to pin
+
+  // the other tests run on all the cores
+  sched_setaffinity(0, sizeof(allowed), &allowed);
+}
+
+
+
+TEST(NumaPlacement, distribute_operators)
+{
+  GridMatrices grid(1, 1, 11, 7);
+  const unsigned int n_dofs = grid.n_dofs;
+  Mat mass_mat = grid.mass_mat, stiff_mat = grid.stiff_mat;
+  Vec u1 = grid.u1, u2 = grid.u2, f = grid.f, mass_diag = grid.mass_diag;
+
+  Vec y, y_distributed;
+  VecDuplicate(u1, &y);
+  VecDuplicate(u1, &y_distributed);
+
+  const double dt = 0.01;
+  CSRLeapfrogOperator csr(mass_mat, stiff_mat, 2., -dt*dt, -1., 0., mass_diag);
+  SellLeapfrogOperator sell(mass_mat, stiff_mat, 2., -dt*dt, -1., 0., mass_diag);
+  LeapfrogOperator *operators[] = { &csr, &sell };
+
+  // the arrays are moved to other memory, but the results must be the same
+  const NumaPlacement placement;
+  for (unsigned int o = 0; o < 2; ++o)
+  {
+    operators[o]->apply(u1, u2, dt*dt, f, y);
+    operators[o]->distribute(placement, 3);
+    operators[o]->apply(u1, u2, dt*dt, f, y_distributed);
+
+    const double *y_val, *y_distributed_val;
+    VecGetArrayRead(y, &y_val);
+    VecGetArrayRead(y_distributed, &y_distributed_val);
+    for (unsigned int i = 0; i < n_dofs; ++i)
+      EXPECT_EQ(y_distributed_val[i], y_val[i]);
+    VecRestoreArrayRead(y_distributed, &y_distributed_val);
+    VecRestoreArrayRead(y, &y_val);
+  }
+
+  VecDestroy(&y);
+  VecDestroy(&y_distributed);
+}
+
+
+
+TEST(StripPartition, cover_grid)
+{
+  const unsigned int nx = 5, ny = 6;
+  const unsigned int n_vertices = (nx + 1) * (ny + 1);
+
+  for (unsigned int n_ranks = 1; n_ranks <= ny + 1; ++n_ranks)
+  {
+    std::vector<int> vertex_owners(n_vertices, 0), cell_owners(nx * ny, 0);
+    unsigned int n_boundary_dofs = 0;
+    for (unsigned int rank = 0; rank < n_ranks; ++rank)
+    {
+      const StripPartition strips(nx, ny, rank, n_ranks);
+      for (unsigned int d = strips.first_dof(); d < strips.first_dof() + strips.n_owned_dofs(); ++d)
+        ++vertex_owners[d];
+      for (unsigned int cell = 0; cell < strips.n_cell_rows() * nx; ++cell)
+        if (strips.owns_cell(cell))
+          ++cell_owners[strips.cell_row_beg() * nx + cell];
+      n_boundary_dofs += strips.boundary_dofs().size();
+
+      // the local form of the ghosted vector has the values of all vertices of the strip
+      const std::vector<int> ghosts = strips.ghost_dofs();
+      EXPECT_EQ(strips.n_owned_dofs() + ghosts.size(), strips.n_local_vertices());
+      for (unsigned int v = 0; v < strips.n_local_vertices(); ++v)
+      {
+        const unsigned int index = strips.local_form_index(v);
+        const unsigned int dof = (index < strips.n_owned_dofs() ? strips.first_dof() + index :
+                                                                   ghosts[index - strips.n_owned_dofs()]);
+        EXPECT_EQ(dof, v + strips.dof_shift());
+      }
+    }
+
+    for (unsigned int d = 0; d < n_vertices; ++d)
+      EXPECT_EQ(vertex_owners[d], 1);
+    for (unsigned int cell = 0; cell < nx * ny; ++cell)
+      EXPECT_EQ(cell_owners[cell], 1);
+    EXPECT_EQ(n_boundary_dofs, 2 * (nx + 1) + 2 * (ny - 1));
+  }
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(MeshPartition, cover_mesh)
+{
+  // the first mesh has no partitions, the second one has 5 partitions
+  const std::string mesh_files[] = { "/test_mesh_0.msh", "/test_mesh_1.msh" };
+
+  for (unsigned int m = 0; m < 2; ++m)
+  {
+    fem::FineMesh fmesh;
+    fmesh.read(TEST_DIR + mesh_files[m],
+               fem::Point(0, 0),
+               fem::Point(1, 1));
+
+    fem::FiniteElement fe(1);
+    fem::DoFHandler dof_handler(&fmesh);
+    dof_handler.distribute_dofs(fe, fem::CG);
+    fem::CSRPattern csr_pattern;
+    csr_pattern.make_sparse_format(dof_handler, fem::CG);
+    const unsigned int n_dofs = csr_pattern.order();
+
+    for (unsigned int n_ranks = 1; n_ranks <= 5; ++n_ranks)
+    {
+      std::vector<int> dof_owners(n_dofs, 0), cell_users(fmesh.n_triangles(), 0);
+      unsigned int next_dof = 0, n_boundary_dofs = 0;
+      for (unsigned int rank = 0; rank < n_ranks; ++rank)
+      {
+        const MeshPartition partition(fmesh, csr_pattern, rank, n_ranks);
+        EXPECT_EQ(partition.from_mesh_file(), m == 1);
+
+        // the owned dofs of the processes follow each other
+        EXPECT_EQ(partition.first_dof(), next_dof);
+        next_dof += partition.n_owned_dofs();
+        n_boundary_dofs += partition.boundary_dofs().size();
+
+        // the columns of the owned rows are either owned or ghosts
+        const std::vector<int> ghosts = partition.ghost_dofs();
+        for (unsigned int d = 0; d < n_dofs; ++d)
+        {
+          if (!partition.owns_dof(d))
+            continue;
+          ++dof_owners[d];
+          EXPECT_GE(partition.global_dof(d), partition.first_dof());
+          EXPECT_LT(partition.global_dof(d), partition.first_dof() + partition.n_owned_dofs());
+          for (unsigned int k = csr_pattern.row(d); k < csr_pattern.row(d + 1); ++k)
+          {
+            const unsigned int col = csr_pattern.col(k);
+            EXPECT_TRUE(partition.owns_dof(col) ||
+                        std::binary_search(ghosts.begin(), ghosts.end(), (int)partition.global_dof(col)));
+          }
+        }
+
+        for (unsigned int cell = 0; cell < fmesh.n_triangles(); ++cell)
+          if (partition.local_cell(fmesh.triangle(cell)))
+            ++cell_users[cell];
+      }
+
+      EXPECT_EQ(next_dof, n_dofs);
+      for (unsigned int d = 0; d < n_dofs; ++d)
+        EXPECT_EQ(dof_owners[d], 1);
+      for (unsigned int cell = 0; cell < fmesh.n_triangles(); ++cell)
+        EXPECT_GE(cell_users[cell], 1);
+      EXPECT_EQ(n_boundary_dofs, fmesh.boundary_vertices().size());
+    }
+  }
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(AsyncWriter, write_all_snapshots)
+{
+  const unsigned int n_values = 1000, n_snapshots = 50;
+
+  for (unsigned int n_threads = 1; n_threads <= 3; ++n_threads)
+  {
+    std::atomic<unsigned int> n_written(0), n_correct(0), step_sum(0);
+    {
+      AsyncWriter writer(n_values, 2, n_threads, [&](unsigned int time_step, const double *values)
+      {
+        bool correct = true;
+        for (unsigned int i = 0; i < n_values; ++i)
+          correct = correct && (values[i] == time_step + 0.001 * i);
+        n_correct += (correct ? 1 : 0);
+        step_sum += time_step;
+        ++n_written;
+      });
+
+      for (unsigned int step = 0; step < n_snapshots; ++step)
+      {
+        double *snapshot = writer.acquire();
+        for (unsigned int i = 0; i < n_values; ++i)
+          snapshot[i] = step + 0.001 * i;
+        writer.submit(step);
+        if (step == n_snapshots / 2) // everything submitted before is written after the flush
+        {
+          writer.flush();
+          EXPECT_EQ(n_written, step + 1);
+        }
+      }
+    } // the rest of the snapshots is written by the destructor
+
+    EXPECT_EQ(n_written, n_snapshots);
+    EXPECT_EQ(n_correct, n_snapshots);
+    EXPECT_EQ(step_sum, n_snapshots * (n_snapshots - 1) / 2);
+  }
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(SolutionFile, write_read_and_extract)
+{
+  using namespace boost::filesystem;
+
+  const unsigned int n_values = 7, n_snapshots = 5;
+  std::vector<double> values(n_values);
+
+  const path dir = temp_directory_path() / unique_path("sol-%%%%%%");
+  create_directory(dir);
+  const std::string bin_file = (dir / "sol-p2.bin").string();
+  const std::string float_file = (dir / "sol32.bin").string();
+  {
+    SolutionWriter writer(bin_file, n_values, SolutionFile::FLOAT64, 4, 3, 2);
+    SolutionWriter float_writer(float_file, n_values, SolutionFile::FLOAT32);
+    for (int s = n_snapshots - 1; s >= 0; --s) // the snapshots may be appended in any order
+    {
+      for (unsigned int i = 0; i < n_values; ++i)
+        values[i] = 1. / (1. + s + i);
+      writer.append(10 * s, 0.5 * s, &values[0]);
+      float_writer.append(10 * s, 0.5 * s, &values[0]);
+    }
+    writer.close();
+  } // the float file is closed by the destructor
+
+  const SolutionFile sol_file(bin_file);
+  const SolutionFile float_sol_file(float_file);
+  EXPECT_EQ(sol_file.nx(), 4u);
+  EXPECT_EQ(sol_file.ny(), 3u);
+  EXPECT_EQ(sol_file.piece(), 2);
+  EXPECT_EQ(float_sol_file.piece(), -1);
+  EXPECT_EQ(sol_file.n_values(), n_values);
+  EXPECT_EQ(sol_file.n_snapshots(), n_snapshots);
+  EXPECT_EQ(float_sol_file.n_snapshots(), n_snapshots);
+  EXPECT_EQ(sol_file.find(25), -1);
+  for (unsigned int s = 0; s < n_snapshots; ++s)
+  {
+    EXPECT_EQ(sol_file.step(s), 10 * s);
+    EXPECT_DOUBLE_EQ(sol_file.time(s), 0.5 * s);
+    EXPECT_EQ(sol_file.find(10 * s), (long long)s);
+    for (unsigned int i = 0; i < n_values; ++i)
+    {
+      EXPECT_DOUBLE_EQ(sol_file.values(s)[i], 1. / (1. + s + i));
+      EXPECT_FLOAT_EQ(float_sol_file.float_values(s)[i], 1. / (1. + s + i));
+    }
+  }
+
+  // the text files have the layout of the files of the strips
+  EXPECT_EQ(SolutionFile::extract(bin_file, dir.string()), n_snapshots);
+  std::ifstream in((dir / "sol-30-p2.dat").string().c_str());
+  for (unsigned int i = 0; i < n_values; ++i)
+  {
+    double value = 0.;
+    in >> value;
+    EXPECT_NEAR(value, 1. / (4. + i), 1e-15);
+  }
+  EXPECT_TRUE(in);
+
+  remove_all(dir);
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(VTKSeries, write_steps_and_index)
+{
+  using namespace boost::filesystem;
+
+  const path dir = temp_directory_path() / unique_path("vtk-%%%%%%");
+  create_directory(dir);
+
+  VTKSeries series(dir.string(), "res", 0., 0., 0.5, 0.25, 4, 1, 3); // the strip of the rows of cells [1, 3)
+  EXPECT_EQ(series.n_points(), 15u);
+  EXPECT_EQ(series.n_cells(), 8u);
+
+  series.write_coefficients(std::vector<double>(series.n_cells(), 1.), std::vector<double>(series.n_cells(), 2.));
+  std::vector<double> values(series.n_points());
+  for (int step = 20; step >= 0; step -= 10) // the time steps may be written in any order
+  {
+    for (unsigned int i = 0; i < values.size(); ++i)
+      values[i] = step + 0.5 * i;
+    series.write_step(step, 0.1 * step, &values[0]);
+  }
+  series.close();
+
+  // the raw values follow the '_' mark of the appended data and their size
+  std::ifstream in((dir / series.step_file(10)).string().c_str(), std::ios::binary);
+  const std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  EXPECT_NE(contents.find("Extent=\"0 4 1 3 0 0\""), std::string::npos);
+  const size_t data_beg = contents.find("<AppendedData encoding=\"raw\">\n_") + 31;
+  uint64_t n_bytes = 0;
+  memcpy(&n_bytes, contents.data() + data_beg, sizeof(n_bytes));
+  EXPECT_EQ(n_bytes, series.n_points() * sizeof(double));
+  for (unsigned int i = 0; i < series.n_points(); ++i)
+  {
+    double value;
+    memcpy(&value, contents.data() + data_beg + sizeof(n_bytes) + i * sizeof(double), sizeof(double));
+    EXPECT_DOUBLE_EQ(value, 10 + 0.5 * i);
+  }
+
+  // the index refers to the time steps in their order and to the coefficients in each of them
+  std::ifstream pvd((dir / series.index_file()).string().c_str());
+  std::vector<std::string> files;
+  std::string line;
+  while (std::getline(pvd, line))
+    if (line.find("file=\"") != std::string::npos)
+      files.push_back(line.substr(line.find("file=\"") + 6, line.rfind('"') - line.find("file=\"") - 6));
+  ASSERT_EQ(files.size(), 6u);
+  EXPECT_EQ(files[0], series.step_file(0));
+  EXPECT_EQ(files[1], series.coefficients_file());
+  EXPECT_EQ(files[4], series.step_file(20));
+  EXPECT_TRUE(exists(dir / series.coefficients_file()));
+
+  remove_all(dir);
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(OutputWindow, select_vertices)
+{
+  const unsigned int nx = 10, ny = 20; // the cells of 0.1 x 0.1
+
+  const OutputWindow whole(0., 1., 0., 2., nx, ny, -1., 2., 0., 2., 1);
+  EXPECT_TRUE(whole.whole_grid());
+  EXPECT_EQ(whole.n_vertices(), (nx + 1) * (ny + 1));
+
+  // the columns 2, 4, 6 and the rows 5, 7, ..., 15
+  const OutputWindow window(0., 1., 0., 2., nx, ny, 0.2, 0.75, 0.5, 1.5, 2);
+  EXPECT_FALSE(window.whole_grid());
+  EXPECT_EQ(window.n_cols(), 3u);
+  EXPECT_EQ(window.n_rows(), 6u);
+  EXPECT_NEAR(window.x_beg(), 0.2, 1e-14);
+  EXPECT_NEAR(window.y_beg(), 0.5, 1e-14);
+  EXPECT_NEAR(window.hx(), 0.2, 1e-14);
+
+  const std::vector<unsigned int> all = window.vertices(0, ny + 1, 0);
+  ASSERT_EQ(all.size(), window.n_vertices());
+  EXPECT_EQ(all.front(), 5 * (nx + 1) + 2);
+  EXPECT_EQ(all.back(), 15 * (nx + 1) + 6);
+  EXPECT_EQ(window.cells(0, ny + 1, 0).size(), 2u * 5u);
+
+  // the strip of the rows [6, 10) whose values begin with the row 4 has the rows 7 and 9 of the window
+  unsigned int first, n;
+  window.select_rows(6, 10, first, n);
+  EXPECT_EQ(first, 1u);
+  EXPECT_EQ(n, 2u);
+  const std::vector<unsigned int> strip = window.vertices(6, 10, 4);
+  ASSERT_EQ(strip.size(), 6u);
+  EXPECT_EQ(strip[0], 3 * (nx + 1) + 2);
+  EXPECT_EQ(strip[5], 5 * (nx + 1) + 6);
+
+  std::vector<double> values((nx + 1) * (ny + 1)), selected;
+  for (unsigned int i = 0; i < values.size(); ++i)
+    values[i] = i;
+  OutputWindow::gather(&values[0], all, selected);
+  for (unsigned int i = 0; i < all.size(); ++i)
+    EXPECT_EQ(selected[i], all[i]);
+}
+
+
+
+TEST(OutputWindow, join_pieces_of_strips)
+{
+  const unsigned int nx = 10, ny = 20;
+  const double windows[][4] = { { 0., 1., 0., 2. },     // the whole grid
+                                { 0.2, 0.75, 0.5, 1.5 },
+                                { 0., 1., 0.9, 1.1 } }; // a couple of rows in the middle
+
+  // the pieces written by the strips (see Acoustic2D::open_vtk_series) are the own cells of the strips,
+  // so they share their border rows only, and there are no gaps between them for any number of processes
+  for (unsigned int w = 0; w < sizeof(windows) / sizeof(windows[0]); ++w)
+  {
+    const OutputWindow window(0., 1., 0., 2., nx, ny, windows[w][0], windows[w][1], windows[w][2], windows[w][3], 1);
+    for (unsigned int n_ranks = 1; n_ranks <= 7; ++n_ranks)
+    {
+      int last = -1; // the last row of the previous piece
+      for (unsigned int rank = 0; rank < n_ranks; ++rank)
+      {
+        const StripPartition strip(nx, ny, rank, n_ranks);
+        unsigned int first, n;
+        window.select_rows(strip.row_beg(), strip.cell_row_end() + 1, first, n);
+        if (n < 2)
+          continue;
+        EXPECT_EQ((int)first, std::max(last, 0));
+        last = first + n - 1;
+      }
+      EXPECT_EQ(last, (int)window.n_rows() - 1);
+    }
+  }
+
+  // the same without the window: the own cells of the strips cover the grid once
+  for (unsigned int n_ranks = 1; n_ranks <= 7; ++n_ranks)
+  {
+    unsigned int cell_row = 0;
+    for (unsigned int rank = 0; rank < n_ranks; ++rank)
+    {
+      const StripPartition strip(nx, ny, rank, n_ranks);
+      if (strip.cell_row_end() <= strip.row_beg())
+        continue;
+      EXPECT_EQ(strip.row_beg(), cell_row);
+      cell_row = strip.cell_row_end();
+    }
+    EXPECT_EQ(cell_row, ny);
+  }
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(Receivers, interpolate_and_write_segy)
+{
+  using namespace boost::filesystem;
+
+  // a bilinear function is reproduced exactly on the rectangular grid
+  const unsigned int nx = 10, ny = 5;
+  std::vector<double> values((nx + 1) * (ny + 1));
+  for (unsigned int j = 0; j <= ny; ++j)
+    for (unsigned int i = 0; i <= nx; ++i)
+    {
+      const double x = 0.1 * i, y = 0.2 * j;
+      values[j * (nx + 1) + i] = 1. + 2. * x - 3. * y + 4. * x * y;
+    }
+
+  // the line from the corner to the corner and one receiver on the right side
+  std::vector<fem::Point> points = Receivers::lines("0,0,1,1,5; 1,0.33,1,0.33,1");
+  ASSERT_EQ(points.size(), 6u);
+  EXPECT_NEAR(points[2].coord(0), 0.5, 1e-14);
+  Receivers receivers(points);
+  receivers.locate_in_grid(0., 1., 0., 1., nx, ny);
+  for (unsigned int r = 0; r < receivers.n_receivers(); ++r)
+  {
+    double sum = 0.;
+    for (unsigned int k = 0; k < Receivers::MAX_VERTICES; ++k)
+      sum += receivers.weights(r)[k];
+    EXPECT_NEAR(sum, 1., 1e-14);
+  }
+  EXPECT_EQ(receivers.vertices(5)[0], 1 * (nx + 1) + nx - 1);
+
+  // the values of the second process (the dofs from the row 3) are not recorded by the first one
+  Receivers part(points);
+  part.locate_in_grid(0., 1., 0., 1., nx, ny);
+  part.distribute(DoFRenumbering(), 0, 3 * (nx + 1));
+  part.record(&values[0]);
+
+  receivers.distribute(DoFRenumbering(), 0, values.size());
+  for (unsigned int step = 0; step < 3; ++step)
+  {
+    receivers.record(&values[0]);
+    for (unsigned int i = 0; i < values.size(); ++i)
+      values[i] *= 2.;
+  }
+  ASSERT_EQ(receivers.n_samples(), 3u);
+  for (unsigned int r = 0; r < receivers.n_receivers(); ++r)
+  {
+    const double x = points[r].coord(0), y = points[r].coord(1);
+    const double exact = 1. + 2. * x - 3. * y + 4. * x * y;
+    EXPECT_NEAR(receivers.sample(r, 0), exact, 1e-12);
+    EXPECT_NEAR(receivers.sample(r, 2), 4. * exact, 1e-12);
+  }
+  EXPECT_NEAR(part.sample(0, 0), 1., 1e-12);
+  EXPECT_EQ(part.sample(4, 0), 0.);
+
+  // the linear function is reproduced exactly on the triangular mesh
+  fem::FineMesh fmesh;
+  fmesh.read(TEST_DIR + "/test_mesh_0.msh", fem::Point(0, 0), fem::Point(1, 1));
+  Receivers mesh_receivers(Receivers::lines("0.05,0.1,0.95,0.8,17"));
+  mesh_receivers.locate_in_mesh(fmesh.vertices(), fmesh.triangles());
+  std::vector<double> mesh_values(fmesh.n_vertices());
+  for (unsigned int i = 0; i < mesh_values.size(); ++i)
+    mesh_values[i] = 2. * fmesh.vertex(i).coord(0) - fmesh.vertex(i).coord(1);
+  mesh_receivers.distribute(DoFRenumbering(), 0, mesh_values.size());
+  mesh_receivers.record(&mesh_values[0]);
+  for (unsigned int r = 0; r < mesh_receivers.n_receivers(); ++r)
+    EXPECT_NEAR(mesh_receivers.sample(r, 0),
+                2. * mesh_receivers.point(r).coord(0) - mesh_receivers.point(r).coord(1), 1e-12);
+
+  // the headers and the samples of the SEG-Y file (big-endian)
+  const std::string fname = (temp_directory_path() / unique_path("rec-%%%%%%.sgy")).string();
+  receivers.write_segy(fname, 1e-3, 0.);
+  std::ifstream in(fname.c_str(), std::ios::binary);
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+  remove(fname);
+  ASSERT_EQ(data.size(), 3600u + 6u * (240u + 3u * 4u));
+  EXPECT_EQ(memcmp(&data[0], "C 1 ", 4), 0);
+  EXPECT_EQ(data[3216] * 256 + data[3217], 1000); // the sample interval in microseconds
+  EXPECT_EQ(data[3220] * 256 + data[3221], 3); // the number of samples
+  EXPECT_EQ(data[3224] * 256 + data[3225], 5); // IEEE floats
+
+  const unsigned char *trace = &data[3600 + 2 * (240 + 3 * 4)];
+  EXPECT_EQ(trace[3], 3); // the sequence number
+  EXPECT_EQ((trace[70] << 8 | trace[71]), 65536 - Receivers::COORD_SCALE); // the negative scalar divides the coordinates
+  EXPECT_EQ((trace[80] << 24 | trace[81] << 16 | trace[82] << 8 | trace[83]), Receivers::COORD_SCALE / 2);
+  uint32_t bits = 0;
+  for (unsigned int b = 0; b < 4; ++b)
+    bits = bits << 8 | trace[240 + 2 * 4 + b];
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  EXPECT_FLOAT_EQ(value, receivers.sample(2, 2));
+}
+
+
+
+// =================================
+//
+// =================================
+TEST(Acoustic2D, symmetric_dirichlet_system_matrix)
+{
+  GridMatrices grid(1, 2, 6, 8);
+
+  // the system matrix of the Crank-Nicolson scheme in both storages
+  const double dt = 0.01;
+  Mat full_mat, sym_mat;
+  MatConvert(grid.mass_mat, MATSAME, MAT_INITIAL_MATRIX, &full_mat);
+  MatAXPY(full_mat, 0.25*dt*dt, grid.stiff_mat, SAME_NONZERO_PATTERN);
+  MatConvert(full_mat, MATSAME, MAT_INITIAL_MATRIX, &sym_mat);
+  const std::vector<int> &b_nodes = grid.fmesh.boundary_vertices();
+  Acoustic2D::dirichlet_matrix(b_nodes, false, &full_mat);
+  Acoustic2D::dirichlet_matrix(b_nodes, true, &sym_mat);
+
+  // the rhs vector with zero boundary values
+  Vec rhs, x, x_sym;
+  VecCreateSeq(PETSC_COMM_SELF, grid.n_dofs, &rhs);
+  VecDuplicate(rhs, &x);
+  VecDuplicate(rhs, &x_sym);
+  for (unsigned int i = 0; i < grid.n_dofs; ++i)
+    VecSetValue(rhs, i, sin(1. + i), INSERT_VALUES);
+  for (unsigned int i = 0; i < b_nodes.size(); ++i)
+    VecSetValue(rhs, b_nodes[i], 0., INSERT_VALUES);
+  VecAssemblyBegin(rhs);
+  VecAssemblyEnd(rhs);
+
+  // the direct solvers used by the Crank-Nicolson scheme
+  Mat mats[] = { full_mat, sym_mat };
+  Vec solutions[] = { x, x_sym };
+  for (unsigned int m = 0; m < 2; ++m)
+  {
+    KSP ksp;
+    KSPCreate(PETSC_COMM_WORLD, &ksp);
+    KSPSetOperators(ksp, mats[m], mats[m], SAME_PRECONDITIONER);
+    KSPSetType(ksp, KSPPREONLY);
+    PC pc;
+    KSPGetPC(ksp, &pc);
+    PCSetType(pc, (m == 0 ? PCLU : PCCHOLESKY));
+    KSPSolve(ksp, rhs, solutions[m]);
+    KSPDestroy(&ksp);
+  }
+  compare_vectors(x, x_sym, 1e-10);
+
+  MatDestroy(&full_mat);
+  MatDestroy(&sym_mat);
+  VecDestroy(&rhs);
+  VecDestroy(&x);
+  VecDestroy(&x_sym);
+}
@@ -0,0 +1,133 @@
+#ifndef VTK_SERIES_H
+#define VTK_SERIES_H
+
+#include "petscvec.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+
+
+/**
+ * Time series of the solutions on the rectangular grid in VTK XML format.
+ * The grid is uniform, so it's written as ImageData: the geometry is defined by the origin
+ * and the spacing only. Each time step is a separate .vti file with the values in raw binary
+ * appended data (no text conversion). The coefficients (if any) are written once into
+ * a separate file, and the .pvd collection refers to it as the second part of every time step,
+ * so ParaView shows them together with the solution:
+ *
+ * <name>-<step>.vti   the solution on the vertices
+ * <name>-coef.vti     the coefficients alpha and beta on the cells
+ * <name>.pvd          the index of the time steps (it's written by close())
+ *
+ * A strip of the grid (a distributed run) is the range of the rows of the cells
+ * of the whole grid, so the pieces of different processes are placed in the same coordinates.
+ */
+class VTKSeries
+{
+public:
+            /**
+             * Constructor
+             * @param dir - the directory of the files
+             * @param name - the beginning of the names of the files
+             * @param x_beg, y_beg - the origin of the whole grid
+             * @param hx, hy - the sizes of the cells
+             * @param nx - the number of cells in x-direction
+             * @param cell_row_beg, cell_row_end - the range of the rows of the cells of the grid (or the strip)
+             */
+  VTKSeries(const std::string &dir, const std::string &name,
+            double x_beg, double y_beg, double hx, double hy,
+            unsigned int nx, unsigned int cell_row_beg, unsigned int cell_row_end);
+
+            /**
+             * Destructor. The index is written if it hasn't been yet
+             */
+  ~VTKSeries();
+
+            /**
+             * The number of vertices (the number of values of each time step)
+             */
+  unsigned int n_points() const;
+
+            /**
+             * The number of cells (the number of values of each coefficient)
+             */
+  unsigned int n_cells() const;
+
+            /**
+             * Write the coefficients (once for the whole series)
+             * @param alpha, beta - the values of the coefficients on the cells
+             */
+  void write_coefficients(const std::vector<double> &alpha, const std::vector<double> &beta);
+
+            /**
+             * Write the solution of the time step. It can be called by several threads at the same time
+             * @param step - the time step
+             * @param time - the time
+             * @param values - the sequential vector with (at least) n_points values in the order of the vertices
+             *                 of the grid (row by row)
+             */
+  void write_step(unsigned int step, double time, Vec values);
+
+            /**
+             * Write the solution of the time step
+             * @param step - the time step
+             * @param time - the time
+             * @param values - n_points values
+             */
+  void write_step(unsigned int step, double time, const double *values);
+
+            /**
+             * Write the .pvd index of the written time steps
+             */
+  void close();
+
+            /**
+             * The names of the files of the series
+             */
+  std::string step_file(unsigned int step) const;
+  std::string coefficients_file() const;
+  std::string index_file() const;
+
+private:
+  std::string _dir, _name;
+  double _x_beg, _y_beg, _hx, _hy;
+  unsigned int _nx, _cell_row_beg, _cell_row_end;
+
+            /**
+             * The written time steps and their times
+             */
+  std::vector<std::pair<unsigned int, double> > _steps;
+
+            /**
+             * Whether the coefficients are written
+             */
+  bool _has_coefficients;
+
+            /**
+             * Whether the index is written
+             */
+  bool _closed;
+
+            /**
+             * The list of the time steps is changed under this mutex
+             */
+  std::mutex _mutex;
+
+            /**
+             * Write the .vti file with the arrays in raw appended data
+             * @param fname - the name of the file
+             * @param cell_data - whether the arrays are defined on the cells (otherwise on the vertices)
+             * @param names - the names of the arrays
+             * @param arrays - the values of the arrays
+             * @param n_values - the number of values of each array
+             */
+  void write_image(const std::string &fname, bool cell_data, const std::vector<std::string> &names,
+                   const std::vector<const double*> &arrays, uint64_t n_values) const;
+
+  VTKSeries(const VTKSeries&); /** copy constructor */
+  VTKSeries& operator=(const VTKSeries&); /** copy assignment operator */
+};
+
+
+#endif // VTK_SERIES_H
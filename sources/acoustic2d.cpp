@@ -8,14 +8,51 @@
 #include "fem/math_functions.h"
 #include "layer.h"
 #include "block_of_layers.h"
+#include "leapfrog_operator.h"
+#include "q1_stencil.h"
+#include "coefficients_file.h"
+#include "csr_assembler.h"
+#include "numa_memory.h"
+#include "strip_partition.h"
+#include "mesh_partition.h"
+#include "async_writer.h"
+#include "solution_file.h"
+#include "vtk_series.h"
+#include "output_window.h"
+#include "receivers.h"
 #include <iostream>
 #include <algorithm>
 #include <fstream>
+#include <sstream>
+#include <array>
+#include <numeric>
+#include <iterator>
+#include <cstdio>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include <boost/timer/timer.hpp>
+#if defined(_OPENMP)
+  #include <omp.h>
+#endif
+
+// the rhs vectors of the triangular meshes are written on each time step
+#define WATCH_RHS
 
 using namespace fem;
 
 Acoustic2D::Acoustic2D(Parameters *param)
-  : _param(param)
+  : _param(param),
+    _stencil(NULL),
+    _assembler(NULL),
+    _natural_vec(NULL),
+    _partition(NULL),
+    _mesh_partition(NULL),
+    _output(NULL),
+    _sol_writer(NULL),
+    _vtk_series(NULL),
+    _window(NULL),
+    _vtk_shift(0),
+    _receivers(NULL)
 {
   require(_param->FE_ORDER == 1, "This fe order hasn't been implemented");
   require(_param->RES_DIR != "", "Computation environment was not established through Parameter function");
@@ -24,6 +61,14 @@ Acoustic2D::Acoustic2D(Parameters *param)
 
 Acoustic2D::~Acoustic2D()
 {
+  delete _stencil;
+  delete _assembler;
+  delete _partition;
+  delete _mesh_partition;
+  delete _output;
+  delete _sol_writer;
+  delete _vtk_series;
+  delete _window;
   //VecDestroy(&_global_rhs);
   //MatDestroy(&_global_mass_mat);
   //MatDestroy(&_global_stiff_mat);
@@ -39,6 +84,7 @@ void Acoustic2D::solve_rectangles()
   _fmesh.create_rectangular_grid(_param->X_BEG, _param->X_END,
                                  _param->Y_BEG, _param->Y_END,
                                  _param->N_FINE_X, _param->N_FINE_Y);
+  setup_output_window();
 
 #if defined(DEBUG)
   std::cout << "n_vertices = " << _fmesh.n_vertices() << std::endl;
@@ -53,34 +99,49 @@ void Acoustic2D::solve_rectangles()
   std::cout << "n_dofs = " << dof_handler.n_dofs() << std::endl;
 #endif
 
-  // create sparse format based on the distribution of degrees of freedom.
-  // since we use first order basis functions, and then
-  // all dofs are associated with the mesh vertices,
-  // sparse format is based on connectivity of the mesh vertices
+  // allocate memory
+  VecCreateSeq(PETSC_COMM_SELF, dof_handler.n_dofs(), &_global_rhs);
+
+  // fill up the array of coefficients alpha and beta
+  setup_coefficients();
+
+
+
+  // sparse format (it's not required by matrix-free operators)
   CSRPattern csr_pattern;
-  csr_pattern.make_sparse_format(dof_handler, CG);
+
+  if (_param->MATRIX_FREE)
+  {
+    // the grid is uniform, so the mass and stiffness matrices are not assembled,
+    // but applied as the stencils based on the reference cell
+    _stencil = new Q1Stencil(_fmesh, _param->N_FINE_X, _param->N_FINE_Y, _coef_alpha, _coef_beta);
+    _global_mass_mat = NULL;
+    _global_stiff_mat = NULL;
+  }
+  else
+  {
+    // create sparse format based on the distribution of degrees of freedom.
+    // since we use first order basis functions, and then
+    // all dofs are associated with the mesh vertices,
+    // sparse format is based on connectivity of the mesh vertices
+    csr_pattern.make_sparse_format(dof_handler, CG);
 #if defined(DEBUG)
-  std::cout << "csr_order = " << csr_pattern.order() << std::endl;
+    std::cout << "csr_order = " << csr_pattern.order() << std::endl;
 #endif
 
-  expect(csr_pattern.order() == dof_handler.n_dofs(), "Error");
+    expect(csr_pattern.order() == dof_handler.n_dofs(), "Error");
 
+    renumber_dofs(dof_handler, csr_pattern);
+    assemble_matrices(_fmesh.rectangles(), csr_pattern, &_coef_alpha[0], &_coef_beta[0]);
+  }
 
-  // allocate memory
-  VecCreateSeq(PETSC_COMM_SELF, csr_pattern.order(), &_global_rhs);
-  MatCreateSeqAIJ(PETSC_COMM_WORLD, csr_pattern.order(), csr_pattern.order(), 0, csr_pattern.nnz(), &_global_mass_mat);
-  MatCreateSeqAIJ(PETSC_COMM_WORLD, csr_pattern.order(), csr_pattern.order(), 0, csr_pattern.nnz(), &_global_stiff_mat);
+  solve(dof_handler, csr_pattern);
+}
 
-  // allocate the memory for local matrices and vectors
-  double **local_mass_mat = new double*[Rectangle::n_dofs_first];
-  double **local_stiff_mat = new double*[Rectangle::n_dofs_first];
-  for (unsigned int i = 0; i < Rectangle::n_dofs_first; ++i)
-  {
-    local_mass_mat[i] = new double[Rectangle::n_dofs_first];
-    local_stiff_mat[i] = new double[Rectangle::n_dofs_first];
-  }
 
-  // fill up the array of coefficients alpha and beta
+
+void Acoustic2D::setup_coefficients()
+{
   if (_param->CREATE_BIN_LAYERS_FILE)
   {
     if (_param->WHAT_BIN_LAYERS_FILE == "3")
@@ -100,7 +161,23 @@ void Acoustic2D::solve_rectangles()
   else // if the coefficients haven't been saved before, we distribute them according to layers file or other ways
   {
     if (_param->USE_LAYERS_FILE)
-      coefficients_initialization();
+    {
+      const std::string cache_file = (_param->COEF_CACHE ? coefficients_cache_file() : "");
+      if (cache_file != "" && boost::filesystem::exists(cache_file)) // the same distribution has been computed before
+        import_coefficients_per_vertex(cache_file); // the cache is a binary per-cell file
+      else
+      {
+        coefficients_initialization();
+        if (cache_file != "" && _partition == NULL) // the strip of a distributed run is only a part of the grid
+        {
+          // write into a temporary file first, so concurrent runs never see a partially written cache
+          const std::string tmp_file = cache_file + "." + d2s(getpid()) + ".tmp";
+          CoefficientsFile::write(tmp_file, CoefficientsFile::PER_CELL,
+                                  _param->N_FINE_X, _param->N_FINE_Y, _coef_alpha, _coef_beta);
+          require(rename(tmp_file.c_str(), cache_file.c_str()) == 0, "Cannot create the coefficients cache file " + cache_file);
+        }
+      }
+    }
     else
     {
       _coef_alpha.resize(_fmesh.n_rectangles(), _param->COEF_A_VALUES[0]);
@@ -120,45 +197,53 @@ void Acoustic2D::solve_rectangles()
     else if (_param->SAVE_COEF_PER_VERT) // if we need to save coefficients after distribution - one per vertex,
       export_coefficients_per_vertex(_param->COEF_FILE); // we convert them to vertex-wise format and export them into a file
   }
+}
 
 
 
-  // assemble the matrices
-  for (unsigned int cell = 0; cell < _fmesh.n_rectangles(); ++cell)
+void Acoustic2D::renumber_dofs(const DoFHandler &dof_handler, const CSRPattern &csr_pattern)
+{
+  if (_param->DOF_ORDERING == NATURAL_ORDERING)
+    _renumbering = DoFRenumbering();
+  else if (_param->DOF_ORDERING == RCM_ORDERING)
+    _renumbering = DoFRenumbering::cuthill_mckee(csr_pattern);
+  else
   {
-    const Rectangle rectangle = _fmesh.rectangle(cell);
-    rectangle.local_mass_matrix(_coef_alpha[cell], local_mass_mat);
-    rectangle.local_stiffness_matrix(_coef_beta[cell], local_stiff_mat);
-
-    for (unsigned int i = 0; i < rectangle.n_dofs(); ++i)
-    {
-      const unsigned int dof_i = rectangle.dof(i);
-      for (unsigned int j = 0; j < rectangle.n_dofs(); ++j)
-      {
-        const unsigned int dof_j = rectangle.dof(j);
-        MatSetValue(_global_mass_mat, dof_i, dof_j, local_mass_mat[i][j], ADD_VALUES);
-        MatSetValue(_global_stiff_mat, dof_i, dof_j, local_stiff_mat[i][j], ADD_VALUES);
-      }
-    }
+    require(_fmesh.n_rectangles() > 0, "Morton and tiled orderings of dofs are used for rectangular grids only");
+    if (_param->DOF_ORDERING == MORTON_ORDERING)
+      _renumbering = DoFRenumbering::morton(dof_handler.dofs(), _param->N_FINE_X, _param->N_FINE_Y);
+    else if (_param->DOF_ORDERING == TILED_ORDERING)
+      _renumbering = DoFRenumbering::tiled(dof_handler.dofs(), _param->N_FINE_X, _param->N_FINE_Y);
+    else
+      require(false, "Unknown ordering of dofs");
   }
 
-  // free the memory
-  for (unsigned int i = 0; i < Rectangle::n_dofs_first; ++i)
-  {
-    delete[] local_mass_mat[i];
-    delete[] local_stiff_mat[i];
-  }
-  delete[] local_mass_mat;
-  delete[] local_stiff_mat;
+  if (!_renumbering.natural() && _natural_vec == NULL)
+    VecDuplicate(_global_rhs, &_natural_vec);
+
+  if (_param->PRINT_INFO)
+    std::cout << "bandwidth: original " << DoFRenumbering().bandwidth(csr_pattern)
+              << " renumbered " << _renumbering.bandwidth(csr_pattern) << std::endl;
+}
+
+
+
+Vec Acoustic2D::natural_order(Vec x) const
+{
+  if (_renumbering.natural())
+    return x;
+  _renumbering.to_natural(x, _natural_vec);
+  return _natural_vec;
+}
 
-  MatAssemblyBegin(_global_mass_mat, MAT_FINAL_ASSEMBLY);
-  MatAssemblyEnd(_global_mass_mat, MAT_FINAL_ASSEMBLY);
 
-  MatAssemblyBegin(_global_stiff_mat, MAT_FINAL_ASSEMBLY);
-  MatAssemblyEnd(_global_stiff_mat, MAT_FINAL_ASSEMBLY);
 
-  if (_param->TIME_SCHEME == EXPLICIT)
-    solve_explicit_rectangles(dof_handler, csr_pattern);
+void Acoustic2D::solve(const DoFHandler &dof_handler, const CSRPattern &csr_pattern)
+{
+  if (_param->DISTRIBUTED)
+    solve_explicit_distributed(dof_handler);
+  else if (_param->TIME_SCHEME == EXPLICIT)
+    solve_explicit(dof_handler);
   else if(_param->TIME_SCHEME == CRANK_NICOLSON)
     solve_crank_nicolson(dof_handler, csr_pattern);
   else
@@ -167,7 +252,7 @@ void Acoustic2D::solve_rectangles()
 
 
 
-void Acoustic2D::solve_explicit_rectangles(const DoFHandler &dof_handler, const CSRPattern &csr_pattern)
+void Acoustic2D::solve_explicit(const DoFHandler &dof_handler)
 {
   require(_param->FE_ORDER == 1, "This fe order is not implemented (" + d2s(_param->FE_ORDER) + ")");
 
@@ -189,150 +274,1025 @@ void Acoustic2D::solve_explicit_rectangles(const DoFHandler &dof_handler, const
   const InitialSolution init_solution;
   for (unsigned int d = 0; d < dof_handler.n_dofs(); ++d)
   {
-    VecSetValue(solution_2, d, init_solution.value(dof_handler.dof(d), _param->TIME_BEG), INSERT_VALUES);
-    VecSetValue(solution_1, d, init_solution.value(dof_handler.dof(d), _param->TIME_BEG + dt), INSERT_VALUES);
+    VecSetValue(solution_2, _renumbering.new_dof(d), init_solution.value(dof_handler.dof(d), _param->TIME_BEG), INSERT_VALUES);
+    VecSetValue(solution_1, _renumbering.new_dof(d), init_solution.value(dof_handler.dof(d), _param->TIME_BEG + dt), INSERT_VALUES);
+  }
+
+  // make a SLAE rhs vector
+  Vec system_rhs;
+  VecDuplicate(_global_rhs, &system_rhs);
+
+  // boundary nodes (the vertices of the mesh, and the corresponding dofs)
+  const std::vector<int> &b_vertices = _fmesh.boundary_vertices();
+  const std::vector<int> b_nodes = _renumbering.new_dofs(b_vertices);
+
+  Mat system_mat = NULL; // system matrix (in case of consistent mass matrix)
+  KSP ksp = NULL; // SLAE solver (in case of consistent mass matrix)
+  Vec mass_diag = NULL; // the diagonal of the lumped mass matrix
+
+  if (_param->MASS_LUMPING)
+  {
+    // the mass matrix is diagonal, and the Dirichlet boundary condition
+    // is imposed with ones on this diagonal
+    VecDuplicate(system_rhs, &mass_diag);
+    lumped_mass_diagonal(b_nodes, mass_diag);
+  }
+  else if (_stencil != NULL)
+  {
+    // system matrix equal to global mass matrix with ones on diagonal
+    // for the boundary nodes. it's applied matrix-free
+    _stencil->create_system_matrix(1., 0., b_nodes, &system_mat);
+
+    // SLAE solver. the matrix is not available entry-wise,
+    // so it's preconditioned by its diagonal
+    KSPCreate(PETSC_COMM_WORLD, &ksp);
+    KSPSetOperators(ksp, system_mat, system_mat, SAME_PRECONDITIONER);
+    KSPSetTolerances(ksp, 1e-12, 1e-30, 1e+5, 10000);
+    PC pc;
+    KSPGetPC(ksp, &pc);
+    PCSetType(pc, PCJACOBI);
+  }
+  else
+  {
+    // system matrix equal to global mass matrix
+    MatConvert(_global_mass_mat, MATSAME, MAT_INITIAL_MATRIX, &system_mat); // allocate memory and copy values
+
+    // impose Dirichlet boundary condition
+    // with ones on diagonal
+    dirichlet_system_matrix(b_nodes, &system_mat); // change the matrix
+
+    // SLAE solver
+    KSPCreate(PETSC_COMM_WORLD, &ksp);
+    KSPSetOperators(ksp, system_mat, system_mat, SAME_PRECONDITIONER);
+    KSPSetTolerances(ksp, 1e-12, 1e-30, 1e+5, 10000);
+    if (_param->SYMMETRIC_STORAGE) // the symmetric format requires a symmetric solver
+    {
+      KSPSetType(ksp, KSPCG);
+      PC pc;
+      KSPGetPC(ksp, &pc);
+      PCSetType(pc, PCICC);
+    }
+  }
+
+  require(_param->N_TIME_STEPS > 1, "There is no time steps to perform: n_time_steps = " + d2s(_param->N_TIME_STEPS));
+
+  const RHSFunction rhs_function(*_param);
+  Vec source_load = source_load_vector(rhs_function, dof_handler); // spatial part of the source
+
+  if (_param->SPMV_BENCHMARK > 0)
+    benchmark_operators(_param->SPMV_BENCHMARK);
+
+  // the results are written by the I/O threads (if any) while the time loop goes on
+  start_output(dof_handler.n_dofs(), [this, &dof_handler](unsigned int time_step, const double *values)
+                                     { write_snapshot(time_step, values, dof_handler.n_dofs()); });
+  open_solution_file(dof_handler.n_dofs());
+  open_vtk_series(0, _param->N_FINE_Y);
+
+  // the traces of the receivers begin with the initial time steps
+  setup_receivers(0, dof_handler.n_dofs());
+  record_receivers(solution_2);
+  record_receivers(solution_1);
+
+  if (_param->PRINT_INFO)
+    std::cout << "time loop started..." << std::endl;
+
+  // the operator of the explicit scheme: (2M - dt^2 K) u^n - M u^{n-1}.
+  // in case of lumped mass matrix it also includes the division by the diagonal
+  LeapfrogOperator *leapfrog = leapfrog_operator(2., -dt*dt, -1., 0., mass_diag);
+
+  // in case of lumped mass matrix the operator gives the solution itself,
+  // otherwise it gives the rhs vector of the SLAE with the mass matrix
+  Vec *step_vec = (_param->MASS_LUMPING ? &solution : &system_rhs);
+
+  if (_param->THREADED_LOOP) // the time loop is executed by several threads over the raw arrays
+    time_loop_threaded(*leapfrog, rhs_function, source_load, dof_handler, b_vertices, b_nodes,
+                       solution, solution_1, solution_2);
+  else
+  {
+    for (unsigned int time_step = 2; time_step <= _param->N_TIME_STEPS; ++time_step)
+    {
+      const double time = _param->TIME_BEG + time_step * dt; // current time
+
+      // dt^2 F + (2M - dt^2 K) u^n - M u^{n-1} in one sweep,
+      // where F is the rhs function on the previous time step
+      apply_leapfrog(*leapfrog, rhs_function, source_load, dof_handler, time - dt,
+                     solution_1, solution_2, *step_vec);
+
+      // impose Dirichlet boundary condition
+      const BoundaryFunction boundary_function;
+      for (unsigned int i = 0; i < b_nodes.size(); ++i)
+        VecSetValue(*step_vec, b_nodes[i], boundary_function.value(_fmesh.vertex(b_vertices[i]), time), INSERT_VALUES); // change the rhs vector
+      VecAssemblyBegin(*step_vec);
+      VecAssemblyEnd(*step_vec);
+
+      // solve the SLAE (there is nothing to solve in case of lumped mass matrix)
+      if (!_param->MASS_LUMPING)
+        KSPSolve(ksp, system_rhs, solution);
+
+      // check solution
+  //    for (int i = 0; i < _fmesh.n_vertices(); ++i)
+  //    {
+  //      Point vert = _fmesh.vertex(i);
+  //      VecSetValue(exact_solution, i, an_solution(vert, time), INSERT_VALUES);
+  //    }
+  //    std::cout << "time step = " << time_step << " time = " << time << " relative error = " << rel_error(solution, exact_solution) << std::endl;
+
+  #if defined(WATCH_RHS)
+      if (!_param->MASS_LUMPING && _fmesh.n_triangles() > 0)
+      {
+        Result res(&dof_handler);
+        std::string fname = _param->VTU_DIR + "/rhs-" + d2s(time_step) + ".vtu";
+        res.write_vtu(fname, natural_order(system_rhs));
+      }
+  #endif
+
+      record_receivers(solution);
+      save_results(dof_handler, time_step, solution);
+
+      if (_param->PRINT_INFO)
+      {
+        double norm;
+        VecNorm(solution, NORM_2, &norm);
+        std::cout.setf(std::ios::scientific);
+        std::cout.precision(4);
+        std::cout << "  step " << time_step << " norm " << norm;
+        if (!_param->MASS_LUMPING)
+        {
+          double rhs_norm;
+          VecNorm(system_rhs, NORM_2, &rhs_norm);
+          std::cout << " rhs_norm " << rhs_norm;
+        }
+        std::cout << std::endl;
+      }
+
+      // reassign the solutions on the previuos time steps.
+      // the vectors are rotated, so nothing is copied
+      Vec solution_3 = solution_2;
+      solution_2 = solution_1;
+      solution_1 = solution;
+      solution = solution_3;
+
+    } // time loop
+  }
+
+  delete leapfrog;
+  finish_output();
+
+  if (_fmesh.n_triangles() > 0) // the final solution on the triangular mesh is kept near the mesh file
+    save_mesh_solution(dof_handler, solution_1); // the last solution after the rotation
+
+  KSPDestroy(&ksp);
+
+  MatDestroy(&system_mat);
+  VecDestroy(&mass_diag);
+
+  VecDestroy(&source_load);
+  VecDestroy(&solution);
+  VecDestroy(&solution_1);
+  VecDestroy(&solution_2);
+  //VecDestroy(&exact_solution);
+  VecDestroy(&system_rhs);
+}
+
+
+
+void Acoustic2D::solve_crank_nicolson(const DoFHandler &dof_handler, const CSRPattern &csr_pattern)
+{
+  require(_param->FE_ORDER == 1, "This fe order is not implemented (" + d2s(_param->FE_ORDER) + ")");
+
+  // the scheme is implicit (average acceleration), and it's unconditionally stable:
+  // M (u^{n+1} - 2u^n + u^{n-1}) / dt^2 + K (u^{n+1} + 2u^n + u^{n-1}) / 4 = F^n,
+  // therefore on each time step we solve the SLAE
+  // (M + dt^2/4 K) u^{n+1} = dt^2 F^n + (2M - dt^2/2 K) u^n - (M + dt^2/4 K) u^{n-1}
+
+  // create vectors
+  Vec solution; // numerical solution on the current (n-th) time step
+  Vec solution_1; // numerical solution on the previous ((n-1)-th) time step
+  Vec solution_2; // numerical solution on the preprevious ((n-2)-th) time step
+
+  VecDuplicate(_global_rhs, &solution);
+  VecDuplicate(_global_rhs, &solution_1);
+  VecDuplicate(_global_rhs, &solution_2);
+
+  // for brevity
+  const double dt = _param->TIME_STEP;
+
+  // fill vectors with solution on the 0-th and 1-st time steps
+  const InitialSolution init_solution;
+  for (unsigned int d = 0; d < dof_handler.n_dofs(); ++d)
+  {
+    VecSetValue(solution_2, _renumbering.new_dof(d), init_solution.value(dof_handler.dof(d), _param->TIME_BEG), INSERT_VALUES);
+    VecSetValue(solution_1, _renumbering.new_dof(d), init_solution.value(dof_handler.dof(d), _param->TIME_BEG + dt), INSERT_VALUES);
   }
 
   // make a SLAE rhs vector
-  Vec system_rhs, temp;
+  Vec system_rhs;
   VecCreateSeq(PETSC_COMM_SELF, csr_pattern.order(), &system_rhs);
-  VecDuplicate(system_rhs, &temp);
 
-  // boundary nodes
-  const std::vector<int> &b_nodes = _fmesh.boundary_vertices();
+  // boundary nodes (the vertices of the mesh, and the corresponding dofs)
+  const std::vector<int> &b_vertices = _fmesh.boundary_vertices();
+  const std::vector<int> b_nodes = _renumbering.new_dofs(b_vertices);
 
-  // system matrix equal to global mass matrix
+  // system matrix (M + dt^2/4 K).
+  // the mass and stiffness matrices have the same sparse structure
   Mat system_mat;
   MatConvert(_global_mass_mat, MATSAME, MAT_INITIAL_MATRIX, &system_mat); // allocate memory and copy values
+  MatAXPY(system_mat, 0.25*dt*dt, _global_stiff_mat, SAME_NONZERO_PATTERN);
 
   // impose Dirichlet boundary condition
   // with ones on diagonal
-  MatZeroRows(system_mat, b_nodes.size(), &b_nodes[0], 1., solution, system_rhs); // change the matrix
-
-  // SLAE solver
+  dirichlet_system_matrix(b_nodes, &system_mat); // change the matrix
+
+  // SLAE solver.
+  // the system matrix doesn't change during the time loop,
+  // therefore it's factorized only once (in KSPSetUp),
+  // and then each time step requires only forward and backward substitutions.
+  // another solver (for example, -ksp_type cg -pc_type icc) can be chosen
+  // from the command line, and its preconditioner is built only once as well
   KSP ksp;
   KSPCreate(PETSC_COMM_WORLD, &ksp);
   KSPSetOperators(ksp, system_mat, system_mat, SAME_PRECONDITIONER);
+  KSPSetType(ksp, KSPPREONLY);
+  PC pc;
+  KSPGetPC(ksp, &pc);
+  PCSetType(pc, (_param->SYMMETRIC_STORAGE ? PCCHOLESKY : PCLU)); // the symmetric format is factorized by Cholesky
   KSPSetTolerances(ksp, 1e-12, 1e-30, 1e+5, 10000);
-
-  double *local_rhs_vec = new double[Rectangle::n_dofs_first];
+  KSPSetFromOptions(ksp);
+  KSPSetUp(ksp);
 
   require(_param->N_TIME_STEPS > 1, "There is no time steps to perform: n_time_steps = " + d2s(_param->N_TIME_STEPS));
 
   const RHSFunction rhs_function(*_param);
+  Vec source_load = source_load_vector(rhs_function, dof_handler); // spatial part of the source
+
+  // the results are written by the I/O threads (if any) while the time loop goes on
+  start_output(dof_handler.n_dofs(), [this, &dof_handler](unsigned int time_step, const double *values)
+                                     { write_snapshot(time_step, values, dof_handler.n_dofs()); });
+  open_solution_file(dof_handler.n_dofs());
+  open_vtk_series(0, _param->N_FINE_Y);
+
+  // the traces of the receivers begin with the initial time steps
+  setup_receivers(0, dof_handler.n_dofs());
+  record_receivers(solution_2);
+  record_receivers(solution_1);
 
   if (_param->PRINT_INFO)
     std::cout << "time loop started..." << std::endl;
 
+  // the operator of the rhs: (2M - dt^2/2 K) u^n - (M + dt^2/4 K) u^{n-1}
+  const LeapfrogOperator *leapfrog = leapfrog_operator(2., -0.5*dt*dt, -1., -0.25*dt*dt);
+
   for (unsigned int time_step = 2; time_step <= _param->N_TIME_STEPS; ++time_step)
   {
     const double time = _param->TIME_BEG + time_step * dt; // current time
-    VecSet(system_rhs, 0.); // zeroing the system rhs vector
-    VecSet(solution, 0.); // zeroing the solution vector
-
-    // assemble some parts of system rhs vector
-    for (unsigned int cell = 0; cell < _fmesh.n_rectangles(); ++cell)
-    {
-      Rectangle rectangle = _fmesh.rectangle(cell);
-      rectangle.local_rhs_vector(rhs_function, dof_handler.dofs(), time - dt, local_rhs_vec); // rhs function on the previous time step
-#if defined(DEBUG)
-      std::cout << "\trectangle " << cell << "\n\t";
-      for (int i = 0; i < rectangle.n_dofs(); ++i)
-        std::cout << local_rhs_vec[i] << " ";
-      std::cout << std::endl;
-#endif
-      for (unsigned int i = 0; i < rectangle.n_dofs(); ++i)
-      {
-        const unsigned int dof_i = rectangle.dof(i);
-        VecSetValue(system_rhs, dof_i, local_rhs_vec[i], ADD_VALUES);
-      }
-    } // rhs part assembling
-
-    MatMult(_global_stiff_mat, solution_1, temp);
-    VecAXPBY(system_rhs, -dt*dt, dt*dt, temp);
-
-    MatMult(_global_mass_mat, solution_2, temp);
-    VecAXPY(system_rhs, -1., temp);
 
-    MatMult(_global_mass_mat, solution_1, temp);
-    VecAXPY(system_rhs, 2., temp);
+    // dt^2 F + (2M - dt^2/2 K) u^n - (M + dt^2/4 K) u^{n-1} in one sweep,
+    // where F is the rhs function on the previous time step
+    apply_leapfrog(*leapfrog, rhs_function, source_load, dof_handler, time - dt,
+                   solution_1, solution_2, system_rhs);
 
     // impose Dirichlet boundary condition
     const BoundaryFunction boundary_function;
     for (unsigned int i = 0; i < b_nodes.size(); ++i)
-      VecSetValue(system_rhs, b_nodes[i], boundary_function.value(_fmesh.vertex(b_nodes[i]), time), INSERT_VALUES); // change the rhs vector
+      VecSetValue(system_rhs, b_nodes[i], boundary_function.value(_fmesh.vertex(b_vertices[i]), time), INSERT_VALUES); // change the rhs vector
+    VecAssemblyBegin(system_rhs);
+    VecAssemblyEnd(system_rhs);
 
-    // solve the SLAE
+    // solve the SLAE using the factorization computed before the time loop
     KSPSolve(ksp, system_rhs, solution);
 
-    // reassign the solutions on the previuos time steps
-    VecCopy(solution_1, solution_2);
-    VecCopy(solution,   solution_1);
-
-    // check solution
-//    for (int i = 0; i < _fmesh.n_vertices(); ++i)
-//    {
-//      Point vert = _fmesh.vertex(i);
-//      VecSetValue(exact_solution, i, an_solution(vert, time), INSERT_VALUES);
-//    }
-//    std::cout << "time step = " << time_step << " time = " << time << " relative error = " << rel_error(solution, exact_solution) << std::endl;
-
-    if ((_param->PRINT_VTU && (time_step % _param->VTU_STEP == 0)) || (time_step == _param->N_TIME_STEPS))
-    {
-      Result res(&dof_handler);
-      std::string fname = _param->VTU_DIR + "/res-" + d2s(time_step) + ".vts";
-      if (time_step == _param->N_TIME_STEPS && _param->EXPORT_COEFFICIENTS) // we export coefficients only for the last step
-        res.write_vts(fname, _param->N_FINE_X, _param->N_FINE_Y, solution, NULL, _coef_alpha, _coef_beta);
-      else
-        res.write_vts(fname, _param->N_FINE_X, _param->N_FINE_Y, solution); //, exact_solution, _coef_alpha, _coef_beta);
-    }
+    record_receivers(solution);
+    save_results(dof_handler, time_step, solution);
 
     if (_param->PRINT_INFO)
     {
       double rhs_norm;
       VecNorm(system_rhs, NORM_2, &rhs_norm);
-      double system_rhs_norm;
-      VecNorm(system_rhs, NORM_2, &system_rhs_norm);
       double norm;
       VecNorm(solution, NORM_2, &norm);
       std::cout.setf(std::ios::scientific);
       std::cout.precision(4);
-      std::cout << "  step " << time_step << " norm " << norm << " rhs_norm " << rhs_norm
-                << " sys_rhs_norm " << system_rhs_norm << std::endl;
+      std::cout << "  step " << time_step << " norm " << norm << " rhs_norm " << rhs_norm << std::endl;
     }
 
-    if ((_param->SAVE_SOL && (time_step % _param->SOL_STEP == 0)) || (time_step == _param->N_TIME_STEPS))
-    {
-      // extract data from PETSc vector
-      std::vector<int> idx(csr_pattern.order());
-      std::iota(idx.begin(), idx.end(), 0); // idx = { 0, 1, 2, 3, .... }
-      std::vector<double> solution_values(csr_pattern.order());
-      VecGetValues(solution, csr_pattern.order(), &idx[0], &solution_values[0]);
-      // write the solution to the file
-      std::string fname = _param->SOL_DIR + "/sol-" + d2s(time_step) + ".dat";
-      std::ofstream out(fname);
-      out.setf(std::ios::scientific);
-      out.precision(16);
-      //out << csr_pattern.order() << "\n";
-      for (unsigned int i = 0; i < csr_pattern.order(); ++i)
-        out << solution_values[i] << "\n";
-      out.close();
-    }
+    // reassign the solutions on the previuos time steps.
+    // the vectors are rotated, so nothing is copied
+    Vec solution_3 = solution_2;
+    solution_2 = solution_1;
+    solution_1 = solution;
+    solution = solution_3;
 
   } // time loop
 
+  delete leapfrog;
+  finish_output();
+
   KSPDestroy(&ksp);
 
   MatDestroy(&system_mat);
 
-  delete[] local_rhs_vec;
-
+  VecDestroy(&source_load);
   VecDestroy(&solution);
   VecDestroy(&solution_1);
   VecDestroy(&solution_2);
-  //VecDestroy(&exact_solution);
   VecDestroy(&system_rhs);
-  VecDestroy(&temp);
+}
+
+
+
+void Acoustic2D::assemble_rhs(const Function &function, const DoFHandler &dof_handler,
+                              double time, Vec rhs) const
+{
+  VecSet(rhs, 0.); // zeroing the vector
+
+  if (_fmesh.n_rectangles() > 0) // rectangular grid
+    add_local_rhs(_fmesh.rectangles(), dof_handler.dofs(), function, time, rhs);
+  else // triangular mesh
+    add_local_rhs(_fmesh.triangles(), _fmesh.vertices(), function, time, rhs);
+
+  VecAssemblyBegin(rhs);
+  VecAssemblyEnd(rhs);
+}
+
+
+
+template <class Cell>
+void Acoustic2D::add_local_rhs(const std::vector<Cell> &cells, const std::vector<Point> &points,
+                               const Function &function, double time, Vec rhs) const
+{
+  constexpr unsigned int n_dofs = Cell::n_dofs_first;
+  std::array<double, n_dofs> local_rhs_vec;
+  std::array<PetscInt, n_dofs> dofs;
+
+  for (unsigned int cell = 0; cell < cells.size(); ++cell)
+  {
+    const Cell &element = cells[cell];
+    element.local_rhs_vector(function, points, time, local_rhs_vec.data());
+    for (unsigned int i = 0; i < n_dofs; ++i)
+      dofs[i] = _renumbering.new_dof(element.dof(i));
+    VecSetValues(rhs, n_dofs, dofs.data(), local_rhs_vec.data(), ADD_VALUES);
+  }
+}
+
+
+
+Vec Acoustic2D::source_load_vector(const Function &function, const DoFHandler &dof_handler) const
+{
+  const SeparableFunction *separable = dynamic_cast<const SeparableFunction*>(&function);
+  if (separable == NULL) // the function can't be split into spatial and time parts
+    return NULL;
+
+  // the load vector of the spatial part doesn't depend on time,
+  // therefore it's assembled only once
+  Vec load;
+  VecDuplicate(_global_rhs, &load);
+  assemble_rhs(SpatialPart(*separable), dof_handler, 0., load);
+  return load;
+}
+
+
+
+void Acoustic2D::rhs_vector(const Function &function, Vec source_load, const DoFHandler &dof_handler,
+                            double time, Vec rhs) const
+{
+  if (source_load != NULL) // separable function: rhs = w(t) * load
+  {
+    const SeparableFunction &separable = dynamic_cast<const SeparableFunction&>(function);
+    VecAXPBY(rhs, separable.time_value(time), 0., source_load);
+  }
+  else // general function: assemble the vector cell by cell
+    assemble_rhs(function, dof_handler, time, rhs);
+}
+
+
+
+void Acoustic2D::time_loop_threaded(LeapfrogOperator &leapfrog, const Function &function, Vec source_load,
+                                    const DoFHandler &dof_handler,
+                                    const std::vector<int> &b_vertices, const std::vector<int> &b_nodes,
+                                    Vec &solution, Vec &solution_1, Vec &solution_2) const
+{
+  require(leapfrog.partitioned(), "The operator can't be applied by several threads");
+  require(source_load != NULL, "The threaded time loop requires a separable rhs function");
+  const SeparableFunction &separable = dynamic_cast<const SeparableFunction&>(function);
+  const BoundaryFunction boundary_function;
+  const double dt = _param->TIME_STEP;
+  const NumaPlacement placement(_param->PIN_MAP, _param->HUGE_PAGES);
+
+#if defined(_OPENMP)
+  const unsigned int n_threads = (_param->N_THREADS > 0 ? _param->N_THREADS : omp_get_max_threads());
+#else
+  const unsigned int n_threads = 1;
+#endif
+
+  // the arrays of the operator are moved to the memory of the threads
+  leapfrog.distribute(placement, n_threads);
+
+  // the vectors are copied into the arrays first touched by the threads owning the rows,
+  // and these arrays are placed into the vectors for the time of the loop.
+  // the source load vector is only read, so its copy is used directly
+  const unsigned int n_dofs = leapfrog.order();
+  Vec vectors[] = { solution, solution_1, solution_2, source_load };
+  const unsigned int n_vectors = sizeof(vectors) / sizeof(vectors[0]);
+  NumaArray<double> buffers[n_vectors];
+  const double *values[n_vectors];
+  for (unsigned int i = 0; i < n_vectors; ++i)
+  {
+    buffers[i].allocate(n_dofs, placement.huge_pages());
+    VecGetArrayRead(vectors[i], &values[i]);
+  }
+#if defined(_OPENMP)
+  #pragma omp parallel num_threads(n_threads)
+#endif
+  {
+#if defined(_OPENMP)
+    const unsigned int part = omp_get_thread_num();
+    const unsigned int n_parts = omp_get_num_threads();
+#else
+    const unsigned int part = 0, n_parts = 1;
+#endif
+    placement.pin_thread(part);
+    for (unsigned int d = 0; d < n_dofs; ++d)
+      if (leapfrog.row_part(d, n_parts) == part)
+        for (unsigned int i = 0; i < n_vectors; ++i)
+          buffers[i][d] = values[i][d];
+  }
+  for (unsigned int i = 0; i < n_vectors; ++i)
+    VecRestoreArrayRead(vectors[i], &values[i]);
+  for (unsigned int i = 0; i < 3; ++i)
+    VecPlaceArray(vectors[i], buffers[i].data());
+  const double *load = buffers[3].data();
+
+  // the arrays are taken once for the whole loop,
+  // and each thread rotates them in the same way as the vectors are rotated
+  double *arrays[3];
+  for (unsigned int i = 0; i < 3; ++i)
+    VecGetArray(vectors[i], &arrays[i]);
+
+  // the cores of the map are checked by the placement, so a failure to pin a thread
+  // only slows it down, and it's reported after the loop
+  unsigned int n_unpinned = 0;
+
+#if defined(_OPENMP)
+  #pragma omp parallel num_threads(n_threads)
+#endif
+  {
+#if defined(_OPENMP)
+    const unsigned int part = omp_get_thread_num();
+    const unsigned int n_parts = omp_get_num_threads();
+#else
+    const unsigned int part = 0, n_parts = 1;
+#endif
+    if (!placement.pin_thread(part))
+    {
+#if defined(_OPENMP)
+      #pragma omp atomic
+#endif
+      ++n_unpinned;
+    }
+
+    // the boundary nodes in the rows computed by this thread
+    std::vector<unsigned int> own_b_nodes;
+    for (unsigned int i = 0; i < b_nodes.size(); ++i)
+      if (leapfrog.row_part(b_nodes[i], n_parts) == part)
+        own_b_nodes.push_back(i);
+
+    double *y = arrays[0], *u1 = arrays[1], *u2 = arrays[2];
+
+    for (unsigned int time_step = 2; time_step <= _param->N_TIME_STEPS; ++time_step)
+    {
+      const double time = _param->TIME_BEG + time_step * dt; // current time
+
+      // M_L^{-1} (dt^2 F + (2M - dt^2 K) u^n - M u^{n-1}) for the rows of this thread,
+      // where F is the rhs function on the previous time step
+      leapfrog.apply_part(u1, u2, dt*dt * separable.time_value(time - dt), load, y, part, n_parts);
+
+      // impose Dirichlet boundary condition
+      for (unsigned int k = 0; k < own_b_nodes.size(); ++k)
+      {
+        const unsigned int i = own_b_nodes[k];
+        y[b_nodes[i]] = boundary_function.value(_fmesh.vertex(b_vertices[i]), time);
+      }
+
+      // the only synchronization on the time step: the solution is complete after it.
+      // then the master thread saves the results, while the others start the next step -
+      // it only reads the current solution, and the step after it waits for the master
+#if defined(_OPENMP)
+      #pragma omp barrier
+      #pragma omp master
+#endif
+      {
+        double *solution_array = y;
+        VecRestoreArray(solution, &solution_array);
+        record_receivers(solution);
+        save_results(dof_handler, time_step, solution);
+        if (_param->PRINT_INFO)
+        {
+          double norm;
+          VecNorm(solution, NORM_2, &norm);
+          std::cout.setf(std::ios::scientific);
+          std::cout.precision(4);
+          std::cout << "  step " << time_step << " norm " << norm << std::endl;
+        }
+        VecGetArray(solution, &solution_array);
+
+        Vec solution_3 = solution_2;
+        solution_2 = solution_1;
+        solution_1 = solution;
+        solution = solution_3;
+      }
+
+      double *u3 = u2;
+      u2 = u1;
+      u1 = y;
+      y = u3;
+    } // time loop
+  }
+
+  if (n_unpinned > 0)
+    std::cout << "  " << n_unpinned << " of " << n_threads << " threads couldn't be pinned to the cores of the map "
+              << _param->PIN_MAP << std::endl;
+
+  // the vectors get back their own arrays with the final values
+  for (unsigned int i = 0; i < 3; ++i)
+  {
+    VecRestoreArray(vectors[i], &arrays[i]);
+    VecResetArray(vectors[i]);
+    double *vec_array;
+    VecGetArray(vectors[i], &vec_array);
+    memcpy(vec_array, buffers[i].data(), n_dofs * sizeof(double));
+    VecRestoreArray(vectors[i], &vec_array);
+  }
+}
+
+
+
+LeapfrogOperator* Acoustic2D::leapfrog_operator(double a_mass, double a_stiff,
+                                                double b_mass, double b_stiff,
+                                                Vec mass_diag) const
+{
+  if (_stencil != NULL)
+    return new Q1LeapfrogOperator(*_stencil, a_mass, a_stiff, b_mass, b_stiff, mass_diag);
+  if (_param->SELL_FORMAT)
+    return new SellLeapfrogOperator(_global_mass_mat, _global_stiff_mat, a_mass, a_stiff, b_mass, b_stiff, mass_diag);
+  if (_param->SYMMETRIC_STORAGE)
+    return new SymmetricLeapfrogOperator(_global_mass_mat, _global_stiff_mat, a_mass, a_stiff, b_mass, b_stiff, mass_diag);
+  return new CSRLeapfrogOperator(_global_mass_mat, _global_stiff_mat, a_mass, a_stiff, b_mass, b_stiff, mass_diag);
+}
+
+
+
+void Acoustic2D::apply_leapfrog(const LeapfrogOperator &leapfrog, const Function &function, Vec source_load,
+                                const DoFHandler &dof_handler, double time, Vec u1, Vec u2, Vec y) const
+{
+  const double dt = _param->TIME_STEP;
+  if (source_load != NULL) // the source load vector is scaled inside the same sweep
+  {
+    const SeparableFunction &separable = dynamic_cast<const SeparableFunction&>(function);
+    leapfrog.apply(u1, u2, dt*dt * separable.time_value(time), source_load, y);
+  }
+  else // the rhs vector is assembled first
+  {
+    rhs_vector(function, NULL, dof_handler, time, y);
+    leapfrog.apply(u1, u2, dt*dt, y, y);
+  }
+}
+
+
+
+void Acoustic2D::dirichlet_system_matrix(const std::vector<int> &b_nodes, Mat *system_mat) const
+{
+  if (_param->SYMMETRIC_STORAGE)
+  {
+    // the columns of the boundary nodes are zeroed once, and the rhs vectors of the time steps
+    // are not corrected, so it's right only if the boundary values are zero
+    const BoundaryFunction boundary_function;
+    const std::vector<int> &b_vertices = _fmesh.boundary_vertices();
+    bool zero_boundary = true;
+    for (unsigned int step = 0; step <= _param->N_TIME_STEPS && zero_boundary; ++step)
+    {
+      const double time = _param->TIME_BEG + step * _param->TIME_STEP;
+      for (unsigned int i = 0; i < b_vertices.size() && zero_boundary; ++i)
+        zero_boundary = (boundary_function.value(_fmesh.vertex(b_vertices[i]), time) == 0.);
+    }
+    require(zero_boundary, "The symmetric storage of the system matrix requires zero Dirichlet boundary values");
+  }
+
+  dirichlet_matrix(b_nodes, _param->SYMMETRIC_STORAGE, system_mat);
+}
+
+
+
+void Acoustic2D::dirichlet_matrix(const std::vector<int> &b_nodes, bool symmetric_storage, Mat *system_mat)
+{
+  const PetscInt *rows = (b_nodes.empty() ? NULL : &b_nodes[0]);
+  if (!symmetric_storage)
+  {
+    MatZeroRows(*system_mat, b_nodes.size(), rows, 1., NULL, NULL);
+    return;
+  }
+
+  // the columns are zeroed as well to keep the matrix symmetric.
+  // it doesn't change the solution, because the boundary values are zero
+  MatZeroRowsColumns(*system_mat, b_nodes.size(), rows, 1., NULL, NULL);
+
+  // only the upper triangular part is kept. PETSc converts the matrix
+  // to the symmetric format only if it's marked as symmetric
+  MatSetOption(*system_mat, MAT_SYMMETRIC, PETSC_TRUE);
+  Mat sym_mat;
+  MatConvert(*system_mat, MATSEQSBAIJ, MAT_INITIAL_MATRIX, &sym_mat);
+  MatDestroy(system_mat);
+  *system_mat = sym_mat;
+}
+
+
+
+bool Acoustic2D::output_step(unsigned int time_step) const
+{
+  return vtk_step(time_step) || sol_step(time_step);
+}
+
+
+
+bool Acoustic2D::vtk_step(unsigned int time_step) const
+{
+  return (_param->PRINT_VTU && (time_step % _param->VTU_STEP == 0)) ||
+         time_step == _param->N_TIME_STEPS; // the last step is always saved
+}
+
+
+
+bool Acoustic2D::sol_step(unsigned int time_step) const
+{
+  return (_param->SAVE_SOL && (time_step % _param->SOL_STEP == 0)) ||
+         time_step == _param->N_TIME_STEPS; // the last step is always saved
+}
+
+
+
+void Acoustic2D::save_results(const DoFHandler &dof_handler, unsigned int time_step, Vec solution) const
+{
+  if (!output_step(time_step))
+    return;
+
+  if (_output == NULL)
+  {
+    write_results(dof_handler, time_step, natural_order(solution)); // the output is in the original numbering of the dofs
+    return;
+  }
+
+  // fem::Result writes the vectors by PETSc, which is not thread-safe, so its files are written here
+  if (_vtk_series == NULL && vtk_step(time_step))
+    write_result_files(dof_handler, time_step, natural_order(solution));
+
+  // the snapshot in the original numbering of the dofs is written by the I/O threads
+  double *snapshot = _output->acquire();
+  const double *values;
+  VecGetArrayRead(solution, &values);
+  for (unsigned int d = 0; d < dof_handler.n_dofs(); ++d)
+    snapshot[d] = values[_renumbering.new_dof(d)];
+  VecRestoreArrayRead(solution, &values);
+  _output->submit(time_step);
+}
+
+
+
+void Acoustic2D::write_results(const DoFHandler &dof_handler, unsigned int time_step, Vec solution) const
+{
+  if (_vtk_series == NULL && vtk_step(time_step))
+    write_result_files(dof_handler, time_step, solution);
+
+  const double *values;
+  VecGetArrayRead(solution, &values);
+  write_snapshot(time_step, values, dof_handler.n_dofs());
+  VecRestoreArrayRead(solution, &values);
+}
+
+
+
+void Acoustic2D::write_result_files(const DoFHandler &dof_handler, unsigned int time_step, Vec solution) const
+{
+  const bool coefficients = (time_step == _param->N_TIME_STEPS && _param->EXPORT_COEFFICIENTS); // only for the last step
+  Result res(&dof_handler);
+  if (_partition != NULL) // the strip of a distributed run
+  {
+    if (_window != NULL) // the strip has no cells of the window
+      return;
+    const std::string fname = _param->VTU_DIR + "/res-" + d2s(time_step) + "-p" + d2s(_partition->rank()) + ".vts";
+    if (coefficients)
+      res.write_vts(fname, _param->N_FINE_X, _partition->n_cell_rows(), solution, NULL, _coef_alpha, _coef_beta);
+    else
+      res.write_vts(fname, _param->N_FINE_X, _partition->n_cell_rows(), solution);
+  }
+  else if (_fmesh.n_rectangles() > 0) // rectangular grid
+  {
+    std::string fname = _param->VTU_DIR + "/res-" + d2s(time_step) + ".vts";
+    if (coefficients)
+      res.write_vts(fname, _param->N_FINE_X, _param->N_FINE_Y, solution, NULL, _coef_alpha, _coef_beta);
+    else
+      res.write_vts(fname, _param->N_FINE_X, _param->N_FINE_Y, solution);
+  }
+  else // triangular mesh
+  {
+    std::string fname = _param->VTU_DIR + "/res-" + d2s(time_step) + ".vtu";
+    res.write_vtu(fname, solution);
+  }
+}
+
+
+
+void Acoustic2D::write_snapshot(unsigned int time_step, const double *values, unsigned int n_values) const
+{
+  if (_vtk_series != NULL && vtk_step(time_step)) // the geometry and the coefficients are already written
+    write_vtk_step(time_step, values);
+
+  if (!sol_step(time_step))
+    return;
+  if (_partition != NULL) // the owned values of the strip only
+    write_solution(time_step, values, _partition->owned_beg(), _partition->n_owned_dofs(),
+                   _param->SOL_DIR + "/sol-" + d2s(time_step) + "-p" + d2s(_partition->rank()) + ".dat");
+  else
+    write_solution(time_step, values, 0, n_values, _param->SOL_DIR + "/sol-" + d2s(time_step) + ".dat");
+}
+
+
+
+void Acoustic2D::write_solution(unsigned int time_step, const double *values, unsigned int first, unsigned int n,
+                                const std::string &fname) const
+{
+  // the values are written directly from the array unless they are in the window
+  const double *sol_values = values + first;
+  std::vector<double> window_values;
+  if (_window != NULL)
+  {
+    OutputWindow::gather(values, _sol_vertices, window_values);
+    sol_values = (window_values.empty() ? NULL : &window_values[0]);
+    n = window_values.size();
+  }
+
+  if (_sol_writer != NULL) // the snapshot is appended to the binary file
+    _sol_writer->append(time_step, _param->TIME_BEG + time_step * _param->TIME_STEP, sol_values);
+  else
+  {
+    std::ofstream out(fname.c_str());
+    require(out, "File " + fname + " can't be opened");
+    out.setf(std::ios::scientific);
+    out.precision(16);
+    for (unsigned int i = 0; i < n; ++i)
+      out << sol_values[i] << "\n";
+    out.close();
+  }
+}
+
+
+
+void Acoustic2D::write_vtk_step(unsigned int time_step, const double *values) const
+{
+  const double time = _param->TIME_BEG + time_step * _param->TIME_STEP;
+  if (_window == NULL)
+  {
+    _vtk_series->write_step(time_step, time, values + _vtk_shift);
+    return;
+  }
+
+  std::vector<double> window_values;
+  OutputWindow::gather(values, _vtk_vertices, window_values);
+  _vtk_series->write_step(time_step, time, &window_values[0]);
+}
+
+
+
+void Acoustic2D::start_output(unsigned int n_values, const AsyncWriter::WriteFunction &write)
+{
+  finish_output();
+  if (_param->IO_THREADS > 0)
+    _output = new AsyncWriter(n_values, _param->IO_BUFFERS, _param->IO_THREADS, write);
+}
+
+
+
+void Acoustic2D::finish_output()
+{
+  if (_output != NULL)
+    _output->flush(); // the failures of the I/O threads are rethrown here
+  delete _output;
+  _output = NULL;
+
+  if (_sol_writer != NULL)
+    _sol_writer->close(); // all snapshots are already appended
+  delete _sol_writer;
+  _sol_writer = NULL;
+
+  if (_vtk_series != NULL)
+    _vtk_series->close(); // the index of all written time steps
+  delete _vtk_series;
+  _vtk_series = NULL;
+
+  if (_receivers != NULL)
+    write_receivers(); // the traces of all time steps
+  delete _receivers;
+  _receivers = NULL;
+}
+
+
+
+void Acoustic2D::open_solution_file(unsigned int n_values, int piece)
+{
+  const bool rect_grid = (_fmesh.n_rectangles() > 0);
+  unsigned int nx = (rect_grid ? _param->N_FINE_X : 0);
+  unsigned int ny = (rect_grid ? _param->N_FINE_Y : 0);
+  if (_window != NULL) // the owned rows of the window
+  {
+    if (_partition != NULL)
+      _sol_vertices = _window->vertices(_partition->row_beg(), _partition->row_end(), _partition->cell_row_beg());
+    else
+      _sol_vertices = _window->vertices(0, _param->N_FINE_Y + 1, 0);
+    n_values = _sol_vertices.size();
+    nx = _window->n_cols() - 1;
+    ny = _window->n_rows() - 1;
+  }
+
+  if (!_param->SAVE_SOL || _param->SOL_FORMAT == TEXT_SOLUTION)
+    return;
+
+  delete _sol_writer;
+  const std::string fname = _param->SOL_DIR + "/sol" + (piece >= 0 ? "-p" + d2s(piece) : "") + ".bin";
+  _sol_writer = new SolutionWriter(fname, n_values,
+                                   (_param->SOL_FORMAT == BINARY_FLOAT_SOLUTION ? SolutionFile::FLOAT32 : SolutionFile::FLOAT64),
+                                   nx, ny, piece);
+}
+
+
+
+void Acoustic2D::open_vtk_series(unsigned int cell_row_beg, unsigned int cell_row_end, unsigned int first_vrow, int piece)
+{
+  if ((!_param->VTK_BINARY && _window == NULL) || _fmesh.n_rectangles() == 0)
+    return;
+
+  delete _vtk_series;
+  _vtk_series = NULL;
+  if (cell_row_end <= cell_row_beg) // the strip owns no cells
+    return;
+  const std::string name = "res" + (piece >= 0 ? "-p" + d2s(piece) : std::string());
+  if (_window == NULL)
+  {
+    const double hx = (_param->X_END - _param->X_BEG) / _param->N_FINE_X;
+    const double hy = (_param->Y_END - _param->Y_BEG) / _param->N_FINE_Y;
+    _vtk_series = new VTKSeries(_param->VTU_DIR, name, _param->X_BEG, _param->Y_BEG, hx, hy,
+                                _param->N_FINE_X, cell_row_beg, cell_row_end);
+    _vtk_shift = (cell_row_beg - first_vrow) * (_param->N_FINE_X + 1);
+    if (_param->EXPORT_COEFFICIENTS)
+    {
+      const unsigned int cell_beg = (cell_row_beg - first_vrow) * _param->N_FINE_X;
+      const unsigned int cell_end = (cell_row_end - first_vrow) * _param->N_FINE_X;
+      _vtk_series->write_coefficients(std::vector<double>(_coef_alpha.begin() + cell_beg, _coef_alpha.begin() + cell_end),
+                                      std::vector<double>(_coef_beta.begin() + cell_beg, _coef_beta.begin() + cell_end));
+    }
+    return;
+  }
+
+  // the rows of the window in the cells (including the rows shared with the neighbours,
+  // so the pieces are joined, while there is no stride). the strip without cells of the window writes nothing
+  require(piece < 0 || _window->stride() == 1, "The pieces of the strips are not joined with the stride of the output");
+  unsigned int first, n;
+  _window->select_rows(cell_row_beg, cell_row_end + 1, first, n);
+  if (n < 2)
+    return;
+  _vtk_vertices = _window->vertices(cell_row_beg, cell_row_end + 1, first_vrow);
+  _vtk_series = new VTKSeries(_param->VTU_DIR, name, _window->x_beg(), _window->y_beg(), _window->hx(), _window->hy(),
+                              _window->n_cols() - 1, first, first + n - 1);
+  if (_param->EXPORT_COEFFICIENTS) // the coefficients of the cells at the corners of the coarse cells
+  {
+    const std::vector<unsigned int> cells = _window->cells(cell_row_beg, cell_row_end + 1, first_vrow);
+    std::vector<double> alpha, beta;
+    OutputWindow::gather(&_coef_alpha[0], cells, alpha);
+    OutputWindow::gather(&_coef_beta[0], cells, beta);
+    _vtk_series->write_coefficients(alpha, beta);
+  }
+}
+
+
+
+void Acoustic2D::setup_receivers(unsigned int first_dof, unsigned int n_owned_dofs)
+{
+  delete _receivers;
+  _receivers = NULL;
+  if (_param->RECEIVERS_FILE == "" && _param->RECEIVER_LINES == "")
+    return;
+
+  std::vector<Point> points;
+  if (_param->RECEIVERS_FILE != "")
+    points = Receivers::read(_param->RECEIVERS_FILE);
+  const std::vector<Point> line_points = Receivers::lines(_param->RECEIVER_LINES);
+  points.insert(points.end(), line_points.begin(), line_points.end());
+
+  _receivers = new Receivers(points);
+  if (_fmesh.n_rectangles() > 0) // the mesh of a distributed run is only a strip of the grid
+    _receivers->locate_in_grid(_param->X_BEG, _param->X_END, _param->Y_BEG, _param->Y_END,
+                               _param->N_FINE_X, _param->N_FINE_Y);
+  else // the triangular mesh is the whole mesh in a distributed run as well
+    _receivers->locate_in_mesh(_fmesh.vertices(), _fmesh.triangles());
+  _receivers->distribute(_renumbering, first_dof, n_owned_dofs);
+}
+
+
+
+void Acoustic2D::record_receivers(Vec solution) const
+{
+  if (_receivers != NULL)
+    _receivers->record(solution);
+}
+
+
+
+void Acoustic2D::write_receivers() const
+{
+  int rank = 0;
+  if (_partition != NULL || _mesh_partition != NULL) // each process has its part of the weighted sums
+  {
+    MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+    std::vector<double> &samples = _receivers->samples();
+    if (!samples.empty())
+      MPI_Reduce((rank == 0 ? MPI_IN_PLACE : &samples[0]), &samples[0], samples.size(),
+                 MPI_DOUBLE, MPI_SUM, 0, PETSC_COMM_WORLD);
+  }
+  if (rank == 0)
+    _receivers->write_segy(_param->SEISMOGRAM_FILE, _param->TIME_STEP, _param->TIME_BEG);
+}
+
+
+
+void Acoustic2D::setup_output_window()
+{
+  delete _window;
+  _window = new OutputWindow(_param->X_BEG, _param->X_END, _param->Y_BEG, _param->Y_END,
+                             _param->N_FINE_X, _param->N_FINE_Y,
+                             _param->OUT_X_BEG, _param->OUT_X_END, _param->OUT_Y_BEG, _param->OUT_Y_END,
+                             _param->OUT_STRIDE);
+  if (_window->whole_grid()) // everything is saved as before
+  {
+    delete _window;
+    _window = NULL;
+  }
+}
+
+
+
+void Acoustic2D::save_mesh_solution(const DoFHandler &dof_handler, Vec solution) const
+{
+  // extract data from PETSc vector
+  std::vector<int> idx(dof_handler.n_dofs());
+  std::iota(idx.begin(), idx.end(), 0); // idx = { 0, 1, 2, 3, .... }
+  std::vector<double> solution_values(dof_handler.n_dofs());
+  VecGetValues(natural_order(solution), dof_handler.n_dofs(), &idx[0], &solution_values[0]);
+  const std::string sol_filename = stem(_param->MESH_FILE) + "_sol.dat";
+  std::ofstream out(sol_filename.c_str());
+  require(out, "File " + sol_filename + " can't be opened");
+  out.setf(std::ios_base::scientific);
+  out.precision(14);
+  out << solution_values.size() << "\n";
+  for (unsigned i = 0; i < solution_values.size(); ++i)
+    out << solution_values[i] << "\n";
+  out.close();
+}
+
+
+
+void Acoustic2D::lumped_mass_diagonal(const std::vector<int> &b_nodes, Vec mass_diag) const
+{
+  // for the first order basis functions the row-sum lumping is the same as
+  // the lumping based on the nodal quadrature, and all entries are positive
+  if (_stencil != NULL)
+  {
+    double *diag;
+    VecGetArray(mass_diag, &diag);
+    _stencil->mass_row_sums(diag);
+    VecRestoreArray(mass_diag, &diag);
+  }
+  else
+    MatGetRowSum(_global_mass_mat, mass_diag);
+
+  // impose Dirichlet boundary condition
+  // with ones on diagonal
+  for (unsigned int i = 0; i < b_nodes.size(); ++i)
+    VecSetValue(mass_diag, b_nodes[i], 1., INSERT_VALUES);
+  VecAssemblyBegin(mass_diag);
+  VecAssemblyEnd(mass_diag);
+}
+
+
+
+void Acoustic2D::domain_limits(Point &min_point, Point &max_point) const
+{
+  if (_partition == NULL)
+  {
+    min_point = _fmesh.min_coord();
+    max_point = _fmesh.max_coord();
+  }
+  else // the mesh is a strip of the grid
+  {
+    min_point = Point(_param->X_BEG, _param->Y_BEG);
+    max_point = Point(_param->X_END, _param->Y_END);
+  }
 }
 
 
@@ -346,10 +1306,14 @@ void Acoustic2D::coefficients_initialization()
   _coef_alpha.resize(cells.size(), 0); // coefficient alpha in each cell is 0 by default
   _coef_beta.resize(cells.size(),  0); // coefficient beta in each cell is 0 by default
 
+  // the limits of the whole domain (the mesh is only a strip of it in a distributed run)
+  Point min_point, max_point;
+  domain_limits(min_point, max_point);
+
   // since the layers are distributed horisontally (or nearly horisontally) in most cases
   // the thickness of the layer is associated with the vertical axis
   // and expressed in percents according to the height (depth) of the domain
-  const double Hy = _fmesh.max_coord().coord(1) - _fmesh.min_coord().coord(1);
+  const double Hy = max_point.coord(1) - min_point.coord(1);
 
   // general structure of the layers file is the following:
   // M                        (M - number of blocks with different layers distribution (different angle, or amount, for example))
@@ -388,17 +1352,17 @@ void Acoustic2D::coefficients_initialization()
     std::vector<double> layer_coef_alpha(n_layers); // the coefficients alpha in each layer
     std::vector<double> layer_coef_beta(n_layers); // the coefficients beta in each layer
 
-    const double x0 = _fmesh.min_coord().coord(0);
-    const double x1 = _fmesh.max_coord().coord(0);
+    const double x0 = min_point.coord(0);
+    const double x1 = max_point.coord(0);
     double y0, y1;
     if (fabs(block_beg[bl]) < math::FLOAT_NUMBERS_EQUALITY_TOLERANCE) // block_beg is 0
-      y0 = _fmesh.min_coord().coord(1);
+      y0 = min_point.coord(1);
     else
-      y0 = _fmesh.min_coord().coord(1) + 0.01 * block_beg[bl] * Hy;
+      y0 = min_point.coord(1) + 0.01 * block_beg[bl] * Hy;
     if (fabs(block_end[bl] - 100.) < math::FLOAT_NUMBERS_EQUALITY_TOLERANCE) // block_end is 100
-      y1 = _fmesh.max_coord().coord(1);
+      y1 = max_point.coord(1);
     else
-      y1 = _fmesh.min_coord().coord(1) + 0.01 * block_end[bl] * Hy;
+      y1 = min_point.coord(1) + 0.01 * block_end[bl] * Hy;
 
     // block limits
     const Point min_block_point(x0, y0);
@@ -433,73 +1397,107 @@ void Acoustic2D::coefficients_initialization()
   require(fabs(total_block_h - 100.) < math::FLOAT_NUMBERS_EQUALITY_TOLERANCE,
           "The blocks either intersect each other or don't fill up the whole domain");
 
-  // distribute the coefficients in each cell according to the layers
-  for (unsigned int i = 0; i < cells.size(); ++i)
+  // if we use averaged coefficients on a part of a domain,
+  // we average the coefficients alpha and beta on those layers that occupy less than 10% of the domain.
+  // averaged coefficients can be different for each block, and the blocks with 1 layer are not averaged
+  const double thickness_limit = 10; // in percent
+  std::vector<std::vector<bool> > averaged_layer(n_blocks);
+  for (unsigned int j = 0; j < n_blocks; ++j)
+  {
+    averaged_layer[j].resize(blocks[j].n_layers(), false);
+    if (_param->USE_AVERAGED && blocks[j].n_layers() > 1)
+    {
+      for (unsigned int l = 0; l < blocks[j].n_layers(); ++l)
+      {
+        const double relative_thickness = blocks[j].layer(l).thickness() / Hy * 100; // the thickness of the layer in respect with the height of the whole domain in percent
+        averaged_layer[j][l] = (relative_thickness < thickness_limit);
+      }
+    }
+  }
+
+  // the sums for harmonic averages of the coefficients in each block
+  std::vector<double> aver_alpha(n_blocks, 0.);
+  std::vector<double> aver_beta(n_blocks, 0.);
+  std::vector<double> total_mes(n_blocks, 0.); // the sum of the measures of all cells which coefficients we average
+
+  // the block and the layer containing each cell (-1 for the cells out of all blocks or layers)
+  std::vector<int> cell_block(cells.size(), -1);
+  std::vector<int> cell_layer(cells.size(), -1);
+
+  // find the layer of each cell. the center of the cell is computed once, and the layer
+  // is found by binary search. the cells are independent, so they are searched by several threads.
+  // nothing may be thrown inside the parallel region, so the lookup doesn't throw,
+  // and the cells which are not found are reported after the region
+  const int n_cells = cells.size();
+#if defined(_OPENMP)
+  const unsigned int n_threads = (_param->N_THREADS > 0 ? _param->N_THREADS : omp_get_max_threads());
+  #pragma omp parallel for schedule(static) num_threads(n_threads)
+#endif
+  for (int i = 0; i < n_cells; ++i)
   {
-    bool coef_found = false;
-    for (unsigned int j = 0; j < n_blocks && coef_found == false; ++j)
+    const Point center = cell_center(cells[i], _fmesh.vertices());
+    for (unsigned int j = 0; j < n_blocks && cell_block[i] < 0; ++j)
     {
-      if (blocks[j].contains_element(cells[i], _fmesh.vertices()))
+      if (blocks[j].contains_point(center))
       {
-        blocks[j].get_coefs(cells[i], _fmesh.vertices(),
-                            _coef_alpha[i], _coef_beta[i]);
-        coef_found = true;
+        cell_block[i] = j;
+        cell_layer[i] = blocks[j].find_layer(center);
       }
     }
-    require(coef_found, "The cell number " + d2s(i) + " doesn't belong to any block");
+  }
+
+  // distribute the coefficients in each cell according to the layers
+  for (unsigned int i = 0; i < cells.size(); ++i)
+  {
+    require(cell_block[i] >= 0, "The cell number " + d2s(i) + " doesn't belong to any block");
+    require(cell_layer[i] >= 0, "The cell number " + d2s(i) + " cannot be found in layers");
+    _coef_alpha[i] = blocks[cell_block[i]].coef_alpha(cell_layer[i]);
+    _coef_beta[i]  = blocks[cell_block[i]].coef_beta(cell_layer[i]);
+  }
+
+  // the sums for averaging are accumulated in the order of the cells,
+  // so the averages don't depend on the number of threads.
+  // in a distributed run each cell is counted by one process only
+  for (unsigned int i = 0; i < cells.size(); ++i)
+  {
+    if (averaged_layer[cell_block[i]][cell_layer[i]] && (_partition == NULL || _partition->owns_cell(i)))
+    {
+      const unsigned int j = cell_block[i];
+      const double cell_mes = cells[i].mes(); // the measure (area, volume) of the cell
+      aver_alpha[j] += cell_mes / _coef_alpha[i];
+      aver_beta[j]  += cell_mes / _coef_beta[i];
+      total_mes[j]  += cell_mes;
+    }
   }
 
   if (_param->USE_AVERAGED) // if we use averaged coefficient on a part of a domain
   {
-    const double Hy = _fmesh.max_coord().coord(1) - _fmesh.min_coord().coord(1); // the height (depth) of the domain
-    const double thickness_limit = 10;
+    if (_partition != NULL) // the sums over the strips of all processes
+    {
+      MPI_Allreduce(MPI_IN_PLACE, &aver_alpha[0], n_blocks, MPI_DOUBLE, MPI_SUM, PETSC_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE, &aver_beta[0], n_blocks, MPI_DOUBLE, MPI_SUM, PETSC_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE, &total_mes[0], n_blocks, MPI_DOUBLE, MPI_SUM, PETSC_COMM_WORLD);
+    }
 
-    // we average the coefficients alpha and beta on those parts that occupy less than 10% of the domain
     for (unsigned int j = 0; j < n_blocks; ++j)
     {
-      // averaged coefficients can be different for each block
-      double aver_alpha = 0;
-      double aver_beta  = 0;
-      double total_mes  = 0; // the sum of the thicknesses of all layers which coefficients we average
-
-      if (blocks[j].n_layers() > 1)
+      if (total_mes[j] > 0)
       {
-        for (unsigned int i = 0; i < cells.size(); ++i)
-        {
-          if (blocks[j].contains_element(cells[i], _fmesh.vertices()))
-          {
-            const Layer &layer = blocks[j].layer_which_contains(cells[i], _fmesh.vertices()); // find the layer which contains the cell
-            const double relative_thickness = layer.thickness() / Hy * 100; // the thickness of the layer in respect with the height of the whole domain in percent
-            if (relative_thickness < thickness_limit) // if the relative thickness is less than this number of percent we average the coefficient, otherwise we don't
-            {
-              const double cell_mes = cells[i].mes(); // the measure (area, volume) of the cell
-              aver_alpha += cell_mes / _coef_alpha[i];
-              aver_beta  += cell_mes / _coef_beta[i];
-              total_mes  += cell_mes;
-              _coef_alpha[i] = -1; // we do that to know the coefficients in which cells will have to be renewed
-              _coef_beta[i]  = -1;
-            }
-          }
-        } // for each cell
-
-        aver_alpha /= total_mes;
-        aver_beta  /= total_mes;
-
-        aver_alpha = 1. / aver_alpha;
-        aver_beta  = 1. / aver_beta;
-
-        // now we distribute averaged coefficients for all cells which were changed
-        for (unsigned int i = 0; i < cells.size(); ++i)
-        {
-          if (fabs(_coef_alpha[i] + 1) < math::FLOAT_NUMBERS_EQUALITY_TOLERANCE)
-          {
-            _coef_alpha[i] = aver_alpha;
-            _coef_beta[i]  = aver_beta;
-          }
-        }
+        aver_alpha[j] = 1. / (aver_alpha[j] / total_mes[j]);
+        aver_beta[j]  = 1. / (aver_beta[j] / total_mes[j]);
+      }
+    }
 
-      } // if a block has more than 1 layer
-    } // for each block
+    // now we distribute averaged coefficients for all cells of the thin layers
+    for (unsigned int i = 0; i < cells.size(); ++i)
+    {
+      const unsigned int j = cell_block[i];
+      if (averaged_layer[j][cell_layer[i]])
+      {
+        _coef_alpha[i] = aver_alpha[j];
+        _coef_beta[i]  = aver_beta[j];
+      }
+    }
   } // if we use averaged coefficients
 }
 
@@ -825,6 +1823,12 @@ void Acoustic2D::export_coefficients_per_vertex(const std::string &filename) con
     }
   }
 
+  if (_param->COEF_BINARY)
+  {
+    CoefficientsFile::write(filename, CoefficientsFile::PER_VERTEX, nx, ny, coeff_a_vert, coeff_b_vert);
+    return;
+  }
+
   std::ofstream out(filename.c_str());
   require(out, "File " + filename + " cannot be opened");
   out.setf(std::ios::scientific);
@@ -850,6 +1854,12 @@ void Acoustic2D::export_coefficients_per_cell(const std::string &filename) const
   expect(_coef_alpha.size() == nx * ny, "The size of coef alpha vector is somehow incorrect");
   expect(_coef_beta.size()  == nx * ny, "The size of coef beta vector is somehow incorrect");
 
+  if (_param->COEF_BINARY)
+  {
+    CoefficientsFile::write(filename, CoefficientsFile::PER_CELL, nx, ny, _coef_alpha, _coef_beta);
+    return;
+  }
+
   std::ofstream out(filename.c_str());
   require(out, "File " + filename + " cannot be opened");
   out.setf(std::ios::scientific);
@@ -882,6 +1892,31 @@ void Acoustic2D::import_coefficients_per_vertex(const std::string &filename)
   // c1 = 1/4 * (c(v1) + c(v2) + c(v4) + c(v5))
   // etc.
 
+  if (CoefficientsFile::is_binary(filename)) // binary file is mapped into memory
+  {
+    const CoefficientsFile coef_file(filename);
+    require(coef_file.nx() == _param->N_FINE_X && coef_file.ny() == _param->N_FINE_Y,
+            "The grid of the coefficients file " + filename + " (" + d2s(coef_file.nx()) + " x " + d2s(coef_file.ny()) +
+            ") doesn't correspond to the current grid");
+    // in a distributed run only the rows of the strip are read. since the cells and the vertices
+    // of the strip are numbered row by row, the strip starts from some row of the file
+    const unsigned int first_row = (_partition == NULL ? 0 : _partition->cell_row_beg());
+    if (coef_file.layout() == CoefficientsFile::PER_CELL) // the coefficients are taken as they are
+    {
+      const uint64_t first = (uint64_t)first_row * _param->N_FINE_X;
+      _coef_alpha.assign(coef_file.alpha() + first, coef_file.alpha() + first + _fmesh.n_rectangles());
+      _coef_beta.assign(coef_file.beta() + first, coef_file.beta() + first + _fmesh.n_rectangles());
+    }
+    else
+    {
+      const uint64_t first = (uint64_t)first_row * (_param->N_FINE_X + 1);
+      coefficients_from_vertices(coef_file.alpha() + first, coef_file.beta() + first);
+    }
+    return;
+  }
+
+  require(_partition == NULL, "The coefficients are read from the binary files only in a distributed run");
+
   std::ifstream in(filename.c_str());
   require(in, "File " + filename + " cannot be opened");
 
@@ -898,9 +1933,16 @@ void Acoustic2D::import_coefficients_per_vertex(const std::string &filename)
 
   in.close();
 
+  coefficients_from_vertices(&coeff_a_vert[0], &coeff_b_vert[0]);
+}
+
+
+
+void Acoustic2D::coefficients_from_vertices(const double *coeff_a_vert, const double *coeff_b_vert)
+{
   // allocate the memory for cell-wise distributed coefficients
-  _coef_alpha.resize(_fmesh.n_rectangles(), 0); // initialized by 0
-  _coef_beta.resize(_fmesh.n_rectangles(), 0); // initialized by 0
+  _coef_alpha.assign(_fmesh.n_rectangles(), 0); // initialized by 0
+  _coef_beta.assign(_fmesh.n_rectangles(), 0); // initialized by 0
 
   // now we distribute the coefficients by cells
   for (unsigned int cell = 0; cell < _fmesh.n_rectangles(); ++cell)
@@ -916,3 +1958,140 @@ void Acoustic2D::import_coefficients_per_vertex(const std::string &filename)
     _coef_beta[cell] /= Rectangle::n_vertices;
   }
 }
+
+
+
+std::string Acoustic2D::coefficients_cache_file() const
+{
+  std::ifstream in(_param->LAYERS_FILE.c_str(), std::ios::binary);
+  require(in, "File " + _param->LAYERS_FILE + " cannot be opened");
+  const std::string layers((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+
+  Point min_point, max_point;
+  domain_limits(min_point, max_point);
+
+  // everything the distribution depends on besides the layers file
+  const double extents[] = { min_point.coord(0), max_point.coord(0),
+                             min_point.coord(1), max_point.coord(1) };
+  const uint32_t grid[] = { _param->N_FINE_X, _param->N_FINE_Y, _param->USE_AVERAGED, CoefficientsFile::VERSION };
+
+  uint64_t hash = CoefficientsFile::hash_bytes(layers.data(), layers.size());
+  hash = CoefficientsFile::hash_bytes(extents, sizeof(extents), hash);
+  hash = CoefficientsFile::hash_bytes(grid, sizeof(grid), hash);
+
+  std::ostringstream name;
+  name << _param->COEF_DIR << "/cache_" << std::hex << hash << ".bin";
+  return name.str();
+}
+
+
+
+void Acoustic2D::benchmark_operators(unsigned int n_runs) const
+{
+  const double dt = _param->TIME_STEP;
+
+  Vec u1, u2, f, y;
+  VecDuplicate(_global_rhs, &u1);
+  VecDuplicate(_global_rhs, &u2);
+  VecDuplicate(_global_rhs, &f);
+  VecDuplicate(_global_rhs, &y);
+  VecSet(u1, 1.);
+  VecSet(u2, 0.5);
+  VecSet(f, 0.25);
+
+  std::cout << "benchmark of the explicit scheme operator (" << n_runs << " runs):" << std::endl;
+  double aij_time = 0.; // the reference time per application
+
+  std::vector<std::pair<std::string, LeapfrogOperator*> > operators;
+  if (_stencil != NULL)
+    operators.push_back(std::make_pair(std::string("Q1 stencil"), (LeapfrogOperator*)new Q1LeapfrogOperator(*_stencil, 2., -dt*dt, -1., 0.)));
+  else
+  {
+    // the unfused operator as it's applied by PETSc: three products and three vector updates
+    Vec tmp;
+    VecDuplicate(_global_rhs, &tmp);
+    boost::timer::cpu_timer timer;
+    for (unsigned int run = 0; run < n_runs; ++run)
+    {
+      MatMult(_global_mass_mat, u1, y);
+      VecScale(y, 2.);
+      MatMult(_global_stiff_mat, u1, tmp);
+      VecAXPY(y, -dt*dt, tmp);
+      MatMult(_global_mass_mat, u2, tmp);
+      VecAXPY(y, -1., tmp);
+      VecAXPY(y, dt*dt, f);
+    }
+    aij_time = 1e-6 * timer.elapsed().wall / n_runs; // ms
+    std::cout << "  PETSc AIJ: " << aij_time << " ms" << std::endl;
+    VecDestroy(&tmp);
+
+    operators.push_back(std::make_pair(std::string("CSR"), (LeapfrogOperator*)new CSRLeapfrogOperator(_global_mass_mat, _global_stiff_mat, 2., -dt*dt, -1., 0.)));
+    operators.push_back(std::make_pair(std::string("symmetric CSR"), (LeapfrogOperator*)new SymmetricLeapfrogOperator(_global_mass_mat, _global_stiff_mat, 2., -dt*dt, -1., 0.)));
+    SellLeapfrogOperator *sell = new SellLeapfrogOperator(_global_mass_mat, _global_stiff_mat, 2., -dt*dt, -1., 0.);
+    operators.push_back(std::make_pair("SELL-" + d2s(SellLeapfrogOperator::CHUNK) + "-" + d2s(SellLeapfrogOperator::SIGMA) +
+                                       " (fill ratio " + d2s(sell->fill_ratio()) + ")", (LeapfrogOperator*)sell));
+  }
+
+  for (unsigned int i = 0; i < operators.size(); ++i)
+  {
+    boost::timer::cpu_timer timer;
+    for (unsigned int run = 0; run < n_runs; ++run)
+      operators[i].second->apply(u1, u2, dt*dt, f, y);
+    const double time = 1e-6 * timer.elapsed().wall / n_runs; // ms
+    std::cout << "  " << operators[i].first << ": " << time << " ms";
+    if (aij_time > 0.)
+      std::cout << " (speedup " << aij_time / time << ")";
+    std::cout << std::endl;
+    delete operators[i].second;
+  }
+
+#if defined(_OPENMP)
+  // strong scaling of the operator used in the threaded time loop
+  const LeapfrogOperator *leapfrog = leapfrog_operator(2., -dt*dt, -1., 0.);
+  if (leapfrog->partitioned())
+  {
+    const double *u1_val, *u2_val, *f_val;
+    double *y_val;
+    VecGetArrayRead(u1, &u1_val);
+    VecGetArrayRead(u2, &u2_val);
+    VecGetArrayRead(f, &f_val);
+    VecGetArray(y, &y_val);
+
+    const unsigned int max_threads = (_param->N_THREADS > 0 ? _param->N_THREADS : omp_get_max_threads());
+    double serial_time = 0.;
+    for (unsigned int n_threads = 1; ; n_threads = std::min(2 * n_threads, max_threads))
+    {
+      boost::timer::cpu_timer timer;
+      #pragma omp parallel num_threads(n_threads)
+      {
+        const unsigned int part = omp_get_thread_num();
+        const unsigned int n_parts = omp_get_num_threads();
+        for (unsigned int run = 0; run < n_runs; ++run)
+        {
+          leapfrog->apply_part(u1_val, u2_val, dt*dt, f_val, y_val, part, n_parts);
+          #pragma omp barrier
+        }
+      }
+      const double time = 1e-6 * timer.elapsed().wall / n_runs; // ms
+      if (n_threads == 1)
+        serial_time = time;
+      std::cout << "  " << n_threads << " thread(s): " << time << " ms (speedup " << serial_time / time
+                << ", efficiency " << serial_time / time / n_threads << ")" << std::endl;
+      if (n_threads == max_threads)
+        break;
+    }
+
+    VecRestoreArray(y, &y_val);
+    VecRestoreArrayRead(f, &f_val);
+    VecRestoreArrayRead(u2, &u2_val);
+    VecRestoreArrayRead(u1, &u1_val);
+  }
+  delete leapfrog;
+#endif
+
+  VecDestroy(&y);
+  VecDestroy(&f);
+  VecDestroy(&u2);
+  VecDestroy(&u1);
+}
@@ -0,0 +1,427 @@
+#include "acoustic2d.h"
+#include "parameters.h"
+#include "petscksp.h"
+#include "fem/auxiliary_functions.h"
+#include "fem/finite_element.h"
+#include "analytic_functions.h"
+#include "fem/result.h"
+#include "leapfrog_operator.h"
+#include "csr_assembler.h"
+#include "strip_partition.h"
+#include "mesh_partition.h"
+#include <iostream>
+#include <fstream>
+#include <array>
+#include <cstring>
+
+using namespace fem;
+
+
+void Acoustic2D::solve_rectangles_distributed()
+{
+  require(_param->FE_ORDER == 1, "This fe order is not implemented (" + d2s(_param->FE_ORDER) + ")");
+
+  int rank, n_ranks;
+  MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+  MPI_Comm_size(PETSC_COMM_WORLD, &n_ranks);
+
+  delete _partition;
+  _partition = new StripPartition(_param->N_FINE_X, _param->N_FINE_Y, rank, n_ranks);
+
+  // create only the strip of the rectangular grid. its vertices are numbered row by row,
+  // so the global dof of each vertex is its number plus the shift of the strip
+  const double hy = (_param->Y_END - _param->Y_BEG) / _param->N_FINE_Y;
+  const double y_beg = _param->Y_BEG + _partition->cell_row_beg() * hy;
+  const double y_end = (_partition->cell_row_end() == _param->N_FINE_Y ? _param->Y_END :
+                                                                         _param->Y_BEG + _partition->cell_row_end() * hy);
+  _fmesh.create_rectangular_grid(_param->X_BEG, _param->X_END, y_beg, y_end,
+                                 _param->N_FINE_X, _partition->n_cell_rows());
+  setup_output_window();
+
+  if (_param->PRINT_INFO)
+    std::cout << "rank " << rank << ": rows of vertices [" << _partition->row_beg() << ", " << _partition->row_end()
+              << "), rows of cells [" << _partition->cell_row_beg() << ", " << _partition->cell_row_end() << ")" << std::endl;
+
+  FiniteElement fe(_param->FE_ORDER);
+
+  DoFHandler dof_handler(&_fmesh);
+  dof_handler.distribute_dofs(fe, CG);
+  require(dof_handler.n_dofs() == _partition->n_local_vertices(), "The dofs of the strip don't correspond to its vertices");
+
+  // the distributed vectors have the values of the vertices of the strip owned by other processes as the ghosts
+  const std::vector<int> ghosts = _partition->ghost_dofs();
+  VecCreateGhost(PETSC_COMM_WORLD, _partition->n_owned_dofs(), _partition->n_dofs(),
+                 ghosts.size(), (ghosts.empty() ? NULL : &ghosts[0]), &_global_rhs);
+
+  // the coefficients of the cells of the strip only
+  setup_coefficients();
+
+  // the matrices of the strip are assembled by the threads of the process,
+  // and the rows of the owned vertices become the rows of the distributed matrices
+  CSRPattern csr_pattern;
+  csr_pattern.make_sparse_format(dof_handler, CG);
+  expect(csr_pattern.order() == dof_handler.n_dofs(), "Error");
+
+  delete _assembler;
+  _assembler = new CSRAssembler(csr_pattern);
+  _assembler->assemble(_fmesh.rectangles(), _fmesh.vertices(), &_coef_alpha[0], &_coef_beta[0], _param->N_THREADS);
+  _assembler->create_distributed_matrices(PETSC_COMM_WORLD, _partition->owned_beg(), _partition->owned_end(),
+                                          _partition->dof_shift(), _partition->n_dofs(),
+                                          &_global_mass_mat, &_global_stiff_mat);
+  delete _assembler; // the values are copied into the matrices
+  _assembler = NULL;
+
+  solve_explicit_distributed(dof_handler);
+}
+
+
+
+void Acoustic2D::distribute_triangles(const CSRPattern &csr_pattern, const double *coef_alpha, const double *coef_beta)
+{
+  int rank, n_ranks;
+  MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+  MPI_Comm_size(PETSC_COMM_WORLD, &n_ranks);
+
+  delete _mesh_partition;
+  _mesh_partition = new MeshPartition(_fmesh, csr_pattern, rank, n_ranks);
+
+  // the global matrices and vectors are indexed in the numbering of the partition,
+  // where the dofs of each process are a contiguous range
+  _renumbering = _mesh_partition->renumbering();
+
+  const unsigned int first_dof = _mesh_partition->first_dof();
+  const unsigned int n_owned_dofs = _mesh_partition->n_owned_dofs();
+  const std::vector<int> ghosts = _mesh_partition->ghost_dofs();
+
+  if (_param->PRINT_INFO)
+    std::cout << "rank " << rank << ": dofs [" << first_dof << ", " << first_dof + n_owned_dofs << ") of "
+              << _mesh_partition->n_dofs() << ", " << ghosts.size() << " ghosts, the cells are distributed by "
+              << (_mesh_partition->from_mesh_file() ? "the partitions of the mesh file" : "the graph partitioner") << std::endl;
+
+  VecCreateGhost(PETSC_COMM_WORLD, n_owned_dofs, _mesh_partition->n_dofs(),
+                 ghosts.size(), (ghosts.empty() ? NULL : &ghosts[0]), &_global_rhs);
+
+  // the own cells of the process and the layer of the ghost cells around them
+  const std::vector<Triangle> &cells = _fmesh.triangles();
+  std::vector<Triangle> local_cells;
+  std::vector<double> local_alpha, local_beta;
+  for (unsigned int cell = 0; cell < cells.size(); ++cell)
+  {
+    if (_mesh_partition->local_cell(cells[cell]))
+    {
+      local_cells.push_back(cells[cell]);
+      local_alpha.push_back(coef_alpha[cell]);
+      local_beta.push_back(coef_beta[cell]);
+    }
+  }
+  require(!local_cells.empty(), "There are no cells for the process " + d2s(rank));
+
+  // the rows of the owned dofs are complete after the assembling of the local cells,
+  // and they become the rows of the distributed matrices (the other rows are dropped)
+  CSRAssembler assembler(csr_pattern, _renumbering);
+  assembler.assemble(local_cells, _fmesh.vertices(), &local_alpha[0], &local_beta[0], _param->N_THREADS);
+  assembler.create_distributed_matrices(PETSC_COMM_WORLD, first_dof, first_dof + n_owned_dofs,
+                                        0, _mesh_partition->n_dofs(),
+                                        &_global_mass_mat, &_global_stiff_mat);
+}
+
+
+
+const DoFPartition& Acoustic2D::dof_partition() const
+{
+  require(_partition != NULL || _mesh_partition != NULL, "The problem is not distributed");
+  if (_partition != NULL)
+    return *_partition;
+  return *_mesh_partition;
+}
+
+
+
+void Acoustic2D::solve_explicit_distributed(const DoFHandler &dof_handler)
+{
+  require(_param->TIME_SCHEME == EXPLICIT, "Only the explicit scheme is implemented for a distributed run");
+
+  int rank;
+  MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+
+  const DoFPartition &partition = dof_partition();
+
+  // the duplicates of the ghosted vector are ghosted as well
+  Vec solution, solution_1, solution_2, system_rhs;
+  VecDuplicate(_global_rhs, &solution);
+  VecDuplicate(_global_rhs, &solution_1);
+  VecDuplicate(_global_rhs, &solution_2);
+  VecDuplicate(_global_rhs, &system_rhs);
+
+  // the output: each process writes its strip of the rectangular grid,
+  // while the solution on the triangular mesh is gathered by the first process
+  Vec strip_solution = NULL, gathered_solution = NULL;
+  VecScatter gather = NULL;
+  if (_partition != NULL)
+    VecCreateSeq(PETSC_COMM_SELF, dof_handler.n_dofs(), &strip_solution);
+  else
+  {
+    VecScatterCreateToZero(solution, &gather, &gathered_solution);
+    if (!_renumbering.natural() && _natural_vec == NULL)
+      VecDuplicate(gathered_solution, &_natural_vec);
+  }
+
+  // the results are written by the I/O threads (if any) while the time loop goes on.
+  // the strips are written by each process, the whole mesh is written by the first one
+  if (_partition != NULL)
+  {
+    start_output(dof_handler.n_dofs(), [this, &dof_handler](unsigned int time_step, const double *strip_values)
+                                       { write_snapshot(time_step, strip_values, dof_handler.n_dofs()); });
+    open_solution_file(_partition->owned_end() - _partition->owned_beg(), rank);
+    open_vtk_series(_partition->row_beg(), _partition->cell_row_end(), _partition->cell_row_beg(), rank); // the own cells
+  }
+  else if (rank == 0)
+  {
+    start_output(dof_handler.n_dofs(), [this, &dof_handler](unsigned int time_step, const double *values)
+                                       { write_snapshot(time_step, values, dof_handler.n_dofs()); });
+    open_solution_file(dof_handler.n_dofs());
+  }
+
+  const double dt = _param->TIME_STEP;
+
+  // fill vectors with solution on the 0-th and 1-st time steps (the owned dofs only)
+  const InitialSolution init_solution;
+  for (unsigned int d = 0; d < dof_handler.n_dofs(); ++d)
+  {
+    if (!partition.owns_dof(d))
+      continue;
+    VecSetValue(solution_2, partition.global_dof(d), init_solution.value(dof_handler.dof(d), _param->TIME_BEG), INSERT_VALUES);
+    VecSetValue(solution_1, partition.global_dof(d), init_solution.value(dof_handler.dof(d), _param->TIME_BEG + dt), INSERT_VALUES);
+  }
+  VecAssemblyBegin(solution_2);
+  VecAssemblyEnd(solution_2);
+  VecAssemblyBegin(solution_1);
+  VecAssemblyEnd(solution_1);
+
+  // each process records the values of its dofs at the receivers (see write_receivers)
+  setup_receivers(partition.first_dof(), partition.n_owned_dofs());
+  record_receivers(solution_2);
+  record_receivers(solution_1);
+
+  // the owned boundary nodes of the whole domain (the local dofs, and the corresponding global ones)
+  const std::vector<int> b_dofs = partition.boundary_dofs();
+  std::vector<int> b_nodes(b_dofs.size());
+  for (unsigned int i = 0; i < b_dofs.size(); ++i)
+    b_nodes[i] = partition.global_dof(b_dofs[i]);
+
+  Mat system_mat = NULL; // system matrix (in case of consistent mass matrix)
+  KSP ksp = NULL; // SLAE solver (in case of consistent mass matrix)
+  Vec mass_diag = NULL; // the diagonal of the lumped mass matrix
+
+  if (_param->MASS_LUMPING)
+  {
+    VecDuplicate(system_rhs, &mass_diag);
+    lumped_mass_diagonal(b_nodes, mass_diag);
+  }
+  else
+  {
+    // each process zeroes its own boundary rows
+    MatConvert(_global_mass_mat, MATSAME, MAT_INITIAL_MATRIX, &system_mat);
+    MatZeroRows(system_mat, b_nodes.size(), (b_nodes.empty() ? NULL : &b_nodes[0]), 1., NULL, NULL);
+
+    KSPCreate(PETSC_COMM_WORLD, &ksp);
+    KSPSetOperators(ksp, system_mat, system_mat, SAME_PRECONDITIONER);
+    KSPSetTolerances(ksp, 1e-12, 1e-30, 1e+5, 10000);
+  }
+
+  require(_param->N_TIME_STEPS > 1, "There is no time steps to perform: n_time_steps = " + d2s(_param->N_TIME_STEPS));
+
+  const RHSFunction rhs_function(*_param);
+  Vec source_load;
+  VecDuplicate(_global_rhs, &source_load);
+  assemble_distributed_load(rhs_function, dof_handler, source_load);
+
+  if (_param->PRINT_INFO && rank == 0)
+    std::cout << "time loop started..." << std::endl;
+
+  // the operator of the explicit scheme: (2M - dt^2 K) u^n - M u^{n-1}.
+  // in case of lumped mass matrix it also includes the division by the diagonal
+  const GhostedLeapfrogOperator leapfrog(_global_mass_mat, _global_stiff_mat, partition.ghost_dofs(),
+                                         2., -dt*dt, -1., 0., mass_diag);
+
+  // in case of lumped mass matrix the operator gives the solution itself,
+  // otherwise it gives the rhs vector of the SLAE with the mass matrix
+  Vec *step_vec = (_param->MASS_LUMPING ? &solution : &system_rhs);
+
+  const BoundaryFunction boundary_function;
+  for (unsigned int time_step = 2; time_step <= _param->N_TIME_STEPS; ++time_step)
+  {
+    const double time = _param->TIME_BEG + time_step * dt; // current time
+
+    // dt^2 F + (2M - dt^2 K) u^n - M u^{n-1} in one sweep,
+    // where F is the rhs function on the previous time step
+    leapfrog.apply(solution_1, solution_2, dt*dt * rhs_function.time_value(time - dt), source_load, *step_vec);
+
+    // impose Dirichlet boundary condition
+    for (unsigned int i = 0; i < b_nodes.size(); ++i)
+      VecSetValue(*step_vec, b_nodes[i], boundary_function.value(dof_handler.dof(b_dofs[i]), time), INSERT_VALUES);
+    VecAssemblyBegin(*step_vec);
+    VecAssemblyEnd(*step_vec);
+
+    // solve the SLAE (there is nothing to solve in case of lumped mass matrix)
+    if (!_param->MASS_LUMPING)
+      KSPSolve(ksp, system_rhs, solution);
+
+    record_receivers(solution);
+    if (_partition != NULL)
+      save_results_distributed(dof_handler, time_step, solution, strip_solution);
+    else
+      save_results_gathered(dof_handler, time_step, solution, gather, gathered_solution);
+
+    if (_param->PRINT_INFO)
+    {
+      double norm;
+      VecNorm(solution, NORM_2, &norm);
+      if (rank == 0)
+      {
+        std::cout.setf(std::ios::scientific);
+        std::cout.precision(4);
+        std::cout << "  step " << time_step << " norm " << norm << std::endl;
+      }
+    }
+
+    // reassign the solutions on the previuos time steps.
+    // the vectors are rotated, so nothing is copied
+    Vec solution_3 = solution_2;
+    solution_2 = solution_1;
+    solution_1 = solution;
+    solution = solution_3;
+  } // time loop
+
+  finish_output();
+
+  if (_partition == NULL) // the final solution on the triangular mesh is kept near the mesh file
+  {
+    VecScatterBegin(gather, solution_1, gathered_solution, INSERT_VALUES, SCATTER_FORWARD); // the last solution after the rotation
+    VecScatterEnd(gather, solution_1, gathered_solution, INSERT_VALUES, SCATTER_FORWARD);
+    if (rank == 0)
+      save_mesh_solution(dof_handler, gathered_solution);
+  }
+
+  KSPDestroy(&ksp);
+  MatDestroy(&system_mat);
+  VecDestroy(&mass_diag);
+
+  VecDestroy(&source_load);
+  VecDestroy(&strip_solution);
+  VecScatterDestroy(&gather);
+  VecDestroy(&gathered_solution);
+  VecDestroy(&solution);
+  VecDestroy(&solution_1);
+  VecDestroy(&solution_2);
+  VecDestroy(&system_rhs);
+}
+
+
+
+template <class Cell>
+void Acoustic2D::add_distributed_load(const std::vector<Cell> &cells, const std::vector<Point> &points,
+                                      const Function &function, Vec load) const
+{
+  const DoFPartition &partition = dof_partition();
+
+  std::array<double, Cell::n_dofs_first> local_rhs_vec;
+  for (unsigned int cell = 0; cell < cells.size(); ++cell)
+  {
+    bool local = false;
+    for (unsigned int i = 0; i < Cell::n_dofs_first; ++i)
+      local = local || partition.owns_dof(cells[cell].dof(i));
+    if (!local) // the cells of other processes
+      continue;
+
+    cells[cell].local_rhs_vector(function, points, 0., local_rhs_vec.data());
+    for (unsigned int i = 0; i < Cell::n_dofs_first; ++i)
+    {
+      const unsigned int dof = cells[cell].dof(i);
+      if (partition.owns_dof(dof)) // the other rows are added by their owners
+        VecSetValue(load, partition.global_dof(dof), local_rhs_vec[i], ADD_VALUES);
+    }
+  }
+}
+
+
+
+void Acoustic2D::assemble_distributed_load(const SeparableFunction &function, const DoFHandler &dof_handler, Vec load) const
+{
+  VecSet(load, 0.);
+
+  const SpatialPart spatial_part(function);
+  if (_fmesh.n_rectangles() > 0) // rectangular grid
+    add_distributed_load(_fmesh.rectangles(), dof_handler.dofs(), spatial_part, load);
+  else // triangular mesh
+    add_distributed_load(_fmesh.triangles(), _fmesh.vertices(), spatial_part, load);
+
+  VecAssemblyBegin(load);
+  VecAssemblyEnd(load);
+}
+
+
+
+void Acoustic2D::save_results_distributed(const DoFHandler &dof_handler, unsigned int time_step,
+                                          Vec solution, Vec strip_solution) const
+{
+  if (!output_step(time_step))
+    return;
+
+  // the ghost values are required for the whole strip
+  VecGhostUpdateBegin(solution, INSERT_VALUES, SCATTER_FORWARD);
+  VecGhostUpdateEnd(solution, INSERT_VALUES, SCATTER_FORWARD);
+
+  // the values of the strip are copied either into the snapshot for the I/O threads,
+  // or into the vector written right now
+  double *strip_val;
+  if (_output != NULL)
+    strip_val = _output->acquire();
+  else
+    VecGetArray(strip_solution, &strip_val);
+
+  Vec local_form;
+  VecGhostGetLocalForm(solution, &local_form);
+  const double *local_val;
+  VecGetArrayRead(local_form, &local_val);
+  for (unsigned int v = 0; v < _partition->n_local_vertices(); ++v)
+    strip_val[v] = local_val[_partition->local_form_index(v)];
+  VecRestoreArrayRead(local_form, &local_val);
+  VecGhostRestoreLocalForm(solution, &local_form);
+
+  if (_output != NULL)
+  {
+    // fem::Result writes the vectors by PETSc, which is not thread-safe, so its files are written here
+    if (_vtk_series == NULL && vtk_step(time_step))
+    {
+      double *val;
+      VecGetArray(strip_solution, &val);
+      memcpy(val, strip_val, _partition->n_local_vertices() * sizeof(double));
+      VecRestoreArray(strip_solution, &val);
+      write_result_files(dof_handler, time_step, strip_solution);
+    }
+    _output->submit(time_step);
+  }
+  else
+  {
+    VecRestoreArray(strip_solution, &strip_val);
+    write_results(dof_handler, time_step, strip_solution);
+  }
+}
+
+
+
+void Acoustic2D::save_results_gathered(const DoFHandler &dof_handler, unsigned int time_step,
+                                       Vec solution, VecScatter gather, Vec gathered_solution) const
+{
+  if (!output_step(time_step))
+    return;
+
+  VecScatterBegin(gather, solution, gathered_solution, INSERT_VALUES, SCATTER_FORWARD);
+  VecScatterEnd(gather, solution, gathered_solution, INSERT_VALUES, SCATTER_FORWARD);
+
+  int rank;
+  MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+  if (rank == 0)
+    save_results(dof_handler, time_step, gathered_solution);
+}
@@ -13,6 +13,23 @@ double AnalyticSolution::value(const Point &p, const double t) const
 }
 
 
+double SeparableFunction::value(const Point &p, const double t) const
+{
+  return spatial_value(p) * time_value(t);
+}
+
+
+SpatialPart::SpatialPart(const SeparableFunction &function)
+  : _function(function)
+{ }
+
+
+double SpatialPart::value(const Point &p, const double t) const
+{
+  return _function.spatial_value(p);
+}
+
+
 RHSFunction::RHSFunction(const Parameters &param)
   : h(param.SOURCE_SUPPORT), // some constant
     f(param.SOURCE_FREQUENCY), // frequency, Hz
@@ -29,15 +46,21 @@ RHSFunction::RHSFunction(const Parameters &param)
 }
 
 
-double RHSFunction::value(const Point &p, const double t) const
+double RHSFunction::spatial_value(const Point &p) const
 {
   const double x = p.coord(0);
   const double y = p.coord(1);
+  return 1./(h*h) * exp(-((x - xc)*(x - xc) + (y - yc)*(y - yc)) / (h*h));
+}
+
+
+double RHSFunction::time_value(const double t) const
+{
   const double pi = math::PI;
   const double part = pi*pi*f*f*(t - 2./f)*(t - 2./f);
-  const double val = 1./(h*h) * exp(-((x - xc)*(x - xc) + (y - yc)*(y - yc)) / (h*h)) * (1. - 2.*part) * exp(-part);
+  const double val = (1. - 2.*part) * exp(-part); // Ricker wavelet
 #if defined(DEBUG)
-  std::cout << p << ": rhs, part = " << part << " val = " << val << std::endl;
+  std::cout << "rhs, t = " << t << " part = " << part << " val = " << val << std::endl;
 #endif
   return val;
 }
@@ -0,0 +1,134 @@
+#include "async_writer.h"
+#include "fem/auxiliary_functions.h"
+#include <chrono>
+#include <exception>
+
+
+AsyncWriter::AsyncWriter(unsigned int n_values, unsigned int n_buffers, unsigned int n_threads, const WriteFunction &write)
+  : _buffers(n_buffers, std::vector<double>(n_values)),
+    _time_steps(n_buffers, 0),
+    _free(n_buffers),
+    _ready(n_buffers),
+    _acquired(-1),
+    _write(write)
+{
+  require(n_buffers > 0 && n_threads > 0, "The asynchronous output requires at least one buffer and one thread");
+
+  _n_pending.store(0);
+  _stop.store(false);
+  _failed.store(false);
+  _error_taken.store(false);
+
+  for (unsigned int b = 0; b < n_buffers; ++b)
+    _free.push(b);
+
+  for (unsigned int t = 0; t < n_threads; ++t)
+    _threads.push_back(std::thread(&AsyncWriter::io_loop, this));
+}
+
+
+
+AsyncWriter::~AsyncWriter()
+{
+  // the snapshots are written even if the writing has failed, so the failure is not rethrown here
+  while (_n_pending.load(std::memory_order_acquire) > 0 && !_failed.load(std::memory_order_acquire))
+    std::this_thread::yield();
+
+  _stop.store(true, std::memory_order_release);
+  for (unsigned int t = 0; t < _threads.size(); ++t)
+    _threads[t].join();
+}
+
+
+
+double* AsyncWriter::acquire()
+{
+  require(_acquired < 0, "The previous buffer hasn't been submitted");
+
+  // back-pressure: the time loop waits until one of the snapshots is written
+  unsigned int buffer;
+  while (!_free.pop(buffer))
+  {
+    check_failure();
+    std::this_thread::yield();
+  }
+  _acquired = buffer;
+  return (_buffers[buffer].empty() ? NULL : &_buffers[buffer][0]);
+}
+
+
+
+void AsyncWriter::submit(unsigned int time_step)
+{
+  require(_acquired >= 0, "There is no acquired buffer to submit");
+  check_failure();
+
+  _time_steps[_acquired] = time_step;
+  _n_pending.fetch_add(1, std::memory_order_release);
+  const bool pushed = _ready.push(_acquired); // there is always a place for all buffers
+  expect(pushed, "The queue of the snapshots is full");
+  _acquired = -1;
+}
+
+
+
+void AsyncWriter::flush()
+{
+  while (_n_pending.load(std::memory_order_acquire) > 0)
+  {
+    check_failure();
+    std::this_thread::yield();
+  }
+  check_failure();
+}
+
+
+
+void AsyncWriter::io_loop()
+{
+  while (true)
+  {
+    unsigned int buffer;
+    if (_ready.pop(buffer))
+    {
+      try
+      {
+        _write(_time_steps[buffer], (_buffers[buffer].empty() ? NULL : &_buffers[buffer][0]));
+      }
+      catch (const std::exception &e)
+      {
+        set_failure(e.what());
+      }
+      catch (...)
+      {
+        set_failure("unknown error of the I/O thread");
+      }
+      _free.push(buffer);
+      _n_pending.fetch_sub(1, std::memory_order_release);
+    }
+    else if (_stop.load(std::memory_order_acquire))
+      break;
+    else // there is nothing to write, and the thread sleeps a bit instead of spinning
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+
+
+void AsyncWriter::set_failure(const std::string &error)
+{
+  bool expected = false;
+  if (_error_taken.compare_exchange_strong(expected, true)) // only the first failure is kept
+  {
+    _error = error;
+    _failed.store(true, std::memory_order_release);
+  }
+}
+
+
+
+void AsyncWriter::check_failure() const
+{
+  if (_failed.load(std::memory_order_acquire))
+    require(false, "The output has failed: " + _error);
+}
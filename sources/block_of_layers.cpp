@@ -23,9 +23,21 @@ void BlockOfLayers::init(const fem::Point &min_point, const fem::Point &max_poin
   _layers_coef_alpha = layers_coef_alpha;
   _layers_coef_beta = layers_coef_beta;
 
+  const double Hy = _max_point.coord(1) - _min_point.coord(1); // the length (y-direction) of the block
+
+  // the limits that the layers occupy when they are distributed horizontally
+  // are the prefix sums of the thicknesses
   _layers.resize(_n_layers);
+  double y_top = _min_point.coord(1);
   for (unsigned int i = 0; i < _n_layers; ++i)
-    _layers[i].init(i, _layers_thickness, _min_point, _max_point, _angle);
+  {
+    const double y_bottom = y_top;
+    if (i == _n_layers - 1) // if it is the last layer, we don't calculate the limit to eliminate the error
+      y_top = _max_point.coord(1);
+    else
+      y_top = y_bottom + 0.01*_layers_thickness[i]*Hy;
+    _layers[i].init(i, y_bottom, y_top, _min_point, _max_point, _angle);
+  }
 }
 
 
@@ -34,15 +46,15 @@ bool BlockOfLayers::contains_element(const fem::Rectangle &cell,
                                      const std::vector<fem::Point> &points) const
 {
   // we think that a cell belongs to a block if a center of the cell belongs to the block
-  double xc = 0., yc = 0.; // center of the cell
+  return contains_point(cell_center(cell, points));
+}
+
 
-  for (unsigned int i = 0; i < cell.n_vertices; ++i)
-  {
-    xc += points[cell.vertex(i)].coord(0);
-    yc += points[cell.vertex(i)].coord(1);
-  }
-  xc /= cell.n_vertices;
-  yc /= cell.n_vertices;
+
+bool BlockOfLayers::contains_point(const fem::Point &point) const
+{
+  const double xc = point.coord(0);
+  const double yc = point.coord(1);
 
   if (xc <= _max_point.coord(0) &&
       xc >= _min_point.coord(0) &&
@@ -60,19 +72,12 @@ void BlockOfLayers::get_coefs(const fem::Rectangle &cell,
                               double &coef_alpha,
                               double &coef_beta) const
 {
-  expect(contains_element(cell, points), "This block doesn't have this cell");
-
-  for (unsigned int i = 0; i < _n_layers; ++i)
-  {
-    if (_layers[i].contains_element(cell, points))
-    {
-      coef_alpha = _layers_coef_alpha[i];
-      coef_beta  = _layers_coef_beta[i];
-      return;
-    }
-  }
+  const fem::Point center = cell_center(cell, points);
+  expect(contains_point(center), "This block doesn't have this cell");
 
-  require(false, "The element cannot be found in layers");
+  const unsigned int number = layer_number(center);
+  coef_alpha = _layers_coef_alpha[number];
+  coef_beta  = _layers_coef_beta[number];
 }
 
 
@@ -80,14 +85,41 @@ void BlockOfLayers::get_coefs(const fem::Rectangle &cell,
 const Layer& BlockOfLayers::layer_which_contains(const fem::Rectangle &cell,
                                                  const std::vector<fem::Point> &points) const
 {
-  expect(contains_element(cell, points), "This block doesn't have this cell");
-  for (unsigned int i = 0; i < _n_layers; ++i)
+  const fem::Point center = cell_center(cell, points);
+  expect(contains_point(center), "This block doesn't have this cell");
+  return _layers[layer_number(center)];
+}
+
+
+
+unsigned int BlockOfLayers::layer_number(const fem::Point &point) const
+{
+  const int number = find_layer(point);
+  require(number >= 0, "The element cannot be found in layers");
+  return number;
+}
+
+
+
+int BlockOfLayers::find_layer(const fem::Point &point) const
+{
+  if (!contains_point(point))
+    return -1;
+
+  // find the first layer which top side is not below the point
+  unsigned int beg = 0, end = _n_layers;
+  while (beg < end)
   {
-    if (_layers[i].contains_element(cell, points))
-      return _layers[i];
+    const unsigned int mid = beg + (end - beg) / 2;
+    if (_layers[mid].below_top(point))
+      end = mid;
+    else
+      beg = mid + 1;
   }
 
-  require(false, "The element cannot be found in layers");
+  if (beg < _n_layers && _layers[beg].above_bottom(point))
+    return beg;
+  return -1;
 }
 
 
@@ -96,3 +128,27 @@ unsigned int BlockOfLayers::n_layers() const
 {
   return _n_layers;
 }
+
+
+
+const Layer& BlockOfLayers::layer(unsigned int number) const
+{
+  expect(number < _n_layers, "The number of the layer is out of range: " + d2s(number));
+  return _layers[number];
+}
+
+
+
+double BlockOfLayers::coef_alpha(unsigned int number) const
+{
+  expect(number < _n_layers, "The number of the layer is out of range: " + d2s(number));
+  return _layers_coef_alpha[number];
+}
+
+
+
+double BlockOfLayers::coef_beta(unsigned int number) const
+{
+  expect(number < _n_layers, "The number of the layer is out of range: " + d2s(number));
+  return _layers_coef_beta[number];
+}
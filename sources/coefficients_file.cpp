@@ -0,0 +1,225 @@
+#include "coefficients_file.h"
+#include "fem/auxiliary_functions.h"
+#include <fstream>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+static_assert(sizeof(double) == sizeof(uint64_t), "The checksum requires 64-bit doubles");
+
+const char CoefficientsFile::MAGIC[8] = { 'F', 'E', 'M', '2', 'D', 'C', 'O', '\0' };
+const uint32_t CoefficientsFile::VERSION;
+const uint32_t CoefficientsFile::BYTE_ORDER_MARK;
+const uint64_t CoefficientsFile::FNV_OFFSET;
+
+
+
+CoefficientsFile::CoefficientsFile(const std::string &filename)
+  : _data(NULL),
+    _size(0),
+    _header(NULL)
+{
+  static_assert(sizeof(Header) == 64, "The header of the binary coefficients file must be 64 bytes long");
+
+  const int fd = open(filename.c_str(), O_RDONLY);
+  require(fd >= 0, "File " + filename + " cannot be opened");
+
+  struct stat file_stat;
+  require(fstat(fd, &file_stat) == 0, "Cannot get the size of the file " + filename);
+  _size = file_stat.st_size;
+  require(_size >= sizeof(Header), "File " + filename + " is too small to be a binary coefficients file");
+
+  _data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps the file
+  require(_data != MAP_FAILED, "File " + filename + " cannot be mapped into memory");
+
+  _header = static_cast<const Header*>(_data);
+  require(memcmp(_header->magic, MAGIC, sizeof(MAGIC)) == 0, "File " + filename + " is not a binary coefficients file");
+  require(_header->version == VERSION, "Unsupported version of the binary coefficients file " + filename +
+          ": " + d2s(_header->version) + " (expected " + d2s(VERSION) + ")");
+  require(_header->byte_order == BYTE_ORDER_MARK, "File " + filename + " was written on a machine with different byte order");
+  require(_header->layout == PER_CELL || _header->layout == PER_VERTEX, "Unknown layout of coefficients in the file " + filename);
+
+  const uint64_t expected_n = (_header->layout == PER_CELL ?
+                               (uint64_t)_header->nx * _header->ny :
+                               (uint64_t)(_header->nx + 1) * (_header->ny + 1));
+  require(_header->n_values == expected_n, "The number of values in the file " + filename + " doesn't correspond to the grid");
+  require(_size == sizeof(Header) + 2 * _header->n_values * sizeof(double), "File " + filename + " is truncated or corrupted");
+
+  // the values are read sequentially once to check them
+  madvise(_data, _size, MADV_SEQUENTIAL);
+  require(checksum(alpha(), 2 * _header->n_values) == _header->checksum, "Checksum of the file " + filename + " doesn't match");
+}
+
+
+
+CoefficientsFile::~CoefficientsFile()
+{
+  if (_data != NULL)
+    munmap(_data, _size);
+}
+
+
+
+CoefficientsFile::Layout CoefficientsFile::layout() const
+{
+  return static_cast<Layout>(_header->layout);
+}
+
+
+
+unsigned int CoefficientsFile::nx() const
+{
+  return _header->nx;
+}
+
+
+
+unsigned int CoefficientsFile::ny() const
+{
+  return _header->ny;
+}
+
+
+
+uint64_t CoefficientsFile::n_values() const
+{
+  return _header->n_values;
+}
+
+
+
+const double* CoefficientsFile::alpha() const
+{
+  return reinterpret_cast<const double*>(static_cast<const char*>(_data) + sizeof(Header));
+}
+
+
+
+const double* CoefficientsFile::beta() const
+{
+  return alpha() + _header->n_values;
+}
+
+
+
+void CoefficientsFile::write(const std::string &filename, Layout layout,
+                             unsigned int nx, unsigned int ny,
+                             const std::vector<double> &alpha,
+                             const std::vector<double> &beta)
+{
+  const uint64_t n_values = (layout == PER_CELL ? (uint64_t)nx * ny : (uint64_t)(nx + 1) * (ny + 1));
+  require(alpha.size() == n_values && beta.size() == n_values,
+          "The number of coefficients doesn't correspond to the grid " + d2s(nx) + " x " + d2s(ny));
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.layout = layout;
+  header.nx = nx;
+  header.ny = ny;
+  header.n_values = n_values;
+  header.checksum = checksum(&beta[0], n_values, checksum(&alpha[0], n_values));
+
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  require(out, "File " + filename + " cannot be opened");
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(&alpha[0]), n_values * sizeof(double));
+  out.write(reinterpret_cast<const char*>(&beta[0]), n_values * sizeof(double));
+  require(out, "Error while writing the file " + filename);
+  out.close();
+}
+
+
+
+bool CoefficientsFile::is_binary(const std::string &filename)
+{
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  require(in, "File " + filename + " cannot be opened");
+  char magic[sizeof(MAGIC)];
+  in.read(magic, sizeof(magic));
+  return in && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+
+
+void CoefficientsFile::convert(const std::string &in_filename, const std::string &out_filename,
+                               unsigned int nx, unsigned int ny)
+{
+  if (is_binary(in_filename)) // binary -> text
+  {
+    const CoefficientsFile coef_file(in_filename);
+    const double *alpha = coef_file.alpha();
+    const double *beta = coef_file.beta();
+
+    std::ofstream out(out_filename.c_str());
+    require(out, "File " + out_filename + " cannot be opened");
+    out.setf(std::ios::scientific);
+    out.precision(14);
+
+    out << coef_file.n_values() << "\n";
+    for (uint64_t i = 0; i < coef_file.n_values(); ++i)
+      out << alpha[i] << " " << beta[i] << "\n";
+
+    out.close();
+  }
+  else // text -> binary
+  {
+    std::ifstream in(in_filename.c_str());
+    require(in, "File " + in_filename + " cannot be opened");
+
+    unsigned int n_values;
+    in >> n_values;
+
+    Layout layout = PER_CELL;
+    if (n_values == nx * ny)
+      layout = PER_CELL;
+    else if (n_values == (nx + 1) * (ny + 1))
+      layout = PER_VERTEX;
+    else
+      require(false, "The number of coefficients in the file " + in_filename +
+              " (" + d2s(n_values) + ") corresponds neither to cells nor to vertices of the grid " + d2s(nx) + " x " + d2s(ny));
+
+    std::vector<double> alpha(n_values), beta(n_values);
+    for (unsigned int i = 0; i < n_values; ++i)
+      in >> alpha[i] >> beta[i];
+    require(in, "Error while reading the file " + in_filename);
+    in.close();
+
+    write(out_filename, layout, nx, ny, alpha, beta);
+  }
+}
+
+
+
+uint64_t CoefficientsFile::checksum(const double *data, uint64_t n, uint64_t hash)
+{
+  const uint64_t prime = 1099511628211ULL;
+  for (uint64_t i = 0; i < n; ++i)
+  {
+    uint64_t word;
+    memcpy(&word, &data[i], sizeof(word));
+    hash ^= word;
+    hash *= prime;
+  }
+  return hash;
+}
+
+
+
+uint64_t CoefficientsFile::hash_bytes(const void *data, uint64_t n_bytes, uint64_t hash)
+{
+  const uint64_t prime = 1099511628211ULL;
+  const unsigned char *bytes = static_cast<const unsigned char*>(data);
+  for (uint64_t i = 0; i < n_bytes; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= prime;
+  }
+  return hash;
+}
@@ -0,0 +1,80 @@
+#include "csr_assembler.h"
+#include <algorithm>
+
+
+CSRAssembler::CSRAssembler(const fem::CSRPattern &csr_pattern, const DoFRenumbering &renumbering)
+  : _renumbering(renumbering)
+{
+  const unsigned int order = csr_pattern.order();
+
+  // the lengths of the rows in the new numbering
+  _row.resize(order + 1, 0);
+  for (unsigned int i = 0; i < order; ++i)
+    _row[_renumbering.new_dof(i) + 1] = csr_pattern.row(i + 1) - csr_pattern.row(i);
+  for (unsigned int i = 0; i < order; ++i)
+    _row[i + 1] += _row[i];
+
+  const unsigned int nnz = _row[order];
+  _col.resize(nnz);
+  for (unsigned int i = 0; i < order; ++i)
+  {
+    PetscInt pos = _row[_renumbering.new_dof(i)];
+    for (unsigned int k = csr_pattern.row(i); k < csr_pattern.row(i + 1); ++k)
+      _col[pos++] = _renumbering.new_dof(csr_pattern.col(k));
+  }
+  for (unsigned int i = 0; i < order; ++i)
+    std::sort(_col.begin() + _row[i], _col.begin() + _row[i + 1]);
+
+  _mass.resize(nnz, 0.);
+  _stiff.resize(nnz, 0.);
+}
+
+
+
+unsigned int CSRAssembler::position(unsigned int row, unsigned int col) const
+{
+  const PetscInt pos = find(row, col);
+  require(pos >= 0, "The entry (" + d2s(row) + ", " + d2s(col) + ") is not in the sparse pattern");
+  return pos;
+}
+
+
+
+PetscInt CSRAssembler::find(unsigned int row, unsigned int col) const
+{
+  // the rows are short (9 entries for rectangles), so the linear search is the fastest one
+  for (PetscInt k = _row[row]; k < _row[row + 1]; ++k)
+    if (_col[k] == (PetscInt)col)
+      return k;
+  return -1;
+}
+
+
+
+void CSRAssembler::create_matrices(Mat *mass, Mat *stiff)
+{
+  const PetscInt order = _row.size() - 1;
+  MatCreateSeqAIJWithArrays(PETSC_COMM_SELF, order, order, &_row[0], &_col[0], &_mass[0], mass);
+  MatCreateSeqAIJWithArrays(PETSC_COMM_SELF, order, order, &_row[0], &_col[0], &_stiff[0], stiff);
+}
+
+
+
+void CSRAssembler::create_distributed_matrices(MPI_Comm comm, unsigned int row_beg, unsigned int row_end,
+                                               unsigned int dof_shift, unsigned int n_dofs,
+                                               Mat *mass, Mat *stiff) const
+{
+  require(row_beg <= row_end && row_end < _row.size(), "The range of rows is out of the matrices");
+
+  // the rows of this process with the global column indices
+  const PetscInt n_rows = row_end - row_beg;
+  const PetscInt first = _row[row_beg];
+  std::vector<PetscInt> row(n_rows + 1), col(_row[row_end] - first);
+  for (PetscInt i = 0; i <= n_rows; ++i)
+    row[i] = _row[row_beg + i] - first;
+  for (unsigned int k = 0; k < col.size(); ++k)
+    col[k] = _col[first + k] + dof_shift;
+
+  MatCreateMPIAIJWithArrays(comm, n_rows, n_rows, n_dofs, n_dofs, &row[0], &col[0], &_mass[first], mass);
+  MatCreateMPIAIJWithArrays(comm, n_rows, n_rows, n_dofs, n_dofs, &row[0], &col[0], &_stiff[first], stiff);
+}
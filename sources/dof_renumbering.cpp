@@ -0,0 +1,286 @@
+#include "dof_renumbering.h"
+#include "fem/auxiliary_functions.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+
+
+namespace
+{
+  /**
+   * Comparison of the dofs by their degrees in the graph of the sparse pattern
+   */
+  struct LessDegree
+  {
+    LessDegree(const std::vector<int> &degree) : _degree(degree) { }
+    bool operator()(int i, int j) const { return _degree[i] < _degree[j]; }
+    const std::vector<int> &_degree;
+  };
+
+  /**
+   * Comparison of the dofs by their keys
+   */
+  struct LessKey
+  {
+    LessKey(const std::vector<unsigned long long> &keys) : _keys(keys) { }
+    bool operator()(int i, int j) const { return _keys[i] < _keys[j]; }
+    const std::vector<unsigned long long> &_keys;
+  };
+
+  /**
+   * Breadth-first search in the graph of the sparse pattern over the vertices
+   * which are not numbered yet.
+   * @param root - the starting vertex
+   * @param level - the levels of the vertices (-1 for not reached ones).
+   *                The levels of the reached vertices are reset to -1 at the end
+   * @param numbered - the vertices which are numbered already
+   * @param degree - the degrees of the vertices
+   * @param n_levels - output number of levels
+   * @return the vertex of the last level with minimal degree
+   */
+  int farthest_vertex(const fem::CSRPattern &csr_pattern, int root, std::vector<int> &level,
+                      const std::vector<bool> &numbered, const std::vector<int> &degree,
+                      int &n_levels)
+  {
+    std::vector<int> queue(1, root);
+    level[root] = 0;
+    for (unsigned int q = 0; q < queue.size(); ++q)
+    {
+      const int v = queue[q];
+      for (unsigned int k = csr_pattern.row(v); k < csr_pattern.row(v + 1); ++k)
+      {
+        const int u = csr_pattern.col(k);
+        if (level[u] < 0 && !numbered[u])
+        {
+          level[u] = level[v] + 1;
+          queue.push_back(u);
+        }
+      }
+    }
+
+    n_levels = level[queue.back()] + 1;
+    int farthest = queue.back();
+    for (unsigned int q = 0; q < queue.size(); ++q)
+    {
+      const int v = queue[q];
+      if (level[v] == n_levels - 1 && degree[v] < degree[farthest])
+        farthest = v;
+      level[v] = -1;
+    }
+    return farthest;
+  }
+}
+
+
+
+DoFRenumbering::DoFRenumbering()
+{ }
+
+
+
+DoFRenumbering::DoFRenumbering(const std::vector<int> &new_dofs)
+  : _new_dofs(new_dofs)
+{
+  std::vector<bool> used(_new_dofs.size(), false);
+  for (unsigned int i = 0; i < _new_dofs.size(); ++i)
+  {
+    require(_new_dofs[i] >= 0 && _new_dofs[i] < (int)_new_dofs.size() && !used[_new_dofs[i]],
+            "The renumbering of dofs is not a permutation (dof " + d2s(i) + ")");
+    used[_new_dofs[i]] = true;
+  }
+}
+
+
+
+DoFRenumbering DoFRenumbering::cuthill_mckee(const fem::CSRPattern &csr_pattern)
+{
+  const unsigned int n_dofs = csr_pattern.order();
+
+  std::vector<int> degree(n_dofs);
+  for (unsigned int i = 0; i < n_dofs; ++i)
+    degree[i] = csr_pattern.row(i + 1) - csr_pattern.row(i);
+
+  std::vector<int> order; // the dofs in Cuthill-McKee order
+  order.reserve(n_dofs);
+  std::vector<bool> numbered(n_dofs, false);
+  std::vector<int> level(n_dofs, -1);
+  std::vector<int> neighbours;
+
+  for (unsigned int start = 0; start < n_dofs; ++start)
+  {
+    if (numbered[start])
+      continue;
+
+    // pseudo-peripheral vertex of the connected component:
+    // go to the farthest vertex while the number of levels grows
+    int root = start, n_levels = 0;
+    int next = farthest_vertex(csr_pattern, root, level, numbered, degree, n_levels);
+    for (int iter = 0; iter < 5; ++iter)
+    {
+      int next_n_levels;
+      const int next_next = farthest_vertex(csr_pattern, next, level, numbered, degree, next_n_levels);
+      if (next_n_levels <= n_levels)
+        break;
+      root = next;
+      n_levels = next_n_levels;
+      next = next_next;
+    }
+
+    // Cuthill-McKee numbering of the component
+    const unsigned int beg = order.size();
+    order.push_back(root);
+    numbered[root] = true;
+    for (unsigned int q = beg; q < order.size(); ++q)
+    {
+      const int v = order[q];
+      neighbours.clear();
+      for (unsigned int k = csr_pattern.row(v); k < csr_pattern.row(v + 1); ++k)
+      {
+        const int u = csr_pattern.col(k);
+        if (!numbered[u])
+        {
+          numbered[u] = true;
+          neighbours.push_back(u);
+        }
+      }
+      std::stable_sort(neighbours.begin(), neighbours.end(), LessDegree(degree));
+      order.insert(order.end(), neighbours.begin(), neighbours.end());
+    }
+  }
+
+  // reverse the order
+  std::vector<int> new_dofs(n_dofs);
+  for (unsigned int i = 0; i < n_dofs; ++i)
+    new_dofs[order[i]] = n_dofs - 1 - i;
+
+  return DoFRenumbering(new_dofs);
+}
+
+
+
+DoFRenumbering DoFRenumbering::morton(const std::vector<fem::Point> &dofs, unsigned int nx, unsigned int ny)
+{
+  std::vector<unsigned int> ix, iy;
+  grid_indices(dofs, nx, ny, ix, iy);
+
+  // interleave the bits of the indices
+  std::vector<unsigned long long> keys(dofs.size(), 0);
+  for (unsigned int i = 0; i < dofs.size(); ++i)
+    for (unsigned int b = 0; b < 32; ++b)
+      keys[i] |= ((unsigned long long)((ix[i] >> b) & 1) << (2 * b)) |
+                 ((unsigned long long)((iy[i] >> b) & 1) << (2 * b + 1));
+
+  return DoFRenumbering(sort_by_keys(keys));
+}
+
+
+
+DoFRenumbering DoFRenumbering::tiled(const std::vector<fem::Point> &dofs, unsigned int nx, unsigned int ny)
+{
+  std::vector<unsigned int> ix, iy;
+  grid_indices(dofs, nx, ny, ix, iy);
+
+  const unsigned long long n_tiles_x = nx / TILE_SIZE + 1;
+  std::vector<unsigned long long> keys(dofs.size());
+  for (unsigned int i = 0; i < dofs.size(); ++i)
+  {
+    const unsigned long long tile = (iy[i] / TILE_SIZE) * n_tiles_x + ix[i] / TILE_SIZE;
+    keys[i] = (tile * TILE_SIZE + iy[i] % TILE_SIZE) * TILE_SIZE + ix[i] % TILE_SIZE;
+  }
+
+  return DoFRenumbering(sort_by_keys(keys));
+}
+
+
+
+bool DoFRenumbering::natural() const
+{
+  return _new_dofs.empty();
+}
+
+
+
+std::vector<int> DoFRenumbering::new_dofs(const std::vector<int> &dofs) const
+{
+  std::vector<int> result(dofs.size());
+  for (unsigned int i = 0; i < dofs.size(); ++i)
+    result[i] = new_dof(dofs[i]);
+  return result;
+}
+
+
+
+void DoFRenumbering::to_natural(Vec x, Vec natural_x) const
+{
+  if (natural())
+  {
+    VecCopy(x, natural_x);
+    return;
+  }
+
+  const double *x_val;
+  double *natural_val;
+  VecGetArrayRead(x, &x_val);
+  VecGetArray(natural_x, &natural_val);
+  for (unsigned int i = 0; i < _new_dofs.size(); ++i)
+    natural_val[i] = x_val[_new_dofs[i]];
+  VecRestoreArray(natural_x, &natural_val);
+  VecRestoreArrayRead(x, &x_val);
+}
+
+
+
+unsigned int DoFRenumbering::bandwidth(const fem::CSRPattern &csr_pattern) const
+{
+  unsigned int band = 0;
+  for (unsigned int i = 0; i < csr_pattern.order(); ++i)
+    for (unsigned int k = csr_pattern.row(i); k < csr_pattern.row(i + 1); ++k)
+      band = std::max(band, (unsigned int)abs((int)new_dof(i) - (int)new_dof(csr_pattern.col(k))));
+  return band;
+}
+
+
+
+void DoFRenumbering::grid_indices(const std::vector<fem::Point> &dofs, unsigned int nx, unsigned int ny,
+                                  std::vector<unsigned int> &ix, std::vector<unsigned int> &iy)
+{
+  require(dofs.size() == (nx + 1) * (ny + 1), "The dofs don't correspond to the vertices of the grid " + d2s(nx) + " x " + d2s(ny));
+
+  double min_coord[] = { dofs[0].coord(0), dofs[0].coord(1) };
+  double max_coord[] = { dofs[0].coord(0), dofs[0].coord(1) };
+  for (unsigned int i = 1; i < dofs.size(); ++i)
+  {
+    for (unsigned int d = 0; d < 2; ++d)
+    {
+      min_coord[d] = std::min(min_coord[d], dofs[i].coord(d));
+      max_coord[d] = std::max(max_coord[d], dofs[i].coord(d));
+    }
+  }
+  const double hx = (max_coord[0] - min_coord[0]) / nx;
+  const double hy = (max_coord[1] - min_coord[1]) / ny;
+
+  ix.resize(dofs.size());
+  iy.resize(dofs.size());
+  for (unsigned int i = 0; i < dofs.size(); ++i)
+  {
+    ix[i] = (unsigned int)floor((dofs[i].coord(0) - min_coord[0]) / hx + 0.5);
+    iy[i] = (unsigned int)floor((dofs[i].coord(1) - min_coord[1]) / hy + 0.5);
+    require(ix[i] <= nx && iy[i] <= ny, "The dof " + d2s(i) + " is not a vertex of the grid");
+  }
+}
+
+
+
+std::vector<int> DoFRenumbering::sort_by_keys(const std::vector<unsigned long long> &keys)
+{
+  std::vector<int> order(keys.size()); // the dofs in the new order
+  for (unsigned int i = 0; i < keys.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), LessKey(keys));
+
+  std::vector<int> new_dofs(keys.size());
+  for (unsigned int i = 0; i < order.size(); ++i)
+    new_dofs[order[i]] = i;
+  return new_dofs;
+}
@@ -21,7 +21,7 @@
 
 
 
-void Layer::init(unsigned int number, const std::vector<double> &thickness_percent,
+void Layer::init(unsigned int number, double y_bottom, double y_top,
                  const fem::Point &min_point, const fem::Point &max_point,
                  double angle)
 {
@@ -30,12 +30,7 @@ void Layer::init(unsigned int number, const std::vector<double> &thickness_perce
   expect(fabs(fabs(angle) - right_angle) > fem::math::FLOAT_NUMBERS_EQUALITY_TOLERANCE,
          "Angle is equal to right angle (90), what is prohibited");
 
-  const unsigned int n_layers = thickness_percent.size(); // the total amount of layers
-  expect(number < n_layers, "The number of current layer (" + d2s(number + 1) +
-         ") is bigger than the total number of layers (" + d2s(n_layers) + ")");
-
   _number = number;
-  _thickness_percent = thickness_percent[number];
   _min_point = min_point;
   _max_point = max_point;
 
@@ -55,17 +50,7 @@ void Layer::init(unsigned int number, const std::vector<double> &thickness_perce
   const double Hy = _max_point.coord(1) - _min_point.coord(1); // the length (y-direction) of the domain
   const double Hx = _max_point.coord(0) - _min_point.coord(0); // the length (x-direction) of the domain
 
-  // define the limits that the layer occupies when it is distributed horizontally
-  double y_bottom = _min_point.coord(1) - 1; // it's wrong by default
-  double y_top = _min_point.coord(1);
-  for (unsigned int i = 0; i < _number + 1; ++i)
-  {
-    y_bottom = y_top;
-    if (i == n_layers - 1) // if it is the last layer, we don't calculate the limit to eliminate the error
-      y_top = _max_point.coord(1);
-    else
-      y_top = y_bottom + 0.01*thickness_percent[i]*Hy;
-  }
+  // the limits that the layer occupies when it is distributed horizontally
   expect(y_bottom >= _min_point.coord(1), "Please check y_bottom. It's wrong.");
   expect(y_top > y_bottom, "y_top and/or y_bottom are wrong");
 
@@ -156,15 +141,15 @@ void Layer::init(unsigned int number, const std::vector<double> &thickness_perce
 bool Layer::contains_element(const fem::Rectangle &cell, const std::vector<fem::Point> &points) const
 {
   // we think that a cell belongs to a layer if a center of the cell belongs to the layer
-  double xc = 0., yc = 0.; // center of the cell
+  return contains_point(cell_center(cell, points));
+}
 
-  for (unsigned int i = 0; i < cell.n_vertices; ++i)
-  {
-    xc += points[cell.vertex(i)].coord(0);
-    yc += points[cell.vertex(i)].coord(1);
-  }
-  xc /= cell.n_vertices;
-  yc /= cell.n_vertices;
+
+
+bool Layer::contains_point(const fem::Point &point) const
+{
+  const double xc = point.coord(0);
+  const double yc = point.coord(1);
 
   expect(xc > _min_point.coord(0), "X-center of the cell is less than left limit. That's wrong");
   expect(xc < _max_point.coord(0), "X-center of the cell is more than right limit. That's wrong");
@@ -186,7 +171,38 @@ bool Layer::contains_element(const fem::Rectangle &cell, const std::vector<fem::
 
 
 
+bool Layer::below_top(const fem::Point &point) const
+{
+  return point.coord(1) <= _a_top * point.coord(0) + _b_top;
+}
+
+
+
+bool Layer::above_bottom(const fem::Point &point) const
+{
+  return point.coord(1) >= _a_bottom * point.coord(0) + _b_bottom;
+}
+
+
+
 double Layer::thickness() const
 {
   return _thickness;
 }
+
+
+
+fem::Point cell_center(const fem::Rectangle &cell, const std::vector<fem::Point> &points)
+{
+  double xc = 0., yc = 0.; // center of the cell
+
+  for (unsigned int i = 0; i < cell.n_vertices; ++i)
+  {
+    xc += points[cell.vertex(i)].coord(0);
+    yc += points[cell.vertex(i)].coord(1);
+  }
+  xc /= cell.n_vertices;
+  yc /= cell.n_vertices;
+
+  return fem::Point(xc, yc);
+}
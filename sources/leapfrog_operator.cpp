@@ -0,0 +1,834 @@
+#include "leapfrog_operator.h"
+#include "fem/auxiliary_functions.h"
+#include <algorithm>
+#include <functional>
+#if defined(_OPENMP)
+  #include <omp.h>
+#endif
+
+
+
+namespace
+{
+  /**
+   * Comparison of the rows of the CSR pattern by their lengths (the longer row goes first)
+   */
+  struct RowLongerThan
+  {
+    RowLongerThan(const int *row) : _row(row) { }
+    bool operator()(int i, int j) const { return _row[i + 1] - _row[i] > _row[j + 1] - _row[j]; }
+    const int *_row;
+  };
+}
+
+
+
+void LeapfrogOperator::apply_part(const double*, const double*, double, const double*, double*,
+                                  unsigned int, unsigned int) const
+{
+  require(false, "The operator can't be applied in parts");
+}
+
+
+
+unsigned int LeapfrogOperator::row_part(unsigned int, unsigned int) const
+{
+  require(false, "The operator can't be applied in parts");
+  return 0;
+}
+
+
+
+void LeapfrogOperator::distribute(const NumaPlacement&, unsigned int)
+{ } // the operators which are not partitioned are applied by one thread
+
+
+
+unsigned int LeapfrogOperator::part_begin(unsigned int n, unsigned int part, unsigned int n_parts)
+{
+  return (unsigned long long)n * part / n_parts;
+}
+
+
+
+unsigned int LeapfrogOperator::part_of(unsigned int i, unsigned int n, unsigned int n_parts)
+{
+  unsigned int part = (unsigned long long)i * n_parts / n; // the estimation
+  while (part > 0 && part_begin(n, part, n_parts) > i)
+    --part;
+  while (part + 1 < n_parts && part_begin(n, part + 1, n_parts) <= i)
+    ++part;
+  return part;
+}
+
+
+
+CSRLeapfrogOperator::CSRLeapfrogOperator(Mat mass_mat, Mat stiff_mat,
+                                         double a_mass, double a_stiff,
+                                         double b_mass, double b_stiff,
+                                         Vec mass_diag)
+{
+  const bool lumped = (mass_diag != NULL);
+  require(!(lumped && b_stiff != 0.), "The operator B must be diagonal in case of lumped mass matrix");
+
+  PetscInt n_rows, n_cols;
+  MatGetSize(mass_mat, &n_rows, &n_cols);
+  require(n_rows == n_cols, "The matrices must be square");
+
+  const double *m_diag = NULL;
+  if (lumped)
+    VecGetArrayRead(mass_diag, &m_diag);
+
+  // the arrays are built here, and then they are copied into the arrays
+  // which can be placed in the memory of the threads (see distribute)
+  std::vector<int> row(n_rows + 1, 0), col;
+  std::vector<double> a_values, b_values, inv_mass;
+  if (lumped)
+  {
+    b_values.resize(n_rows);
+    inv_mass.resize(n_rows);
+  }
+
+  for (PetscInt i = 0; i < n_rows; ++i)
+  {
+    PetscInt m_ncols, k_ncols;
+    const PetscInt *m_cols, *k_cols;
+    const PetscScalar *m_vals, *k_vals;
+    MatGetRow(mass_mat, i, &m_ncols, &m_cols, &m_vals);
+    MatGetRow(stiff_mat, i, &k_ncols, &k_cols, &k_vals);
+    require(m_ncols == k_ncols, "Mass and stiffness matrices have different sparse structure (row " + d2s(i) + ")");
+
+    for (PetscInt k = 0; k < m_ncols; ++k)
+    {
+      require(m_cols[k] == k_cols[k], "Mass and stiffness matrices have different sparse structure (row " + d2s(i) + ")");
+      col.push_back(m_cols[k]);
+      if (lumped) // mass matrix acts on the diagonal only
+      {
+        const double mass = (m_cols[k] == i ? m_diag[i] : 0.);
+        a_values.push_back(a_mass * mass + a_stiff * k_vals[k]);
+      }
+      else
+      {
+        a_values.push_back(a_mass * m_vals[k] + a_stiff * k_vals[k]);
+        b_values.push_back(b_mass * m_vals[k] + b_stiff * k_vals[k]);
+      }
+    }
+    row[i + 1] = col.size();
+
+    MatRestoreRow(stiff_mat, i, &k_ncols, &k_cols, &k_vals);
+    MatRestoreRow(mass_mat, i, &m_ncols, &m_cols, &m_vals);
+
+    if (lumped)
+    {
+      b_values[i] = b_mass * m_diag[i];
+      inv_mass[i] = 1. / m_diag[i];
+    }
+  }
+
+  if (lumped)
+    VecRestoreArrayRead(mass_diag, &m_diag);
+
+  _row.assign(row);
+  _col.assign(col);
+  _a_values.assign(a_values);
+  _b_values.assign(b_values);
+  _inv_mass.assign(inv_mass);
+}
+
+
+
+void CSRLeapfrogOperator::apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const
+{
+  const double *u1_val, *u2_val, *f_val;
+  double *y_val;
+  VecGetArrayRead(u1, &u1_val);
+  VecGetArrayRead(u2, &u2_val);
+  VecGetArray(y, &y_val);
+  if (f == y)
+    f_val = y_val; // each row reads f before writing y, so it's safe
+  else
+    VecGetArrayRead(f, &f_val);
+
+  apply_rows(u1_val, u2_val, coef_f, f_val, y_val, 0, order());
+
+  if (f != y)
+    VecRestoreArrayRead(f, &f_val);
+  VecRestoreArray(y, &y_val);
+  VecRestoreArrayRead(u2, &u2_val);
+  VecRestoreArrayRead(u1, &u1_val);
+}
+
+
+
+void CSRLeapfrogOperator::apply_part(const double *u1, const double *u2, double coef_f, const double *f, double *y,
+                                     unsigned int part, unsigned int n_parts) const
+{
+  apply_rows(u1, u2, coef_f, f, y, part_begin(order(), part, n_parts), part_begin(order(), part + 1, n_parts));
+}
+
+
+
+unsigned int CSRLeapfrogOperator::row_part(unsigned int row, unsigned int n_parts) const
+{
+  return part_of(row, order(), n_parts);
+}
+
+
+
+void CSRLeapfrogOperator::distribute(const NumaPlacement &placement, unsigned int n_parts)
+{
+  const bool lumped = !_inv_mass.empty();
+  const unsigned int n_rows = order();
+
+  NumaArray<int> row, col;
+  NumaArray<double> a_values, b_values, inv_mass;
+  row.allocate(_row.size(), placement.huge_pages());
+  col.allocate(_col.size(), placement.huge_pages());
+  a_values.allocate(_a_values.size(), placement.huge_pages());
+  b_values.allocate(_b_values.size(), placement.huge_pages());
+  inv_mass.allocate(_inv_mass.size(), placement.huge_pages());
+
+#if defined(_OPENMP)
+  #pragma omp parallel num_threads(n_parts)
+#endif
+  {
+#if defined(_OPENMP)
+    placement.pin_thread(omp_get_thread_num()); // a failure is reported by the time loop pinning the threads again
+    #pragma omp for schedule(static, 1)
+#endif
+    for (int part = 0; part < (int)n_parts; ++part)
+    {
+      const unsigned int row_beg = part_begin(n_rows, part, n_parts);
+      const unsigned int row_end = part_begin(n_rows, part + 1, n_parts);
+      row.copy_range(_row, row_beg, (part + 1 == (int)n_parts ? row_end + 1 : row_end));
+      col.copy_range(_col, _row[row_beg], _row[row_end]);
+      a_values.copy_range(_a_values, _row[row_beg], _row[row_end]);
+      if (lumped)
+      {
+        b_values.copy_range(_b_values, row_beg, row_end);
+        inv_mass.copy_range(_inv_mass, row_beg, row_end);
+      }
+      else
+        b_values.copy_range(_b_values, _row[row_beg], _row[row_end]);
+    }
+  }
+
+  _row.swap(row);
+  _col.swap(col);
+  _a_values.swap(a_values);
+  _b_values.swap(b_values);
+  _inv_mass.swap(inv_mass);
+}
+
+
+
+void CSRLeapfrogOperator::apply_rows(const double *u1_val, const double *u2_val, double coef_f, const double *f_val, double *y_val,
+                                     unsigned int row_beg, unsigned int row_end) const
+{
+  const int *row = &_row[0];
+  const int *col = &_col[0];
+  const double *a_val = &_a_values[0];
+  const double *b_val = &_b_values[0];
+
+  if (_inv_mass.empty()) // consistent mass matrix
+  {
+    for (unsigned int i = row_beg; i < row_end; ++i)
+    {
+      double sum = coef_f * f_val[i];
+      for (int k = row[i]; k < row[i + 1]; ++k)
+        sum += a_val[k] * u1_val[col[k]] + b_val[k] * u2_val[col[k]];
+      y_val[i] = sum;
+    }
+  }
+  else // lumped mass matrix
+  {
+    const double *inv_mass = &_inv_mass[0];
+    for (unsigned int i = row_beg; i < row_end; ++i)
+    {
+      double sum = coef_f * f_val[i] + b_val[i] * u2_val[i];
+      for (int k = row[i]; k < row[i + 1]; ++k)
+        sum += a_val[k] * u1_val[col[k]];
+      y_val[i] = sum * inv_mass[i];
+    }
+  }
+}
+
+
+
+unsigned int CSRLeapfrogOperator::order() const
+{
+  return _row.size() - 1;
+}
+
+
+
+SymmetricLeapfrogOperator::SymmetricLeapfrogOperator(Mat mass_mat, Mat stiff_mat,
+                                                     double a_mass, double a_stiff,
+                                                     double b_mass, double b_stiff,
+                                                     Vec mass_diag)
+{
+  const bool lumped = (mass_diag != NULL);
+  require(!(lumped && b_stiff != 0.), "The operator B must be diagonal in case of lumped mass matrix");
+
+  PetscInt n_rows, n_cols;
+  MatGetSize(mass_mat, &n_rows, &n_cols);
+  require(n_rows == n_cols, "The matrices must be square");
+
+  const double *m_diag = NULL;
+  if (lumped)
+    VecGetArrayRead(mass_diag, &m_diag);
+
+  _row.resize(n_rows + 1, 0);
+  _a_diag.resize(n_rows, 0.);
+  _b_diag.resize(n_rows, 0.);
+  if (lumped)
+    _inv_mass.resize(n_rows);
+
+  for (PetscInt i = 0; i < n_rows; ++i)
+  {
+    PetscInt m_ncols, k_ncols;
+    const PetscInt *m_cols, *k_cols;
+    const PetscScalar *m_vals, *k_vals;
+    MatGetRow(mass_mat, i, &m_ncols, &m_cols, &m_vals);
+    MatGetRow(stiff_mat, i, &k_ncols, &k_cols, &k_vals);
+    require(m_ncols == k_ncols, "Mass and stiffness matrices have different sparse structure (row " + d2s(i) + ")");
+
+    for (PetscInt k = 0; k < m_ncols; ++k)
+    {
+      require(m_cols[k] == k_cols[k], "Mass and stiffness matrices have different sparse structure (row " + d2s(i) + ")");
+      if (m_cols[k] == i)
+      {
+        const double mass = (lumped ? m_diag[i] : m_vals[k]);
+        _a_diag[i] = a_mass * mass + a_stiff * k_vals[k];
+        _b_diag[i] = b_mass * mass + b_stiff * k_vals[k];
+      }
+      else if (m_cols[k] > i) // the lower triangular part is the same due to symmetry
+      {
+        _col.push_back(m_cols[k]);
+        if (lumped) // mass matrix acts on the diagonal only
+          _a_upper.push_back(a_stiff * k_vals[k]);
+        else
+        {
+          _a_upper.push_back(a_mass * m_vals[k] + a_stiff * k_vals[k]);
+          _b_upper.push_back(b_mass * m_vals[k] + b_stiff * k_vals[k]);
+        }
+      }
+    }
+    _row[i + 1] = _col.size();
+
+    MatRestoreRow(stiff_mat, i, &k_ncols, &k_cols, &k_vals);
+    MatRestoreRow(mass_mat, i, &m_ncols, &m_cols, &m_vals);
+
+    if (lumped)
+      _inv_mass[i] = 1. / m_diag[i];
+  }
+
+  if (lumped)
+    VecRestoreArrayRead(mass_diag, &m_diag);
+}
+
+
+
+void SymmetricLeapfrogOperator::apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const
+{
+  const double *u1_val, *u2_val, *f_val;
+  double *y_val;
+  VecGetArrayRead(u1, &u1_val);
+  VecGetArrayRead(u2, &u2_val);
+  VecGetArray(y, &y_val);
+  if (f == y)
+    f_val = y_val; // f is read element-wise before y is written
+  else
+    VecGetArrayRead(f, &f_val);
+
+  const unsigned int n_rows = order();
+  const int *row = &_row[0];
+  const int *col = &_col[0];
+  const double *a_diag = &_a_diag[0];
+  const double *b_diag = &_b_diag[0];
+
+  // the rows of y get the contributions of the upper triangular parts of the previous rows,
+  // so all rows are initialized by the diagonal part first
+  for (unsigned int i = 0; i < n_rows; ++i)
+    y_val[i] = coef_f * f_val[i] + a_diag[i] * u1_val[i] + b_diag[i] * u2_val[i];
+
+  const double *a_val = (_a_upper.empty() ? NULL : &_a_upper[0]);
+  if (_inv_mass.empty()) // consistent mass matrix
+  {
+    const double *b_val = (_b_upper.empty() ? NULL : &_b_upper[0]);
+    for (unsigned int i = 0; i < n_rows; ++i)
+    {
+      const double u1_i = u1_val[i];
+      const double u2_i = u2_val[i];
+      double sum = 0.;
+      for (int k = row[i]; k < row[i + 1]; ++k)
+      {
+        const int j = col[k];
+        sum += a_val[k] * u1_val[j] + b_val[k] * u2_val[j]; // (i, j) entry
+        y_val[j] += a_val[k] * u1_i + b_val[k] * u2_i;     // (j, i) entry
+      }
+      y_val[i] += sum;
+    }
+  }
+  else // lumped mass matrix
+  {
+    const double *inv_mass = &_inv_mass[0];
+    for (unsigned int i = 0; i < n_rows; ++i)
+    {
+      const double u1_i = u1_val[i];
+      double sum = 0.;
+      for (int k = row[i]; k < row[i + 1]; ++k)
+      {
+        const int j = col[k];
+        sum += a_val[k] * u1_val[j];
+        y_val[j] += a_val[k] * u1_i;
+      }
+      // the previous rows have already added their contributions to the row i,
+      // and the next rows don't touch it, so the row is finished
+      y_val[i] = (y_val[i] + sum) * inv_mass[i];
+    }
+  }
+
+  if (f != y)
+    VecRestoreArrayRead(f, &f_val);
+  VecRestoreArray(y, &y_val);
+  VecRestoreArrayRead(u2, &u2_val);
+  VecRestoreArrayRead(u1, &u1_val);
+}
+
+
+
+unsigned int SymmetricLeapfrogOperator::order() const
+{
+  return _row.size() - 1;
+}
+
+
+
+SellLeapfrogOperator::SellLeapfrogOperator(Mat mass_mat, Mat stiff_mat,
+                                           double a_mass, double a_stiff,
+                                           double b_mass, double b_stiff,
+                                           Vec mass_diag)
+{
+  // the fused CSR operator reads the matrices and combines them into A and B,
+  // and then A and B are converted to the sliced format
+  const CSRLeapfrogOperator csr(mass_mat, stiff_mat, a_mass, a_stiff, b_mass, b_stiff, mass_diag);
+  const NumaArray<int> &row = csr._row;
+  const NumaArray<int> &col = csr._col;
+  const bool lumped = !csr._inv_mass.empty();
+
+  _n_rows = csr.order();
+  _nnz = row[_n_rows];
+
+  // sort the rows by their lengths (descending) inside each window,
+  // so the rows of similar lengths come to the same chunk
+  const unsigned int n_chunks = (_n_rows + CHUNK - 1) / CHUNK;
+  std::vector<int> perm(n_chunks * CHUNK, -1);
+  for (unsigned int i = 0; i < _n_rows; ++i)
+    perm[i] = i;
+  for (unsigned int beg = 0; beg < _n_rows; beg += SIGMA)
+  {
+    const unsigned int end = std::min(beg + SIGMA, _n_rows);
+    std::stable_sort(perm.begin() + beg, perm.begin() + end, RowLongerThan(row.data()));
+  }
+  _slot.resize(_n_rows);
+  for (unsigned int i = 0; i < _n_rows; ++i)
+    _slot[perm[i]] = i;
+
+  // chunks
+  _chunk_start.resize(n_chunks + 1, 0);
+  _chunk_width.resize(n_chunks, 0);
+  for (unsigned int c = 0; c < n_chunks; ++c)
+  {
+    for (unsigned int lane = 0; lane < CHUNK; ++lane)
+    {
+      const int r = perm[c * CHUNK + lane];
+      if (r >= 0)
+        _chunk_width[c] = std::max(_chunk_width[c], (unsigned int)(row[r + 1] - row[r]));
+    }
+    _chunk_start[c + 1] = _chunk_start[c] + _chunk_width[c] * CHUNK;
+  }
+
+  // entries. the padding entries are zeros referring to the row itself
+  // (or to the first row for the padding rows), so they are always valid
+  const unsigned int n_entries = _chunk_start[n_chunks];
+  std::vector<int32_t> sell_col(n_entries, 0);
+  std::vector<double> a_values(n_entries, 0.), b_values(lumped ? 0 : n_entries, 0.);
+  for (unsigned int c = 0; c < n_chunks; ++c)
+  {
+    for (unsigned int lane = 0; lane < CHUNK; ++lane)
+    {
+      const int r = perm[c * CHUNK + lane];
+      for (unsigned int k = 0; k < _chunk_width[c]; ++k)
+      {
+        const unsigned int pos = _chunk_start[c] + k * CHUNK + lane;
+        if (r >= 0 && (int)k < row[r + 1] - row[r])
+        {
+          sell_col[pos] = col[row[r] + k];
+          a_values[pos] = csr._a_values[row[r] + k];
+          if (!lumped)
+            b_values[pos] = csr._b_values[row[r] + k];
+        }
+        else
+          sell_col[pos] = (r >= 0 ? r : 0);
+      }
+    }
+  }
+
+  _perm.assign(perm);
+  _col.assign(sell_col);
+  _a_values.assign(a_values);
+  _b_values.assign(b_values);
+  if (lumped)
+  {
+    _b_diag.assign(csr._b_values.data(), csr._b_values.size());
+    _inv_mass.assign(csr._inv_mass.data(), csr._inv_mass.size());
+  }
+}
+
+
+
+void SellLeapfrogOperator::apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const
+{
+  const double *u1_val, *u2_val, *f_val;
+  double *y_val;
+  VecGetArrayRead(u1, &u1_val);
+  VecGetArrayRead(u2, &u2_val);
+  VecGetArray(y, &y_val);
+  if (f == y)
+    f_val = y_val; // each row reads f before writing y, so it's safe
+  else
+    VecGetArrayRead(f, &f_val);
+
+  apply_chunks(u1_val, u2_val, coef_f, f_val, y_val, 0, _chunk_width.size());
+
+  if (f != y)
+    VecRestoreArrayRead(f, &f_val);
+  VecRestoreArray(y, &y_val);
+  VecRestoreArrayRead(u2, &u2_val);
+  VecRestoreArrayRead(u1, &u1_val);
+}
+
+
+
+void SellLeapfrogOperator::apply_part(const double *u1, const double *u2, double coef_f, const double *f, double *y,
+                                      unsigned int part, unsigned int n_parts) const
+{
+  const unsigned int n_chunks = _chunk_width.size();
+  apply_chunks(u1, u2, coef_f, f, y, part_begin(n_chunks, part, n_parts), part_begin(n_chunks, part + 1, n_parts));
+}
+
+
+
+unsigned int SellLeapfrogOperator::row_part(unsigned int row, unsigned int n_parts) const
+{
+  return part_of(_slot[row] / CHUNK, _chunk_width.size(), n_parts);
+}
+
+
+
+void SellLeapfrogOperator::distribute(const NumaPlacement &placement, unsigned int n_parts)
+{
+  const bool lumped = !_inv_mass.empty();
+  const unsigned int n_chunks = _chunk_width.size();
+
+  NumaArray<int> perm;
+  NumaArray<int32_t> col;
+  NumaArray<double> a_values, b_values, b_diag, inv_mass;
+  perm.allocate(_perm.size(), placement.huge_pages());
+  col.allocate(_col.size(), placement.huge_pages());
+  a_values.allocate(_a_values.size(), placement.huge_pages());
+  b_values.allocate(_b_values.size(), placement.huge_pages());
+  b_diag.allocate(_b_diag.size(), placement.huge_pages());
+  inv_mass.allocate(_inv_mass.size(), placement.huge_pages());
+
+#if defined(_OPENMP)
+  #pragma omp parallel num_threads(n_parts)
+#endif
+  {
+#if defined(_OPENMP)
+    placement.pin_thread(omp_get_thread_num()); // a failure is reported by the time loop pinning the threads again
+    #pragma omp for schedule(static, 1)
+#endif
+    for (int part = 0; part < (int)n_parts; ++part)
+    {
+      const unsigned int chunk_beg = part_begin(n_chunks, part, n_parts);
+      const unsigned int chunk_end = part_begin(n_chunks, part + 1, n_parts);
+      perm.copy_range(_perm, chunk_beg * CHUNK, chunk_end * CHUNK);
+      col.copy_range(_col, _chunk_start[chunk_beg], _chunk_start[chunk_end]);
+      a_values.copy_range(_a_values, _chunk_start[chunk_beg], _chunk_start[chunk_end]);
+      b_values.copy_range(_b_values, _chunk_start[chunk_beg], _chunk_start[chunk_end]);
+      if (lumped) // the rows of the chunks are permuted only inside the windows, so they are close
+      {
+        for (unsigned int slot = chunk_beg * CHUNK; slot < chunk_end * CHUNK; ++slot)
+        {
+          const int r = _perm[slot];
+          if (r >= 0)
+          {
+            b_diag[r] = _b_diag[r];
+            inv_mass[r] = _inv_mass[r];
+          }
+        }
+      }
+    }
+  }
+
+  _perm.swap(perm);
+  _col.swap(col);
+  _a_values.swap(a_values);
+  _b_values.swap(b_values);
+  _b_diag.swap(b_diag);
+  _inv_mass.swap(inv_mass);
+}
+
+
+
+void SellLeapfrogOperator::apply_chunks(const double *u1_val, const double *u2_val, double coef_f, const double *f_val, double *y_val,
+                                        unsigned int chunk_beg, unsigned int chunk_end) const
+{
+  const bool lumped = !_inv_mass.empty();
+
+  for (unsigned int c = chunk_beg; c < chunk_end; ++c)
+  {
+    const int32_t *__restrict__ col = &_col[_chunk_start[c]];
+    const double *__restrict__ a_val = &_a_values[_chunk_start[c]];
+
+    double sum[CHUNK];
+    for (unsigned int lane = 0; lane < CHUNK; ++lane)
+      sum[lane] = 0.;
+
+    if (lumped)
+    {
+      for (unsigned int k = 0; k < _chunk_width[c]; ++k, col += CHUNK, a_val += CHUNK)
+        for (unsigned int lane = 0; lane < CHUNK; ++lane)
+          sum[lane] += a_val[lane] * u1_val[col[lane]];
+    }
+    else
+    {
+      const double *__restrict__ b_val = &_b_values[_chunk_start[c]];
+      for (unsigned int k = 0; k < _chunk_width[c]; ++k, col += CHUNK, a_val += CHUNK, b_val += CHUNK)
+        for (unsigned int lane = 0; lane < CHUNK; ++lane)
+          sum[lane] += a_val[lane] * u1_val[col[lane]] + b_val[lane] * u2_val[col[lane]];
+    }
+
+    const int *perm = &_perm[c * CHUNK];
+    for (unsigned int lane = 0; lane < CHUNK; ++lane)
+    {
+      const int r = perm[lane];
+      if (r < 0) // padding row
+        continue;
+      if (lumped)
+        y_val[r] = (coef_f * f_val[r] + _b_diag[r] * u2_val[r] + sum[lane]) * _inv_mass[r];
+      else
+        y_val[r] = coef_f * f_val[r] + sum[lane];
+    }
+  }
+}
+
+
+
+unsigned int SellLeapfrogOperator::order() const
+{
+  return _n_rows;
+}
+
+
+
+double SellLeapfrogOperator::fill_ratio() const
+{
+  return (_nnz == 0 ? 1. : double(_col.size()) / _nnz);
+}
+
+
+
+GhostedLeapfrogOperator::GhostedLeapfrogOperator(Mat mass_mat, Mat stiff_mat, const std::vector<int> &ghosts,
+                                                 double a_mass, double a_stiff,
+                                                 double b_mass, double b_stiff,
+                                                 Vec mass_diag)
+{
+  const bool lumped = (mass_diag != NULL);
+  require(!(lumped && b_stiff != 0.), "The operator B must be diagonal in case of lumped mass matrix");
+  require(std::adjacent_find(ghosts.begin(), ghosts.end(), std::greater_equal<int>()) == ghosts.end(),
+          "The ghost dofs must be sorted in ascending order");
+
+  PetscInt first_row, last_row;
+  MatGetOwnershipRange(mass_mat, &first_row, &last_row);
+  const unsigned int n_rows = last_row - first_row;
+
+  const double *m_diag = NULL;
+  if (lumped)
+  {
+    VecGetArrayRead(mass_diag, &m_diag);
+    _b_values.resize(n_rows);
+    _inv_mass.resize(n_rows);
+  }
+
+  _row.resize(n_rows + 1, 0);
+  _halo_row.push_back(0);
+
+  for (unsigned int i = 0; i < n_rows; ++i)
+  {
+    const PetscInt global_row = first_row + i;
+    PetscInt m_ncols, k_ncols;
+    const PetscInt *m_cols, *k_cols;
+    const PetscScalar *m_vals, *k_vals;
+    MatGetRow(mass_mat, global_row, &m_ncols, &m_cols, &m_vals);
+    MatGetRow(stiff_mat, global_row, &k_ncols, &k_cols, &k_vals);
+    require(m_ncols == k_ncols, "Mass and stiffness matrices have different sparse structure (row " + d2s(global_row) + ")");
+
+    for (PetscInt k = 0; k < m_ncols; ++k)
+    {
+      require(m_cols[k] == k_cols[k], "Mass and stiffness matrices have different sparse structure (row " + d2s(global_row) + ")");
+
+      double a_value, b_value = 0.;
+      if (lumped) // mass matrix acts on the diagonal only
+        a_value = a_mass * (m_cols[k] == global_row ? m_diag[i] : 0.) + a_stiff * k_vals[k];
+      else
+      {
+        a_value = a_mass * m_vals[k] + a_stiff * k_vals[k];
+        b_value = b_mass * m_vals[k] + b_stiff * k_vals[k];
+      }
+
+      if (m_cols[k] >= first_row && m_cols[k] < last_row) // local column
+      {
+        _col.push_back(m_cols[k] - first_row);
+        _a_values.push_back(a_value);
+        if (!lumped)
+          _b_values.push_back(b_value);
+      }
+      else // ghost column
+      {
+        const std::vector<int>::const_iterator ghost = std::lower_bound(ghosts.begin(), ghosts.end(), m_cols[k]);
+        require(ghost != ghosts.end() && *ghost == m_cols[k],
+                "The column " + d2s(m_cols[k]) + " of the row " + d2s(global_row) + " is not a ghost of the vectors");
+        if (_halo_rows.empty() || _halo_rows.back() != (int)i)
+        {
+          _halo_rows.push_back(i);
+          _halo_row.push_back(_halo_row.back());
+        }
+        _halo_col.push_back(ghost - ghosts.begin());
+        _halo_a_values.push_back(a_value);
+        if (!lumped)
+          _halo_b_values.push_back(b_value);
+        ++_halo_row.back();
+      }
+    }
+    _row[i + 1] = _col.size();
+
+    MatRestoreRow(stiff_mat, global_row, &k_ncols, &k_cols, &k_vals);
+    MatRestoreRow(mass_mat, global_row, &m_ncols, &m_cols, &m_vals);
+
+    if (lumped)
+    {
+      _b_values[i] = b_mass * m_diag[i];
+      _inv_mass[i] = 1. / m_diag[i];
+    }
+  }
+
+  if (lumped)
+    VecRestoreArrayRead(mass_diag, &m_diag);
+}
+
+
+
+void GhostedLeapfrogOperator::apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const
+{
+  const bool lumped = !_inv_mass.empty();
+  const unsigned int n_rows = order();
+
+  // the exchange of the ghost values goes while the local part is computed.
+  // in case of lumped mass matrix B is diagonal, so the ghosts of u2 are not required
+  VecGhostUpdateBegin(u1, INSERT_VALUES, SCATTER_FORWARD);
+  if (!lumped)
+    VecGhostUpdateBegin(u2, INSERT_VALUES, SCATTER_FORWARD);
+
+  const double *u1_val, *u2_val, *f_val;
+  double *y_val;
+  VecGetArrayRead(u1, &u1_val);
+  VecGetArrayRead(u2, &u2_val);
+  VecGetArray(y, &y_val);
+  if (f == y)
+    f_val = y_val; // each row reads f before writing y, so it's safe
+  else
+    VecGetArrayRead(f, &f_val);
+
+  // the local part. the rows without halo entries are finished here
+  unsigned int h = 0; // the next row with halo entries
+  for (unsigned int i = 0; i < n_rows; ++i)
+  {
+    double sum = coef_f * f_val[i];
+    if (lumped)
+    {
+      sum += _b_values[i] * u2_val[i];
+      for (int k = _row[i]; k < _row[i + 1]; ++k)
+        sum += _a_values[k] * u1_val[_col[k]];
+    }
+    else
+    {
+      for (int k = _row[i]; k < _row[i + 1]; ++k)
+        sum += _a_values[k] * u1_val[_col[k]] + _b_values[k] * u2_val[_col[k]];
+    }
+
+    if (h < _halo_rows.size() && _halo_rows[h] == (int)i)
+    {
+      y_val[i] = sum; // it's finished below
+      ++h;
+    }
+    else
+      y_val[i] = (lumped ? sum * _inv_mass[i] : sum);
+  }
+
+  if (f != y)
+    VecRestoreArrayRead(f, &f_val);
+  VecRestoreArrayRead(u2, &u2_val);
+  VecRestoreArrayRead(u1, &u1_val);
+
+  VecGhostUpdateEnd(u1, INSERT_VALUES, SCATTER_FORWARD);
+  if (!lumped)
+    VecGhostUpdateEnd(u2, INSERT_VALUES, SCATTER_FORWARD);
+
+  // the halo part. the ghost values go after the owned ones in the local form of the vectors
+  if (!_halo_rows.empty())
+  {
+    Vec u1_local, u2_local;
+    VecGhostGetLocalForm(u1, &u1_local);
+    VecGhostGetLocalForm(u2, &u2_local);
+    require(u1_local != NULL && u2_local != NULL, "The vectors must be ghosted");
+    VecGetArrayRead(u1_local, &u1_val);
+    VecGetArrayRead(u2_local, &u2_val);
+    const double *u1_ghost = u1_val + n_rows;
+    const double *u2_ghost = u2_val + n_rows;
+
+    for (unsigned int r = 0; r < _halo_rows.size(); ++r)
+    {
+      const int i = _halo_rows[r];
+      double sum = y_val[i];
+      if (lumped)
+      {
+        for (int k = _halo_row[r]; k < _halo_row[r + 1]; ++k)
+          sum += _halo_a_values[k] * u1_ghost[_halo_col[k]];
+        y_val[i] = sum * _inv_mass[i];
+      }
+      else
+      {
+        for (int k = _halo_row[r]; k < _halo_row[r + 1]; ++k)
+          sum += _halo_a_values[k] * u1_ghost[_halo_col[k]] + _halo_b_values[k] * u2_ghost[_halo_col[k]];
+        y_val[i] = sum;
+      }
+    }
+
+    VecRestoreArrayRead(u2_local, &u2_val);
+    VecRestoreArrayRead(u1_local, &u1_val);
+    VecGhostRestoreLocalForm(u2, &u2_local);
+    VecGhostRestoreLocalForm(u1, &u1_local);
+  }
+
+  VecRestoreArray(y, &y_val);
+}
+
+
+
+unsigned int GhostedLeapfrogOperator::order() const
+{
+  return _row.size() - 1;
+}
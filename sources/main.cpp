@@ -1,6 +1,8 @@
 #include "config.h"
 #include "parameters.h"
 #include "acoustic2d.h"
+#include "coefficients_file.h"
+#include "solution_file.h"
 #include "testing.h"
 #include <iostream>
 #include <boost/timer/timer.hpp>
@@ -30,8 +32,33 @@ int main(int argc, char **argv)
   std::cout << param.print() << std::endl;
 //#endif
 
+  if (param.COEF_CONVERT_FILE != "") // only conversion of the coefficients file is required
+  {
+    CoefficientsFile::convert(param.COEF_FILE, param.COEF_CONVERT_FILE, param.N_FINE_X, param.N_FINE_Y);
+    std::cout << "coefficients file " << param.COEF_FILE << " is converted to " << param.COEF_CONVERT_FILE << std::endl;
+    PetscFinalize();
+    return 0;
+  }
+
+  if (param.SOL_EXTRACT_FILE != "") // only extraction of the binary solution file is required
+  {
+    const std::string out_dir = boost::filesystem::path(param.SOL_EXTRACT_FILE).parent_path().string();
+    const uint64_t n_snapshots = SolutionFile::extract(param.SOL_EXTRACT_FILE, (out_dir == "" ? "." : out_dir));
+    std::cout << n_snapshots << " solutions of the file " << param.SOL_EXTRACT_FILE << " are extracted" << std::endl;
+    PetscFinalize();
+    return 0;
+  }
+
   Acoustic2D problem(&param);
-  problem.solve_triangles();
+  if (param.RECT_GRID)
+  {
+    if (param.DISTRIBUTED)
+      problem.solve_rectangles_distributed();
+    else
+      problem.solve_rectangles();
+  }
+  else
+    problem.solve_triangles();
 
   PetscFinalize();
 
@@ -0,0 +1,168 @@
+#include "mesh_partition.h"
+#include "fem/auxiliary_functions.h"
+#include <algorithm>
+
+
+MeshPartition::MeshPartition(const fem::FineMesh &fmesh, const fem::CSRPattern &csr_pattern,
+                             unsigned int rank, unsigned int n_ranks)
+  : _rank(rank),
+    _n_ranks(n_ranks),
+    _from_mesh_file(false),
+    _first_dof(0),
+    _n_owned_dofs(0)
+{
+  const unsigned int n_dofs = csr_pattern.order();
+  require(_rank < _n_ranks, "The rank " + d2s(_rank) + " is out of the range of the ranks (" + d2s(_n_ranks) + ")");
+  require(_n_ranks <= n_dofs, "There are more processes (" + d2s(_n_ranks) + ") than the dofs (" + d2s(n_dofs) + ")");
+
+  _from_mesh_file = tagged_partition(fmesh.triangles(), n_dofs, _n_ranks, _owners);
+  if (!_from_mesh_file)
+    _owners = graph_partition(csr_pattern, _n_ranks);
+  for (unsigned int d = 0; d < n_dofs; ++d)
+    require(_owners[d] >= 0 && _owners[d] < (int)_n_ranks, "The dof " + d2s(d) + " doesn't belong to any cell");
+
+  // the dofs are numbered process by process keeping their order
+  std::vector<unsigned int> next_dof(_n_ranks + 1, 0);
+  for (unsigned int d = 0; d < n_dofs; ++d)
+    ++next_dof[_owners[d] + 1];
+  for (unsigned int r = 0; r < _n_ranks; ++r)
+    next_dof[r + 1] += next_dof[r];
+  _first_dof = next_dof[_rank];
+  _n_owned_dofs = next_dof[_rank + 1] - next_dof[_rank];
+
+  std::vector<int> new_dofs(n_dofs);
+  for (unsigned int d = 0; d < n_dofs; ++d)
+    new_dofs[d] = next_dof[_owners[d]]++;
+  _renumbering = DoFRenumbering(new_dofs);
+
+  // the ghosts are the columns of the owned rows owned by other processes
+  for (unsigned int d = 0; d < n_dofs; ++d)
+  {
+    if (_owners[d] != (int)_rank)
+      continue;
+    for (unsigned int k = csr_pattern.row(d); k < csr_pattern.row(d + 1); ++k)
+      if (_owners[csr_pattern.col(k)] != (int)_rank)
+        _ghosts.push_back(_renumbering.new_dof(csr_pattern.col(k)));
+  }
+  std::sort(_ghosts.begin(), _ghosts.end());
+  _ghosts.erase(std::unique(_ghosts.begin(), _ghosts.end()), _ghosts.end());
+
+  const std::vector<int> &b_vertices = fmesh.boundary_vertices();
+  for (unsigned int i = 0; i < b_vertices.size(); ++i)
+    if (owns_dof(b_vertices[i]))
+      _boundary_dofs.push_back(b_vertices[i]);
+}
+
+
+
+unsigned int MeshPartition::rank() const { return _rank; }
+unsigned int MeshPartition::n_ranks() const { return _n_ranks; }
+unsigned int MeshPartition::n_dofs() const { return _owners.size(); }
+unsigned int MeshPartition::first_dof() const { return _first_dof; }
+unsigned int MeshPartition::n_owned_dofs() const { return _n_owned_dofs; }
+std::vector<int> MeshPartition::ghost_dofs() const { return _ghosts; }
+unsigned int MeshPartition::global_dof(unsigned int local_dof) const { return _renumbering.new_dof(local_dof); }
+bool MeshPartition::owns_dof(unsigned int local_dof) const { return (_owners[local_dof] == (int)_rank); }
+std::vector<int> MeshPartition::boundary_dofs() const { return _boundary_dofs; }
+bool MeshPartition::from_mesh_file() const { return _from_mesh_file; }
+unsigned int MeshPartition::owner(unsigned int dof) const { return _owners[dof]; }
+const DoFRenumbering& MeshPartition::renumbering() const { return _renumbering; }
+
+
+
+bool MeshPartition::local_cell(const fem::MeshElement &cell) const
+{
+  for (unsigned int i = 0; i < cell.n_dofs(); ++i)
+    if (owns_dof(cell.dof(i)))
+      return true;
+  return false;
+}
+
+
+
+std::vector<int> MeshPartition::graph_partition(const fem::CSRPattern &csr_pattern, unsigned int n_parts)
+{
+  const unsigned int n_dofs = csr_pattern.order();
+  require(n_parts > 0 && n_parts <= n_dofs, "The graph of " + d2s(n_dofs) + " vertices can't be split into " + d2s(n_parts) + " parts");
+
+  // the pieces of the graph to be split: the vertices of the piece p are the vertices v with pieces[v] == p.
+  // the piece p is split into the parts [first_part[p], first_part[p] + piece_parts[p])
+  std::vector<int> pieces(n_dofs, 0);
+  std::vector<unsigned int> first_part(1, 0), piece_parts(1, n_parts);
+  std::vector<std::vector<int> > piece_vertices(1, std::vector<int>(n_dofs));
+  for (unsigned int d = 0; d < n_dofs; ++d)
+    piece_vertices[0][d] = d;
+
+  std::vector<int> parts(n_dofs, 0);
+  std::vector<int> visited(n_dofs, -1);
+  int mark = 0; // the mark of the current search
+  std::vector<int> order, probe;
+
+  for (unsigned int piece = 0; piece < piece_vertices.size(); ++piece)
+  {
+    std::vector<int> vertices;
+    vertices.swap(piece_vertices[piece]); // the vertices are not required after the splitting
+
+    if (piece_parts[piece] == 1)
+    {
+      for (unsigned int i = 0; i < vertices.size(); ++i)
+        parts[vertices[i]] = first_part[piece];
+      continue;
+    }
+
+    // the order of the breadth-first search over all connected components of the piece.
+    // each component is searched from the last vertex reached by the probe search,
+    // which is a pseudo-peripheral vertex
+    order.clear();
+    const int piece_mark = ++mark;
+    for (unsigned int i = 0; i < vertices.size(); ++i)
+    {
+      if (visited[vertices[i]] == piece_mark)
+        continue;
+      probe.clear();
+      breadth_first_search(csr_pattern, pieces, piece, vertices[i], visited, ++mark, probe);
+      breadth_first_search(csr_pattern, pieces, piece, probe.back(), visited, piece_mark, order);
+    }
+    expect(order.size() == vertices.size(), "The search didn't reach all vertices of the piece");
+
+    // the piece is split in proportion to the number of parts of its halves
+    const unsigned int n_left = piece_parts[piece] / 2;
+    const unsigned int cut = (unsigned long long)order.size() * n_left / piece_parts[piece];
+    for (unsigned int half = 0; half < 2; ++half)
+    {
+      const unsigned int beg = (half == 0 ? 0 : cut);
+      const unsigned int end = (half == 0 ? cut : order.size());
+      const int new_piece = piece_vertices.size();
+      piece_vertices.push_back(std::vector<int>(order.begin() + beg, order.begin() + end));
+      first_part.push_back(first_part[piece] + (half == 0 ? 0 : n_left));
+      piece_parts.push_back(half == 0 ? n_left : piece_parts[piece] - n_left);
+      for (unsigned int i = beg; i < end; ++i)
+        pieces[order[i]] = new_piece;
+    }
+  }
+
+  return parts;
+}
+
+
+
+void MeshPartition::breadth_first_search(const fem::CSRPattern &csr_pattern, const std::vector<int> &pieces, int piece,
+                                         int start, std::vector<int> &visited, int mark, std::vector<int> &order)
+{
+  unsigned int head = order.size();
+  order.push_back(start);
+  visited[start] = mark;
+  while (head < order.size())
+  {
+    const int vertex = order[head++];
+    for (unsigned int k = csr_pattern.row(vertex); k < csr_pattern.row(vertex + 1); ++k)
+    {
+      const int neighbour = csr_pattern.col(k);
+      if (pieces[neighbour] == piece && visited[neighbour] != mark)
+      {
+        visited[neighbour] = mark;
+        order.push_back(neighbour);
+      }
+    }
+  }
+}
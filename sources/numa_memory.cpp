@@ -0,0 +1,98 @@
+#include "numa_memory.h"
+#include "fem/auxiliary_functions.h"
+#include <cstdlib>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+NumaPlacement::NumaPlacement()
+  : _huge_pages(false)
+{ }
+
+
+
+NumaPlacement::NumaPlacement(const std::string &pin_map, bool huge_pages)
+  : _cores(parse_cores(pin_map)),
+    _huge_pages(huge_pages)
+{
+  if (_cores.empty())
+    return;
+
+  // the cores the process is allowed to run on (taskset, cgroups, the batch system)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  require(sched_getaffinity(0, sizeof(allowed), &allowed) == 0, "The cores available to the process cannot be obtained");
+  for (unsigned int i = 0; i < _cores.size(); ++i)
+    require(CPU_ISSET(_cores[i], &allowed), "The core " + d2s(_cores[i]) + " of the pinning map " + pin_map +
+            " is not available to the process");
+}
+
+
+
+bool NumaPlacement::huge_pages() const
+{
+  return _huge_pages;
+}
+
+
+
+bool NumaPlacement::pin_thread(unsigned int thread) const
+{
+  if (_cores.empty())
+    return true;
+
+  const int core = _cores[thread % _cores.size()];
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(core, &cpu_set);
+  return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0; // 0 means the calling thread
+}
+
+
+
+std::vector<int> NumaPlacement::parse_cores(const std::string &pin_map)
+{
+  std::vector<int> cores;
+  size_t beg = 0;
+  while (beg < pin_map.size())
+  {
+    size_t end = pin_map.find(',', beg);
+    if (end == std::string::npos)
+      end = pin_map.size();
+    const std::string range = pin_map.substr(beg, end - beg);
+    require(!range.empty(), "Empty range of cores in the pinning map " + pin_map);
+
+    const size_t dash = range.find('-');
+    const int first = atoi(range.substr(0, dash).c_str());
+    const int last = (dash == std::string::npos ? first : atoi(range.substr(dash + 1).c_str()));
+    require(first >= 0 && first <= last && last < CPU_SETSIZE, "Incorrect range of cores '" + range + "' in the pinning map " + pin_map);
+    for (int core = first; core <= last; ++core)
+      cores.push_back(core);
+
+    beg = end + 1;
+  }
+  return cores;
+}
+
+
+
+void* NumaPlacement::allocate(size_t n_bytes, bool huge_pages)
+{
+  // anonymous mapping is not touched until the first write,
+  // and it's always aligned by the page size
+  void *data = mmap(NULL, n_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  require(data != MAP_FAILED, "Cannot allocate " + d2s(n_bytes) + " bytes");
+#if defined(MADV_HUGEPAGE)
+  if (huge_pages)
+    madvise(data, n_bytes, MADV_HUGEPAGE); // it's just a hint, so the result is not checked
+#endif
+  return data;
+}
+
+
+
+void NumaPlacement::deallocate(void *data, size_t n_bytes)
+{
+  munmap(data, n_bytes);
+}
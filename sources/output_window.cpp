@@ -0,0 +1,115 @@
+#include "output_window.h"
+#include "fem/auxiliary_functions.h"
+#include <cmath>
+#include <algorithm>
+
+
+OutputWindow::OutputWindow(double x_beg, double x_end, double y_beg, double y_end,
+                           unsigned int nx, unsigned int ny,
+                           double win_x_beg, double win_x_end, double win_y_beg, double win_y_end,
+                           unsigned int stride)
+  : _nx(nx),
+    _ny(ny),
+    _x_beg(x_beg),
+    _y_beg(y_beg),
+    _hx((x_end - x_beg) / nx),
+    _hy((y_end - y_beg) / ny),
+    _col_beg(0),
+    _row_beg(0),
+    _n_cols(0),
+    _n_rows(0),
+    _stride(stride)
+{
+  require(_stride > 0, "The stride of the output must be positive");
+
+  // the vertices lying on the borders of the window (up to the round-off) are inside it
+  const double tol = 1e-8;
+  const double col_beg = std::max(0., std::ceil((win_x_beg - x_beg) / _hx - tol));
+  const double col_end = std::min((double)_nx, std::floor((win_x_end - x_beg) / _hx + tol));
+  const double row_beg = std::max(0., std::ceil((win_y_beg - y_beg) / _hy - tol));
+  const double row_end = std::min((double)_ny, std::floor((win_y_end - y_beg) / _hy + tol));
+  require(col_end >= col_beg && row_end >= row_beg, "There are no vertices of the grid in the output window [" +
+          d2s(win_x_beg) + ", " + d2s(win_x_end) + "] x [" + d2s(win_y_beg) + ", " + d2s(win_y_end) + "]");
+
+  _col_beg = col_beg;
+  _row_beg = row_beg;
+  _n_cols = ((unsigned int)col_end - _col_beg) / _stride + 1;
+  _n_rows = ((unsigned int)row_end - _row_beg) / _stride + 1;
+  require(_n_cols > 1 && _n_rows > 1, "The output window must have at least two vertices in each direction");
+}
+
+
+
+unsigned int OutputWindow::n_cols() const { return _n_cols; }
+unsigned int OutputWindow::n_rows() const { return _n_rows; }
+unsigned int OutputWindow::n_vertices() const { return _n_cols * _n_rows; }
+unsigned int OutputWindow::col_beg() const { return _col_beg; }
+unsigned int OutputWindow::row_beg() const { return _row_beg; }
+unsigned int OutputWindow::stride() const { return _stride; }
+double OutputWindow::x_beg() const { return _x_beg + _col_beg * _hx; }
+double OutputWindow::y_beg() const { return _y_beg + _row_beg * _hy; }
+double OutputWindow::hx() const { return _stride * _hx; }
+double OutputWindow::hy() const { return _stride * _hy; }
+
+
+
+bool OutputWindow::whole_grid() const
+{
+  return _stride == 1 && _col_beg == 0 && _row_beg == 0 && _n_cols == _nx + 1 && _n_rows == _ny + 1;
+}
+
+
+
+void OutputWindow::select_rows(unsigned int vrow_beg, unsigned int vrow_end, unsigned int &first, unsigned int &n) const
+{
+  // the selected rows are _row_beg + j * _stride, j = 0, ..., _n_rows - 1
+  first = (vrow_beg <= _row_beg ? 0 : (vrow_beg - _row_beg + _stride - 1) / _stride);
+  const unsigned int last = (vrow_end <= _row_beg ? 0 : std::min(_n_rows, (vrow_end - _row_beg + _stride - 1) / _stride));
+  n = (last > first ? last - first : 0);
+}
+
+
+
+std::vector<unsigned int> OutputWindow::vertices(unsigned int vrow_beg, unsigned int vrow_end, unsigned int first_vrow) const
+{
+  unsigned int first, n;
+  select_rows(vrow_beg, vrow_end, first, n);
+  require(n == 0 || _row_beg + first * _stride >= first_vrow, "The selected rows are out of the values");
+
+  std::vector<unsigned int> positions;
+  positions.reserve(n * _n_cols);
+  for (unsigned int j = first; j < first + n; ++j)
+  {
+    const unsigned int row = _row_beg + j * _stride - first_vrow;
+    for (unsigned int i = 0; i < _n_cols; ++i)
+      positions.push_back(row * (_nx + 1) + _col_beg + i * _stride);
+  }
+  return positions;
+}
+
+
+
+std::vector<unsigned int> OutputWindow::cells(unsigned int vrow_beg, unsigned int vrow_end, unsigned int first_cell_row) const
+{
+  unsigned int first, n;
+  select_rows(vrow_beg, vrow_end, first, n);
+  require(n == 0 || _row_beg + first * _stride >= first_cell_row, "The selected rows are out of the values");
+
+  std::vector<unsigned int> positions;
+  for (unsigned int j = first; j + 1 < first + n; ++j) // the coarse cells between the selected rows
+  {
+    const unsigned int row = _row_beg + j * _stride - first_cell_row;
+    for (unsigned int i = 0; i + 1 < _n_cols; ++i)
+      positions.push_back(row * _nx + _col_beg + i * _stride);
+  }
+  return positions;
+}
+
+
+
+void OutputWindow::gather(const double *values, const std::vector<unsigned int> &positions, std::vector<double> &selected)
+{
+  selected.resize(positions.size());
+  for (unsigned int i = 0; i < positions.size(); ++i)
+    selected[i] = values[positions[i]];
+}
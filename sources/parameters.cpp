@@ -4,6 +4,7 @@
 #include "boost/program_options.hpp"
 #include "boost/filesystem.hpp"
 #include <iostream>
+#include <mpi.h>
 
 namespace po = boost::program_options;
 
@@ -39,6 +40,9 @@ void Parameters::default_parameters()
   SAVE_COEF_PER_CELL = false;
   SAVE_COEF_PER_VERT = false;
   COEF_SAVED_PER_VERT = false;
+  COEF_BINARY = false; // text format by default
+  COEF_CONVERT_FILE = ""; // no conversion by default
+  COEF_CACHE = true; // the distribution according to layers file is cached by default
 
   RES_TOP_DIR = "../results/"; // this top level directory containing all results usually exists on the same level as 'build', 'sources', 'headers' directories
   RES_DIR = ""; // should be changed and based on some parameters
@@ -46,10 +50,23 @@ void Parameters::default_parameters()
   SOL_DIR = "sol/"; // should be added to RES_DIR after generating of the latter
   TIME_FILE = "time.txt"; // should be added to RES_DIR after generating of the latter
   INFO_FILE = "info.txt"; // should be added to RES_DIR after generating of the latter
+  SEISMOGRAM_FILE = "receivers.sgy"; // should be added to RES_DIR after generating of the latter
 
   MESH_FILE = "mesh.msh";  // should be added to MESH_DIR after establishing of the latter (means that MESH_DIR can be changed from parameter file of command line)
 
   TIME_SCHEME = EXPLICIT;
+  MASS_LUMPING = false; // consistent mass matrix by default
+  MATRIX_FREE = false; // assembled matrices by default
+  N_THREADS = 0; // all available threads
+  THREADED_LOOP = false; // sequential time loop by default
+  PIN_MAP = ""; // the threads are not pinned by default
+  HUGE_PAGES = false;
+  DISTRIBUTED = false; // one process solves the whole problem by default
+  RECT_GRID = false; // triangular mesh by default
+  SYMMETRIC_STORAGE = false; // full matrices by default
+  SELL_FORMAT = false; // CSR format by default
+  SPMV_BENCHMARK = 0; // no benchmark by default
+  DOF_ORDERING = NATURAL_ORDERING;
   X_BEG = Y_BEG = 0.;
   X_END = Y_END = 1.;
   N_FINE_X = N_FINE_Y = 1;
@@ -71,10 +88,22 @@ void Parameters::default_parameters()
   COEF_B_VALUES.resize(N_SUBDOMAINS, 1.);
 
   PRINT_VTU = 0; // don't print .vtu files by default
+  VTK_BINARY = 0; // .vts files by default
   SAVE_SOL = 0; // don't print .sol files by default
   PRINT_INFO = 0; // don't print an information to console on each time step
   VTU_STEP = 1; // print the .vtu file on each time step
   SOL_STEP = 1; // save the .dat file with solution on each time step
+  SOL_FORMAT = TEXT_SOLUTION;
+  SOL_EXTRACT_FILE = ""; // no extraction by default
+  OUT_X_BEG = X_BEG; // the output window is the whole domain by default
+  OUT_X_END = X_END;
+  OUT_Y_BEG = Y_BEG;
+  OUT_Y_END = Y_END;
+  OUT_STRIDE = 1; // every vertex is saved
+  RECEIVERS_FILE = ""; // no receivers by default
+  RECEIVER_LINES = "";
+  IO_THREADS = 0; // the results are written synchronously by default
+  IO_BUFFERS = 2; // double buffering
   EXPORT_COEFFICIENTS = 0; // there is no export by default
 }
 
@@ -83,6 +112,8 @@ void Parameters::default_parameters()
 void Parameters::read_from_command_line(int argc, char **argv)
 {
   std::string time_scheme = (TIME_SCHEME == EXPLICIT ? "explicit" : "crank-nicolson");
+  const std::string dof_ordering_name[] = { "natural", "rcm", "morton", "tiled" };
+  const std::string sol_format_name[] = { "text", "bin", "bin32" };
 
   po::options_description desc("Allowed options");
   desc.add_options()
@@ -96,6 +127,9 @@ void Parameters::read_from_command_line(int argc, char **argv)
     ("savcocel", po::value<bool>(),         std::string("need to save coefficients distribution (one coef per cell) to a file? (" + d2s(SAVE_COEF_PER_CELL) + ")").c_str())
     ("savcover", po::value<bool>(),         std::string("need to save coefficients distribution (one coef per vertex) to a file? (" + d2s(SAVE_COEF_PER_VERT) + ")").c_str())
     ("cosavedv", po::value<bool>(),         std::string("is coefficients distribution already saved (one coef per vertex)? (" + d2s(COEF_SAVED_PER_VERT) + ")").c_str())
+    ("cobin",    po::value<bool>(),         std::string("save coefficients distribution in binary format (" + d2s(COEF_BINARY) + ")").c_str())
+    ("coconv",   po::value<std::string>(),  std::string("convert coefficients file (text <-> binary) into this file and exit (" + COEF_CONVERT_FILE + ")").c_str())
+    ("cocache",  po::value<bool>(),         std::string("cache coefficients distribution according to layers file in coefdir (" + d2s(COEF_CACHE) + ")").c_str())
     ("lafile",   po::value<std::string>(),  std::string("name of file with parameters of layers (" + LAYERS_FILE + ")").c_str())
     ("lasuf",    po::value<std::string>(),  std::string("suffix to distinguish several layers files when we create them (" + LAYERS_FILE_SUFFIX + ")").c_str())
     ("lacrebin", po::value<bool>(),         std::string("create (1) or don't (0) a new binary layers file (" + d2s(CREATE_BIN_LAYERS_FILE) + ")").c_str())
@@ -104,6 +138,18 @@ void Parameters::read_from_command_line(int argc, char **argv)
     ("useave",   po::value<bool>(),         std::string("use averaged coefficients where possible (" + d2s(USE_AVERAGED) + ")").c_str())
     ("hlayer",   po::value<double>(),       std::string("thickness of one binary layer in percent (" + d2s(H_BIN_LAYER_PERCENT) + ")").c_str())
     ("scheme",   po::value<std::string>(),  std::string("time scheme (" + time_scheme + ")").c_str())
+    ("lumping",  po::value<bool>(),         std::string("use lumped mass matrix in explicit scheme (" + d2s(MASS_LUMPING) + ")").c_str())
+    ("mfree",    po::value<bool>(),         std::string("apply matrix-free operators on rectangular grid in explicit scheme (" + d2s(MATRIX_FREE) + ")").c_str())
+    ("symm",     po::value<bool>(),         std::string("keep symmetric matrices in upper triangular form (" + d2s(SYMMETRIC_STORAGE) + ")").c_str())
+    ("sell",     po::value<bool>(),         std::string("apply assembled matrices in SELL-C-sigma format in explicit and Crank-Nicolson schemes (" + d2s(SELL_FORMAT) + ")").c_str())
+    ("spmvbench",po::value<unsigned int>(), std::string("number of runs to benchmark sparse formats (0 - no benchmark) (" + d2s(SPMV_BENCHMARK) + ")").c_str())
+    ("renum",    po::value<std::string>(),  std::string("ordering of dofs: natural, rcm, morton, tiled (" + dof_ordering_name[DOF_ORDERING] + ")").c_str())
+    ("nthreads", po::value<unsigned int>(), std::string("number of threads for assembling and threaded time loop (0 - all available) (" + d2s(N_THREADS) + ")").c_str())
+    ("tloop",    po::value<bool>(),         std::string("execute the time loop of the explicit lumped scheme by several threads (" + d2s(THREADED_LOOP) + ")").c_str())
+    ("pin",      po::value<std::string>(),  std::string("cores for the threads of the time loop, e.g. 0-15,32-47 (" + PIN_MAP + ")").c_str())
+    ("hugepages",po::value<bool>(),         std::string("use huge pages for the arrays of the threaded time loop (" + d2s(HUGE_PAGES) + ")").c_str())
+    ("distrib",  po::value<bool>(),         std::string("solve the problem by several MPI processes (" + d2s(DISTRIBUTED) + ")").c_str())
+    ("rect",     po::value<bool>(),         std::string("solve the problem on the rectangular grid instead of the triangular mesh (" + d2s(RECT_GRID) + ")").c_str())
     ("tend",     po::value<double>(),       std::string("time ending (" + d2s(TIME_END) + ")").c_str())
     ("tstep",    po::value<double>(),       std::string("time step (" + d2s(TIME_STEP) + ")").c_str())
     ("nt",       po::value<unsigned int>(), std::string("number of time steps (" + d2s(N_TIME_STEPS) + ")").c_str())
@@ -119,10 +165,22 @@ void Parameters::read_from_command_line(int argc, char **argv)
     ("sol",      po::value<bool>(),         std::string("whether we need to save .dat files with solutions (" + d2s(SAVE_SOL) + ")").c_str())
     ("inf",      po::value<bool>(),         std::string("whether we need to print some info during calculations (" + d2s(PRINT_INFO) + ")").c_str())
     ("expcoef",  po::value<bool>(),         std::string("whether we need to export coeff-s distribution with results (" + d2s(EXPORT_COEFFICIENTS) + ")").c_str())
+    ("vtkbin",   po::value<bool>(),         std::string("whether the results on the rectangular grid are binary .vti files with .pvd index (" + d2s(VTK_BINARY) + ")").c_str())
     ("vtu_step", po::value<unsigned int>(), std::string("if we need to print .vtu files then how often. every (vtu_step)-th file will be printed (" + d2s(VTU_STEP) + ")").c_str())
     ("sol_step", po::value<unsigned int>(), std::string("if we need to save .dat files then how often. every (sol_step)-th file will be saved (" + d2s(SOL_STEP) + ")").c_str())
+    ("solfmt",   po::value<std::string>(),  std::string("format of the saved solutions: text, bin, bin32 (" + sol_format_name[SOL_FORMAT] + ")").c_str())
+    ("solext",   po::value<std::string>(),  std::string("extract the binary solution file into .dat files in its directory and exit (" + SOL_EXTRACT_FILE + ")").c_str())
+    ("iothr",    po::value<unsigned int>(), std::string("number of threads writing the results in the background, 0 means synchronous output (" + d2s(IO_THREADS) + ")").c_str())
+    ("iobuf",    po::value<unsigned int>(), std::string("number of buffers for the snapshots of the background output (" + d2s(IO_BUFFERS) + ")").c_str())
     ("x1",       po::value<double>(),       std::string("X_END (" + d2s(X_END) + ")").c_str())
     ("y1",       po::value<double>(),       std::string("Y_END (" + d2s(Y_END) + ")").c_str())
+    ("outx0",    po::value<double>(),       "the left side of the output window (X_BEG)")
+    ("outx1",    po::value<double>(),       "the right side of the output window (X_END)")
+    ("outy0",    po::value<double>(),       "the bottom side of the output window (Y_BEG)")
+    ("outy1",    po::value<double>(),       "the top side of the output window (Y_END)")
+    ("outstride", po::value<unsigned int>(), std::string("every (outstride)-th vertex of the output window is saved in each direction (" + d2s(OUT_STRIDE) + ")").c_str())
+    ("recfile",  po::value<std::string>(),  std::string("text file with the points of the receivers, \"x y\" per line (" + RECEIVERS_FILE + ")").c_str())
+    ("reclines", po::value<std::string>(),  std::string("lines of the receivers \"x0,y0,x1,y1,n;...\" (" + RECEIVER_LINES + ")").c_str())
     ("nfx",      po::value<unsigned int>(), std::string("number of fine rectangular elements in x-direction (" + d2s(N_FINE_X) + ")").c_str())
     ("nfy",      po::value<unsigned int>(), std::string("number of fine rectangular elements in y-direction (" + d2s(N_FINE_Y) + ")").c_str())
     ("f0",       po::value<double>(),       std::string("source frequency (" + d2s(SOURCE_FREQUENCY) + ")").c_str())
@@ -171,8 +229,17 @@ void Parameters::read_from_command_line(int argc, char **argv)
 
   require(!(SAVE_COEF_PER_CELL && SAVE_COEF_PER_VERT), "There are two conflicting options which are ON: savcocel and savcover");
 
-  if (vm.count("cosavedc"))
-    COEF_SAVED_PER_VERT = vm["cosavedc"].as<bool>();
+  if (vm.count("cosavedv"))
+    COEF_SAVED_PER_VERT = vm["cosavedv"].as<bool>();
+
+  if (vm.count("cobin"))
+    COEF_BINARY = vm["cobin"].as<bool>();
+
+  if (vm.count("coconv"))
+    COEF_CONVERT_FILE = vm["coconv"].as<std::string>();
+
+  if (vm.count("cocache"))
+    COEF_CACHE = vm["cocache"].as<bool>();
 
   require(!((SAVE_COEF_PER_CELL || SAVE_COEF_PER_VERT) && COEF_SAVED_PER_VERT), "There are two conflicting options which are ON: (savcocell or savcover) and cosavedc");
 
@@ -218,6 +285,68 @@ void Parameters::read_from_command_line(int argc, char **argv)
       require(false, "Unknown time scheme : " + scheme_name);
   }
 
+  if (vm.count("lumping"))
+    MASS_LUMPING = vm["lumping"].as<bool>();
+  require(!(MASS_LUMPING && TIME_SCHEME != EXPLICIT), "Mass lumping can be used with explicit scheme only");
+
+  if (vm.count("mfree"))
+    MATRIX_FREE = vm["mfree"].as<bool>();
+  require(!(MATRIX_FREE && TIME_SCHEME != EXPLICIT), "Matrix-free operators can be used with explicit scheme only");
+
+  if (vm.count("symm"))
+    SYMMETRIC_STORAGE = vm["symm"].as<bool>();
+  require(!(SYMMETRIC_STORAGE && MATRIX_FREE), "Symmetric storage is used for assembled matrices only, and it's incompatible with matrix-free operators");
+
+  if (vm.count("sell"))
+    SELL_FORMAT = vm["sell"].as<bool>();
+  require(!(SELL_FORMAT && (MATRIX_FREE || SYMMETRIC_STORAGE)), "SELL-C-sigma format is used for full assembled matrices only, "
+          "and it's incompatible with matrix-free operators and symmetric storage");
+
+  if (vm.count("spmvbench"))
+    SPMV_BENCHMARK = vm["spmvbench"].as<unsigned int>();
+
+  if (vm.count("renum"))
+  {
+    const std::string ordering_name = vm["renum"].as<std::string>();
+    if (ordering_name == "natural")
+      DOF_ORDERING = NATURAL_ORDERING;
+    else if (ordering_name == "rcm")
+      DOF_ORDERING = RCM_ORDERING;
+    else if (ordering_name == "morton")
+      DOF_ORDERING = MORTON_ORDERING;
+    else if (ordering_name == "tiled")
+      DOF_ORDERING = TILED_ORDERING;
+    else
+      require(false, "Unknown ordering of dofs : " + ordering_name);
+  }
+  require(!(DOF_ORDERING != NATURAL_ORDERING && MATRIX_FREE), "Renumbering of dofs is used for assembled matrices only");
+
+  if (vm.count("nthreads"))
+    N_THREADS = vm["nthreads"].as<unsigned int>();
+
+  if (vm.count("tloop"))
+    THREADED_LOOP = vm["tloop"].as<bool>();
+  require(!(THREADED_LOOP && (!MASS_LUMPING || MATRIX_FREE || SYMMETRIC_STORAGE)),
+          "The threaded time loop requires the explicit scheme with lumped mass matrix and full assembled matrices");
+
+  if (vm.count("pin"))
+    PIN_MAP = vm["pin"].as<std::string>();
+
+  if (vm.count("hugepages"))
+    HUGE_PAGES = vm["hugepages"].as<bool>();
+
+  if (vm.count("distrib"))
+    DISTRIBUTED = vm["distrib"].as<bool>();
+  require(!(DISTRIBUTED && (TIME_SCHEME != EXPLICIT || MATRIX_FREE || SELL_FORMAT || SYMMETRIC_STORAGE ||
+                            THREADED_LOOP || DOF_ORDERING != NATURAL_ORDERING || SPMV_BENCHMARK > 0)),
+          "The distributed run uses the explicit scheme with the distributed assembled matrices in the natural ordering of dofs");
+  require(!(DISTRIBUTED && (CREATE_BIN_LAYERS_FILE || SAVE_COEF_PER_CELL || SAVE_COEF_PER_VERT)),
+          "The layers and coefficients files of the whole grid are not created in the distributed run");
+
+  if (vm.count("rect"))
+    RECT_GRID = vm["rect"].as<bool>();
+  require(!(RECT_GRID && vm.count("meshfile")), "We cannot use triangular mesh and rectangular grid at the same time");
+
   require(!(vm.count("tstep") && vm.count("nt") && vm.count("tend")),
           "tstep, nt and tend parameters cannot be used together - maximum two of them");
 
@@ -255,6 +384,8 @@ void Parameters::read_from_command_line(int argc, char **argv)
     PRINT_INFO = vm["inf"].as<bool>();
   if (vm.count("expcoef"))
     EXPORT_COEFFICIENTS = vm["expcoef"].as<bool>();
+  if (vm.count("vtkbin"))
+    VTK_BINARY = vm["vtkbin"].as<bool>();
   if (vm.count("vtu_step"))
   {
     VTU_STEP = vm["vtu_step"].as<unsigned int>();
@@ -265,6 +396,25 @@ void Parameters::read_from_command_line(int argc, char **argv)
     SOL_STEP = vm["sol_step"].as<unsigned int>();
     SAVE_SOL = true;
   }
+  if (vm.count("solfmt"))
+  {
+    const std::string format_name = vm["solfmt"].as<std::string>();
+    if (format_name == "text")
+      SOL_FORMAT = TEXT_SOLUTION;
+    else if (format_name == "bin")
+      SOL_FORMAT = BINARY_SOLUTION;
+    else if (format_name == "bin32")
+      SOL_FORMAT = BINARY_FLOAT_SOLUTION;
+    else
+      require(false, "Unknown format of the solutions : " + format_name);
+  }
+  if (vm.count("solext"))
+    SOL_EXTRACT_FILE = vm["solext"].as<std::string>();
+  if (vm.count("iothr"))
+    IO_THREADS = vm["iothr"].as<unsigned int>();
+  if (vm.count("iobuf"))
+    IO_BUFFERS = vm["iobuf"].as<unsigned int>();
+  require(IO_BUFFERS > 0, "The background output requires at least one buffer");
 
   if (vm.count("x1"))
     X_END = vm["x1"].as<double>();
@@ -272,6 +422,29 @@ void Parameters::read_from_command_line(int argc, char **argv)
     Y_END = vm["y1"].as<double>();
   require(X_END > X_BEG && Y_END > Y_BEG, "Wrong limits of the computational domain");
 
+  OUT_X_BEG = (vm.count("outx0") ? vm["outx0"].as<double>() : X_BEG);
+  OUT_X_END = (vm.count("outx1") ? vm["outx1"].as<double>() : X_END);
+  OUT_Y_BEG = (vm.count("outy0") ? vm["outy0"].as<double>() : Y_BEG);
+  OUT_Y_END = (vm.count("outy1") ? vm["outy1"].as<double>() : Y_END);
+  if (vm.count("outstride"))
+    OUT_STRIDE = vm["outstride"].as<unsigned int>();
+  require(OUT_STRIDE > 0, "The stride of the output must be positive");
+  // each process of a distributed run writes the rows of its strip including the rows shared with
+  // the neighbours, while with a stride the coarse cells between the strips need the rows of the neighbours
+  require(!DISTRIBUTED || OUT_STRIDE == 1, "The stride of the output is not used in a distributed run");
+  require(OUT_X_END > OUT_X_BEG && OUT_Y_END > OUT_Y_BEG, "Wrong limits of the output window");
+  require(RECT_GRID || (OUT_STRIDE == 1 && !vm.count("outx0") && !vm.count("outx1") && !vm.count("outy0") && !vm.count("outy1")),
+          "The output window and the stride are used with the rectangular grid only");
+
+  if (vm.count("recfile"))
+    RECEIVERS_FILE = vm["recfile"].as<std::string>();
+  if (vm.count("reclines"))
+    RECEIVER_LINES = vm["reclines"].as<std::string>();
+  // the receivers record the initial condition and every time step,
+  // and a SEG-Y trace has at most 65535 samples (the number is 16-bit in the headers)
+  require((RECEIVERS_FILE.empty() && RECEIVER_LINES.empty()) || N_TIME_STEPS + 1 <= 65535,
+          "The receivers can't record " + d2s(N_TIME_STEPS + 1) + " samples: a SEG-Y trace has at most 65535 samples");
+
   if (vm.count("nfx"))
     N_FINE_X = vm["nfx"].as<unsigned int>();
   if (vm.count("nfy"))
@@ -367,6 +540,19 @@ std::string Parameters::print() const
   std::string str = "list of parameters:\n";
   str += "dim = " + d2s(DIM) + "\n";
   str += "scheme = " + time_scheme_name[TIME_SCHEME] + "\n";
+  str += "mass lumping = " + d2s(MASS_LUMPING) + "\n";
+  str += "matrix-free = " + d2s(MATRIX_FREE) + "\n";
+  str += "symmetric storage = " + d2s(SYMMETRIC_STORAGE) + "\n";
+  str += "SELL-C-sigma format = " + d2s(SELL_FORMAT) + "\n";
+  str += "spmv benchmark runs = " + d2s(SPMV_BENCHMARK) + "\n";
+  const std::string dof_ordering_name[] = { "natural", "reverse Cuthill-McKee", "Morton", "tiled" };
+  str += "dof ordering = " + dof_ordering_name[DOF_ORDERING] + "\n";
+  str += "number of threads = " + d2s(N_THREADS) + "\n";
+  str += "threaded time loop = " + d2s(THREADED_LOOP) + "\n";
+  str += "pinning map = " + PIN_MAP + "\n";
+  str += "huge pages = " + d2s(HUGE_PAGES) + "\n";
+  str += "distributed = " + d2s(DISTRIBUTED) + "\n";
+  str += "rectangular grid = " + d2s(RECT_GRID) + "\n";
   str += "mesh file name = " + MESH_FILE + "\n";
   //str += "mesh cl = " + d2s(CL) + "\n";
   str += "domain = [" + d2s(X_BEG) + ", " + d2s(X_END) + "] x [" + d2s(Y_BEG) + ", " + d2s(Y_END) + "]\n";
@@ -375,10 +561,19 @@ std::string Parameters::print() const
   str += "number of time steps = " + d2s(N_TIME_STEPS) + "\n";
   str += "fe basis order = " + d2s(FE_ORDER) + "\n";
   str += "print_vtu = " + d2s(PRINT_VTU) + "\n";
+  str += "binary vtk = " + d2s(VTK_BINARY) + "\n";
+  str += "output window = [" + d2s(OUT_X_BEG) + ", " + d2s(OUT_X_END) + "] x [" + d2s(OUT_Y_BEG) + ", " + d2s(OUT_Y_END) + "]\n";
+  str += "output stride = " + d2s(OUT_STRIDE) + "\n";
+  str += "receivers file = " + RECEIVERS_FILE + "\n";
+  str += "receiver lines = " + RECEIVER_LINES + "\n";
   str += "save_sol = " + d2s(SAVE_SOL) + "\n";
   str += "print_info = " + d2s(PRINT_INFO) + "\n";
   str += "vtu_step = " + d2s(VTU_STEP) + "\n";
   str += "sol_step = " + d2s(SOL_STEP) + "\n";
+  const std::string sol_format_name[] = { "text", "binary (double)", "binary (float)" };
+  str += "sol_format = " + sol_format_name[SOL_FORMAT] + "\n";
+  str += "I/O threads = " + d2s(IO_THREADS) + "\n";
+  str += "I/O buffers = " + d2s(IO_BUFFERS) + "\n";
   str += "f0 = " + d2s(SOURCE_FREQUENCY) + "\n";
   str += "P = " + d2s(SOURCE_SUPPORT) + "\n";
   str += "xcen = " + d2s(SOURCE_CENTER_X) + "\n";
@@ -386,6 +581,7 @@ std::string Parameters::print() const
   str += "n_fine_x = " + d2s(N_FINE_X) + "\n";
   str += "n_fine_y = " + d2s(N_FINE_Y) + "\n";
   str += "layers_file = " + LAYERS_FILE + "\n";
+  str += "coef_cache = " + d2s(COEF_CACHE) + "\n";
   str += "h_bin_layer = " + d2s(H_BIN_LAYER_PERCENT) + "\n";
 
   str += "number of subdomains = " + d2s(N_SUBDOMAINS) + "\n";
@@ -407,7 +603,15 @@ std::string Parameters::print() const
 void Parameters::establish_environment()
 {
   generate_paths(); // generate all necessary path to files and directories
-  check_clean_dirs(); // check the existance and clearance of some directories
+
+  // in the distributed run the directories are prepared by one process, and the others wait for it
+  int rank = 0;
+  if (DISTRIBUTED)
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank == 0)
+    check_clean_dirs(); // check the existance and clearance of some directories
+  if (DISTRIBUTED)
+    MPI_Barrier(MPI_COMM_WORLD);
 }
 
 
@@ -417,6 +621,8 @@ void Parameters::generate_paths()
   MESH_FILE = MESH_DIR + "/" + MESH_FILE; // full path to the mesh file
   LAYERS_FILE = LAYERS_DIR + "/" + LAYERS_FILE; // full path to the layers file
   COEF_FILE = COEF_DIR + "/" + COEF_FILE; // full path to the coefficients file
+  if (COEF_CONVERT_FILE != "")
+    COEF_CONVERT_FILE = COEF_DIR + "/" + COEF_CONVERT_FILE; // full path to the converted coefficients file
 
   std::string coef_a = "", coef_b = "";
   for (unsigned int i = 0; i < N_SUBDOMAINS; ++i)
@@ -439,6 +645,7 @@ void Parameters::generate_paths()
   SOL_DIR = RES_DIR + "/" + SOL_DIR;
   TIME_FILE = RES_DIR + "/" + TIME_FILE;
   INFO_FILE = RES_DIR + "/" + INFO_FILE;
+  SEISMOGRAM_FILE = RES_DIR + "/" + SEISMOGRAM_FILE;
 }
 
 
@@ -460,11 +667,11 @@ void Parameters::check_clean_dirs() const
 //  if (PRINT_VTU)
     create_directory(VTU_DIR);
 
-  if (SAVE_SOL)
-    create_directory(SOL_DIR);
+  // the solution on the last time step is always saved
+  create_directory(SOL_DIR);
 
   path coef_dir(COEF_DIR);
-  if (SAVE_COEF_PER_CELL || SAVE_COEF_PER_VERT)
+  if (SAVE_COEF_PER_CELL || SAVE_COEF_PER_VERT || (COEF_CACHE && USE_LAYERS_FILE))
     create_directory(coef_dir);
   if (COEF_SAVED_PER_VERT)
     require(exists(coef_dir), "There is a coef_saved options turned on, but the directory with coefficients files doesn't exists");
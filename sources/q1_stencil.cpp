@@ -0,0 +1,355 @@
+#include "q1_stencil.h"
+#include "fem/rectangle.h"
+#include "fem/auxiliary_functions.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace fem;
+
+
+
+Q1Stencil::Q1Stencil(const FineMesh &fmesh, unsigned int nx, unsigned int ny,
+                     const std::vector<double> &coef_alpha, const std::vector<double> &coef_beta)
+  : _nx(nx),
+    _ny(ny),
+    _coef_alpha(coef_alpha),
+    _coef_beta(coef_beta)
+{
+  require(_nx > 0 && _ny > 0, "The grid is empty");
+  require(fmesh.n_rectangles() == _nx * _ny, "The number of cells (" + d2s(fmesh.n_rectangles()) +
+          ") doesn't correspond to the grid " + d2s(_nx) + " x " + d2s(_ny));
+  require(_coef_alpha.size() == _nx * _ny && _coef_beta.size() == _nx * _ny,
+          "The number of coefficients doesn't correspond to the number of cells");
+
+  const unsigned int n = row_length();
+
+  // the reference numbers of the vertices of the first cell
+  const Rectangle &first = fmesh.rectangle(0);
+  unsigned int ref[n_dofs];
+  bool used[n_dofs] = { false, false, false, false };
+  for (unsigned int i = 0; i < n_dofs; ++i)
+  {
+    const unsigned int dof = first.dof(i);
+    require(dof % n <= 1 && dof / n <= 1, "The grid is not numbered row-wise");
+    ref[i] = dof % n + 2 * (dof / n);
+    require(!used[ref[i]], "The grid is not numbered row-wise");
+    used[ref[i]] = true;
+  }
+
+  // all cells must be numbered the same way and have the same size,
+  // otherwise the reference matrices are not valid
+  for (unsigned int iy = 0; iy < _ny; ++iy)
+  {
+    for (unsigned int ix = 0; ix < _nx; ++ix)
+    {
+      const Rectangle &rectangle = fmesh.rectangle(iy * _nx + ix);
+      const unsigned int origin = iy * n + ix;
+      for (unsigned int i = 0; i < n_dofs; ++i)
+        require(rectangle.dof(i) == origin + ref[i] % 2 + (ref[i] / 2) * n,
+                "The grid is not numbered row-wise (cell " + d2s(iy * _nx + ix) + ")");
+      require(fabs(rectangle.mes() - first.mes()) <= 1e-12 * first.mes(),
+              "The grid is not uniform (cell " + d2s(iy * _nx + ix) + ")");
+    }
+  }
+
+  // reference matrices
+  std::array<std::array<double, n_dofs>, n_dofs> local_mass, local_stiff;
+  std::array<double*, n_dofs> local_mass_mat, local_stiff_mat; // the element interface requires double**
+  for (unsigned int i = 0; i < n_dofs; ++i)
+  {
+    local_mass_mat[i] = local_mass[i].data();
+    local_stiff_mat[i] = local_stiff[i].data();
+  }
+
+  first.local_mass_matrix(1., local_mass_mat.data());
+  first.local_stiffness_matrix(1., local_stiff_mat.data());
+  for (unsigned int i = 0; i < n_dofs; ++i)
+  {
+    for (unsigned int j = 0; j < n_dofs; ++j)
+    {
+      _mass[ref[i]][ref[j]] = local_mass[i][j];
+      _stiff[ref[i]][ref[j]] = local_stiff[i][j];
+    }
+  }
+}
+
+
+
+unsigned int Q1Stencil::order() const
+{
+  return (_nx + 1) * (_ny + 1);
+}
+
+
+
+unsigned int Q1Stencil::row_length() const
+{
+  return _nx + 1;
+}
+
+
+
+unsigned int Q1Stencil::n_cell_rows() const
+{
+  return _ny;
+}
+
+
+
+void Q1Stencil::mult(double c_mass, double c_stiff, const double *x, double *y) const
+{
+  std::fill(y, y + order(), 0.);
+  for (unsigned int iy = 0; iy < _ny; ++iy)
+    add_cell_row(iy, c_mass, c_stiff, x, y);
+}
+
+
+
+void Q1Stencil::add_cell_row(unsigned int iy, double c_mass, double c_stiff, const double *x, double *y) const
+{
+  const unsigned int nx = _nx;
+  const unsigned int n = row_length();
+
+  const double * __restrict__ x0 = x + iy * n; // bottom vertices of the cells
+  const double * __restrict__ x2 = x0 + n;     // top vertices of the cells
+  const double * __restrict__ alpha = &_coef_alpha[iy * nx];
+  const double * __restrict__ beta = &_coef_beta[iy * nx];
+
+  // each local row of the cells is added in a separate loop,
+  // therefore there is no dependency between the iterations
+  for (unsigned int i = 0; i < n_dofs; ++i)
+  {
+    double * __restrict__ yi = y + iy * n + i % 2 + (i / 2) * n;
+
+    const double m0 = c_mass * _mass[i][0],  m1 = c_mass * _mass[i][1];
+    const double m2 = c_mass * _mass[i][2],  m3 = c_mass * _mass[i][3];
+    const double k0 = c_stiff * _stiff[i][0], k1 = c_stiff * _stiff[i][1];
+    const double k2 = c_stiff * _stiff[i][2], k3 = c_stiff * _stiff[i][3];
+
+    for (unsigned int ix = 0; ix < nx; ++ix)
+      yi[ix] += alpha[ix] * (m0 * x0[ix] + m1 * x0[ix + 1] + m2 * x2[ix] + m3 * x2[ix + 1]) +
+                beta[ix]  * (k0 * x0[ix] + k1 * x0[ix + 1] + k2 * x2[ix] + k3 * x2[ix + 1]);
+  }
+}
+
+
+
+void Q1Stencil::diagonal(double c_mass, double c_stiff, double *d) const
+{
+  std::fill(d, d + order(), 0.);
+  const unsigned int n = row_length();
+  for (unsigned int iy = 0; iy < _ny; ++iy)
+  {
+    const double *alpha = &_coef_alpha[iy * _nx];
+    const double *beta = &_coef_beta[iy * _nx];
+    for (unsigned int i = 0; i < n_dofs; ++i)
+    {
+      double *di = d + iy * n + i % 2 + (i / 2) * n;
+      const double m = c_mass * _mass[i][i];
+      const double k = c_stiff * _stiff[i][i];
+      for (unsigned int ix = 0; ix < _nx; ++ix)
+        di[ix] += alpha[ix] * m + beta[ix] * k;
+    }
+  }
+}
+
+
+
+void Q1Stencil::mass_row_sums(double *d) const
+{
+  std::fill(d, d + order(), 0.);
+  const unsigned int n = row_length();
+  for (unsigned int iy = 0; iy < _ny; ++iy)
+  {
+    const double *alpha = &_coef_alpha[iy * _nx];
+    for (unsigned int i = 0; i < n_dofs; ++i)
+    {
+      double *di = d + iy * n + i % 2 + (i / 2) * n;
+      const double m = _mass[i][0] + _mass[i][1] + _mass[i][2] + _mass[i][3];
+      for (unsigned int ix = 0; ix < _nx; ++ix)
+        di[ix] += alpha[ix] * m;
+    }
+  }
+}
+
+
+
+/**
+ * The context of the shell matrix based on Q1 stencil
+ */
+struct Q1ShellContext
+{
+  const Q1Stencil *stencil;
+  double c_mass, c_stiff;
+  const std::vector<int> *b_nodes;
+};
+
+static PetscErrorCode q1_shell_mult(Mat mat, Vec x, Vec y)
+{
+  Q1ShellContext *context;
+  MatShellGetContext(mat, &context);
+
+  const double *x_val;
+  double *y_val;
+  VecGetArrayRead(x, &x_val);
+  VecGetArray(y, &y_val);
+
+  context->stencil->mult(context->c_mass, context->c_stiff, x_val, y_val);
+
+  // rows of the boundary nodes are the rows of the identity matrix
+  const std::vector<int> &b_nodes = *context->b_nodes;
+  for (unsigned int i = 0; i < b_nodes.size(); ++i)
+    y_val[b_nodes[i]] = x_val[b_nodes[i]];
+
+  VecRestoreArray(y, &y_val);
+  VecRestoreArrayRead(x, &x_val);
+  return 0;
+}
+
+static PetscErrorCode q1_shell_get_diagonal(Mat mat, Vec d)
+{
+  Q1ShellContext *context;
+  MatShellGetContext(mat, &context);
+
+  double *d_val;
+  VecGetArray(d, &d_val);
+
+  context->stencil->diagonal(context->c_mass, context->c_stiff, d_val);
+
+  const std::vector<int> &b_nodes = *context->b_nodes;
+  for (unsigned int i = 0; i < b_nodes.size(); ++i)
+    d_val[b_nodes[i]] = 1.;
+
+  VecRestoreArray(d, &d_val);
+  return 0;
+}
+
+static PetscErrorCode q1_shell_destroy(Mat mat)
+{
+  Q1ShellContext *context;
+  MatShellGetContext(mat, &context);
+  delete context;
+  return 0;
+}
+
+
+
+void Q1Stencil::create_system_matrix(double c_mass, double c_stiff, const std::vector<int> &b_nodes, Mat *mat) const
+{
+  Q1ShellContext *context = new Q1ShellContext;
+  context->stencil = this;
+  context->c_mass = c_mass;
+  context->c_stiff = c_stiff;
+  context->b_nodes = &b_nodes;
+
+  MatCreateShell(PETSC_COMM_SELF, order(), order(), order(), order(), context, mat);
+  MatShellSetOperation(*mat, MATOP_MULT, (void(*)(void))q1_shell_mult);
+  MatShellSetOperation(*mat, MATOP_GET_DIAGONAL, (void(*)(void))q1_shell_get_diagonal);
+  MatShellSetOperation(*mat, MATOP_DESTROY, (void(*)(void))q1_shell_destroy);
+}
+
+
+
+//==============================================================================
+//
+// Q1LeapfrogOperator
+//
+//==============================================================================
+Q1LeapfrogOperator::Q1LeapfrogOperator(const Q1Stencil &stencil,
+                                       double a_mass, double a_stiff,
+                                       double b_mass, double b_stiff,
+                                       Vec mass_diag)
+  : _stencil(stencil),
+    _a_mass(a_mass),
+    _a_stiff(a_stiff),
+    _b_mass(b_mass),
+    _b_stiff(b_stiff)
+{
+  if (mass_diag != NULL)
+  {
+    require(b_stiff == 0., "The operator B must be diagonal in case of lumped mass matrix");
+
+    const unsigned int n = _stencil.order();
+    _a_diag.resize(n);
+    _b_diag.resize(n);
+    _inv_mass.resize(n);
+
+    const double *m_diag;
+    VecGetArrayRead(mass_diag, &m_diag);
+    for (unsigned int i = 0; i < n; ++i)
+    {
+      _a_diag[i] = a_mass * m_diag[i];
+      _b_diag[i] = b_mass * m_diag[i];
+      _inv_mass[i] = 1. / m_diag[i];
+    }
+    VecRestoreArrayRead(mass_diag, &m_diag);
+  }
+}
+
+
+
+void Q1LeapfrogOperator::apply(Vec u1, Vec u2, double coef_f, Vec f, Vec y) const
+{
+  const double *u1_val, *u2_val, *f_val;
+  double *y_val;
+  VecGetArrayRead(u1, &u1_val);
+  VecGetArrayRead(u2, &u2_val);
+  VecGetArray(y, &y_val);
+  if (f == y)
+    f_val = y_val; // each row of f is read before the first contribution to the same row of y
+  else
+    VecGetArrayRead(f, &f_val);
+
+  const unsigned int n = _stencil.row_length();
+  const unsigned int n_rows = _stencil.n_cell_rows();
+  const bool lumped = !_inv_mass.empty();
+
+  for (unsigned int j = 0; j < n; ++j)
+    y_val[j] = coef_f * f_val[j];
+
+  for (unsigned int iy = 0; iy < n_rows; ++iy)
+  {
+    // the next row of vertices gets the contributions starting from this row of cells
+    double *y_next = y_val + (iy + 1) * n;
+    const double *f_next = f_val + (iy + 1) * n;
+    for (unsigned int j = 0; j < n; ++j)
+      y_next[j] = coef_f * f_next[j];
+
+    if (lumped) // the mass matrix acts on the diagonal only
+    {
+      _stencil.add_cell_row(iy, 0., _a_stiff, u1_val, y_val);
+      finish_lumped_row(iy, u1_val, u2_val, y_val); // the row iy is complete now
+    }
+    else
+    {
+      _stencil.add_cell_row(iy, _a_mass, _a_stiff, u1_val, y_val);
+      _stencil.add_cell_row(iy, _b_mass, _b_stiff, u2_val, y_val);
+    }
+  }
+  if (lumped)
+    finish_lumped_row(n_rows, u1_val, u2_val, y_val);
+
+  if (f != y)
+    VecRestoreArrayRead(f, &f_val);
+  VecRestoreArray(y, &y_val);
+  VecRestoreArrayRead(u2, &u2_val);
+  VecRestoreArrayRead(u1, &u1_val);
+}
+
+
+
+void Q1LeapfrogOperator::finish_lumped_row(unsigned int iy, const double *u1, const double *u2, double *y) const
+{
+  const unsigned int n = _stencil.row_length();
+  const unsigned int beg = iy * n;
+  for (unsigned int j = beg; j < beg + n; ++j)
+    y[j] = (y[j] + _a_diag[j] * u1[j] + _b_diag[j] * u2[j]) * _inv_mass[j];
+}
+
+
+
+unsigned int Q1LeapfrogOperator::order() const
+{
+  return _stencil.order();
+}
@@ -0,0 +1,372 @@
+#include "receivers.h"
+#include "fem/auxiliary_functions.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+
+// write the lowest n_bytes bytes of the value in big-endian order (the byte order of SEG-Y)
+static void put_big_endian(char *dest, uint64_t value, unsigned int n_bytes)
+{
+  for (unsigned int i = 0; i < n_bytes; ++i)
+    dest[i] = (char)((value >> (8 * (n_bytes - 1 - i))) & 0xff);
+}
+
+// the bucket of the coordinate among n buckets of the size starting from beg
+// (the points out of the buckets are moved to the nearest one)
+static unsigned int bucket(double coord, double beg, double size, unsigned int n)
+{
+  return std::min(n - 1, (unsigned int)std::max(0., std::floor((coord - beg) / size)));
+}
+
+
+
+Receivers::Receivers(const std::vector<fem::Point> &points)
+  : _points(points)
+{
+  require(!_points.empty(), "There are no receivers");
+}
+
+
+
+std::vector<fem::Point> Receivers::read(const std::string &filename)
+{
+  std::ifstream in(filename.c_str());
+  require(in, "File " + filename + " cannot be opened");
+
+  std::vector<fem::Point> points;
+  std::string line;
+  unsigned int line_number = 0;
+  while (std::getline(in, line))
+  {
+    ++line_number;
+    const size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#')
+      continue;
+    std::istringstream line_in(line);
+    double x, y;
+    require(line_in >> x >> y, "Wrong coordinates of the receiver in the line " + d2s(line_number) + " of the file " + filename);
+    points.push_back(fem::Point(x, y));
+  }
+  return points;
+}
+
+
+
+std::vector<fem::Point> Receivers::lines(const std::string &description)
+{
+  std::vector<fem::Point> points;
+  std::istringstream in(description);
+  std::string line;
+  while (std::getline(in, line, ';'))
+  {
+    if (line.find_first_not_of(" \t") == std::string::npos)
+      continue;
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream line_in(line);
+    double x0, y0, x1, y1;
+    unsigned int n;
+    require(line_in >> x0 >> y0 >> x1 >> y1 >> n, "Wrong description of the line of receivers: " + line +
+            " (it should be x0,y0,x1,y1,n)");
+    require(n > 0, "The line of receivers has no receivers: " + line);
+    for (unsigned int i = 0; i < n; ++i)
+    {
+      const double s = (n > 1 ? (double)i / (n - 1) : 0.);
+      points.push_back(fem::Point(x0 + s * (x1 - x0), y0 + s * (y1 - y0)));
+    }
+  }
+  return points;
+}
+
+
+
+unsigned int Receivers::n_receivers() const
+{
+  return _points.size();
+}
+
+
+
+fem::Point Receivers::point(unsigned int receiver) const
+{
+  expect(receiver < _points.size(), "The receiver " + d2s(receiver) + " is out of range");
+  return _points[receiver];
+}
+
+
+
+const unsigned int* Receivers::vertices(unsigned int receiver) const
+{
+  expect(receiver < _points.size() && !_vertices.empty(), "The receiver " + d2s(receiver) + " is not located");
+  return &_vertices[receiver * MAX_VERTICES];
+}
+
+
+
+const double* Receivers::weights(unsigned int receiver) const
+{
+  expect(receiver < _points.size() && !_weights.empty(), "The receiver " + d2s(receiver) + " is not located");
+  return &_weights[receiver * MAX_VERTICES];
+}
+
+
+
+void Receivers::locate_in_grid(double x_beg, double x_end, double y_beg, double y_end,
+                               unsigned int nx, unsigned int ny)
+{
+  require(nx > 0 && ny > 0, "The grid has no cells");
+  const double hx = (x_end - x_beg) / nx;
+  const double hy = (y_end - y_beg) / ny;
+  const double tol = 1e-8; // the receivers on the borders of the domain (up to the round-off) are inside it
+
+  _vertices.assign(n_receivers() * MAX_VERTICES, 0);
+  _weights.assign(n_receivers() * MAX_VERTICES, 0.);
+  for (unsigned int r = 0; r < n_receivers(); ++r)
+  {
+    const double x = (_points[r].coord(0) - x_beg) / hx;
+    const double y = (_points[r].coord(1) - y_beg) / hy;
+    require(x > -tol && x < nx + tol && y > -tol && y < ny + tol, "The receiver " + d2s(r) + " (" +
+            d2s(_points[r].coord(0)) + ", " + d2s(_points[r].coord(1)) + ") is out of the domain");
+
+    // the cell containing the receiver, and the local coordinates of the receiver in it
+    const unsigned int col = std::min(nx - 1, (unsigned int)std::max(0., std::floor(x)));
+    const unsigned int row = std::min(ny - 1, (unsigned int)std::max(0., std::floor(y)));
+    const double s = std::min(1., std::max(0., x - col));
+    const double t = std::min(1., std::max(0., y - row));
+
+    // bilinear interpolation over the vertices of the cell
+    const unsigned int v = row * (nx + 1) + col;
+    unsigned int *vert = &_vertices[r * MAX_VERTICES];
+    double *w = &_weights[r * MAX_VERTICES];
+    vert[0] = v;          w[0] = (1. - s) * (1. - t);
+    vert[1] = v + 1;      w[1] = s * (1. - t);
+    vert[2] = v + nx + 1; w[2] = (1. - s) * t;
+    vert[3] = v + nx + 2; w[3] = s * t;
+  }
+}
+
+
+
+void Receivers::locate_in_mesh(const std::vector<fem::Point> &vertices, const std::vector<fem::Triangle> &triangles)
+{
+  require(!triangles.empty(), "The mesh has no triangles");
+
+  // the uniform grid of buckets covering the mesh (about one triangle per bucket)
+  double min_x = vertices[0].coord(0), max_x = min_x;
+  double min_y = vertices[0].coord(1), max_y = min_y;
+  for (unsigned int i = 1; i < vertices.size(); ++i)
+  {
+    min_x = std::min(min_x, vertices[i].coord(0));
+    max_x = std::max(max_x, vertices[i].coord(0));
+    min_y = std::min(min_y, vertices[i].coord(1));
+    max_y = std::max(max_y, vertices[i].coord(1));
+  }
+  const unsigned int n_buckets = std::max(1, (int)std::sqrt((double)triangles.size()));
+  const double bx = (max_x > min_x ? (max_x - min_x) / n_buckets : 1.);
+  const double by = (max_y > min_y ? (max_y - min_y) / n_buckets : 1.);
+  const double tol = 1e-8;
+
+  // each triangle is kept in all buckets intersecting its bounding box
+  std::vector<std::vector<unsigned int> > buckets(n_buckets * n_buckets);
+  for (unsigned int tri = 0; tri < triangles.size(); ++tri)
+  {
+    double x0 = max_x, x1 = min_x, y0 = max_y, y1 = min_y;
+    for (unsigned int j = 0; j < fem::Triangle::n_vertices; ++j)
+    {
+      const fem::Point &p = vertices[triangles[tri].vertex(j)];
+      x0 = std::min(x0, p.coord(0));
+      x1 = std::max(x1, p.coord(0));
+      y0 = std::min(y0, p.coord(1));
+      y1 = std::max(y1, p.coord(1));
+    }
+    const unsigned int i_end = bucket(x1, min_x, bx, n_buckets), j_end = bucket(y1, min_y, by, n_buckets);
+    for (unsigned int j = bucket(y0, min_y, by, n_buckets); j <= j_end; ++j)
+      for (unsigned int i = bucket(x0, min_x, bx, n_buckets); i <= i_end; ++i)
+        buckets[j * n_buckets + i].push_back(tri);
+  }
+
+  _vertices.assign(n_receivers() * MAX_VERTICES, 0);
+  _weights.assign(n_receivers() * MAX_VERTICES, 0.);
+  for (unsigned int r = 0; r < n_receivers(); ++r)
+  {
+    const double x = _points[r].coord(0), y = _points[r].coord(1);
+    const std::vector<unsigned int> &candidates = buckets[bucket(y, min_y, by, n_buckets) * n_buckets + bucket(x, min_x, bx, n_buckets)];
+
+    // the triangle where the receiver is the most inside (it matters for the receivers on the edges only)
+    double best = -1e+100;
+    for (unsigned int k = 0; k < candidates.size(); ++k)
+    {
+      const fem::Triangle &triangle = triangles[candidates[k]];
+      const fem::Point &p0 = vertices[triangle.vertex(0)];
+      const fem::Point &p1 = vertices[triangle.vertex(1)];
+      const fem::Point &p2 = vertices[triangle.vertex(2)];
+      const double x10 = p1.coord(0) - p0.coord(0), y10 = p1.coord(1) - p0.coord(1);
+      const double x20 = p2.coord(0) - p0.coord(0), y20 = p2.coord(1) - p0.coord(1);
+      const double det = x10 * y20 - x20 * y10;
+      const double l1 = ((x - p0.coord(0)) * y20 - x20 * (y - p0.coord(1))) / det;
+      const double l2 = (x10 * (y - p0.coord(1)) - (x - p0.coord(0)) * y10) / det;
+      const double l0 = 1. - l1 - l2;
+      const double inside = std::min(l0, std::min(l1, l2));
+      if (inside > best)
+      {
+        best = inside;
+        for (unsigned int j = 0; j < fem::Triangle::n_vertices; ++j)
+          _vertices[r * MAX_VERTICES + j] = triangle.vertex(j);
+        _weights[r * MAX_VERTICES + 0] = l0;
+        _weights[r * MAX_VERTICES + 1] = l1;
+        _weights[r * MAX_VERTICES + 2] = l2;
+      }
+    }
+    require(best > -tol, "The receiver " + d2s(r) + " (" + d2s(x) + ", " + d2s(y) + ") is out of the mesh");
+  }
+}
+
+
+
+void Receivers::distribute(const DoFRenumbering &renumbering, unsigned int first_dof, unsigned int n_owned_dofs)
+{
+  require(!_weights.empty(), "The receivers are not located");
+  _positions.assign(n_receivers() * MAX_VERTICES, -1);
+  for (unsigned int i = 0; i < _positions.size(); ++i)
+  {
+    if (_weights[i] == 0.)
+      continue;
+    const unsigned int dof = renumbering.new_dof(_vertices[i]);
+    if (dof >= first_dof && dof < first_dof + n_owned_dofs)
+      _positions[i] = dof - first_dof;
+  }
+}
+
+
+
+void Receivers::record(const double *values)
+{
+  require(!_positions.empty(), "The receivers are not distributed");
+  const unsigned int beg = _samples.size();
+  _samples.resize(beg + n_receivers());
+  for (unsigned int r = 0; r < n_receivers(); ++r)
+  {
+    double value = 0.;
+    for (unsigned int k = r * MAX_VERTICES; k < (r + 1) * MAX_VERTICES; ++k)
+      if (_positions[k] >= 0)
+        value += _weights[k] * values[_positions[k]];
+    _samples[beg + r] = value;
+  }
+}
+
+
+
+void Receivers::record(Vec values)
+{
+  const double *val;
+  VecGetArrayRead(values, &val);
+  record(val);
+  VecRestoreArrayRead(values, &val);
+}
+
+
+
+unsigned int Receivers::n_samples() const
+{
+  return _samples.size() / n_receivers();
+}
+
+
+
+double Receivers::sample(unsigned int receiver, unsigned int step) const
+{
+  expect(receiver < n_receivers() && step < n_samples(), "The sample " + d2s(step) + " of the receiver " +
+         d2s(receiver) + " is out of range");
+  return _samples[step * n_receivers() + receiver];
+}
+
+
+
+std::vector<double>& Receivers::samples()
+{
+  return _samples;
+}
+
+
+
+void Receivers::write_segy(const std::string &filename, double dt, double time_beg) const
+{
+  const unsigned int n_traces = n_receivers();
+  const unsigned int n_steps = n_samples();
+  require(n_steps <= 65535, "A SEG-Y trace has at most 65535 samples, while there are " + d2s(n_steps) + " time steps");
+
+  // the sample interval is in microseconds. if it can't be represented, it's zero,
+  // and the text header keeps the exact value anyway
+  const double interval = std::floor(dt * 1e+6 + 0.5);
+  const unsigned int dt_us = (interval >= 1. && interval <= 65535. ? (unsigned int)interval : 0);
+  const double delay = std::floor(time_beg * 1e+3 + 0.5); // in milliseconds
+  const int delay_ms = (std::fabs(delay) <= 32767. ? (int)delay : 0);
+
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  require(out, "File " + filename + " cannot be opened");
+
+  // the text header: 40 lines of 80 characters (ASCII)
+  std::vector<std::string> lines(40);
+  lines[0] = "FEM2D-LAYERS: TRACES OF THE RECEIVERS (ACOUSTIC WAVE EQUATION)";
+  lines[1] = "RECEIVERS: " + d2s(n_traces) + "   SAMPLES PER TRACE: " + d2s(n_steps);
+  lines[2] = "SAMPLE INTERVAL: " + d2s(dt) + " S   TIME OF THE FIRST SAMPLE: " + d2s(time_beg) + " S";
+  lines[3] = "RECEIVER COORDINATES: GROUP X, Y (BYTES 81-88) DIVIDED BY " + d2s(COORD_SCALE);
+  lines[4] = "SAMPLE FORMAT: 4-BYTE IEEE FLOATING POINT, BIG-ENDIAN";
+  lines[39] = "END TEXTUAL HEADER";
+  char text_header[3200];
+  memset(text_header, ' ', sizeof(text_header));
+  for (unsigned int i = 0; i < lines.size(); ++i)
+  {
+    const std::string line = "C" + std::string(i < 9 ? " " : "") + d2s(i + 1) + " " + lines[i];
+    memcpy(text_header + 80 * i, line.c_str(), std::min((size_t)80, line.size()));
+  }
+  out.write(text_header, sizeof(text_header));
+
+  // the binary header (the offsets are the bytes from 3201)
+  char bin_header[400];
+  memset(bin_header, 0, sizeof(bin_header));
+  put_big_endian(bin_header + 12, (n_traces <= 32767 ? n_traces : 0), 2); // data traces per ensemble
+  put_big_endian(bin_header + 16, dt_us, 2); // sample interval
+  put_big_endian(bin_header + 18, dt_us, 2); // original sample interval
+  put_big_endian(bin_header + 20, n_steps, 2); // samples per trace
+  put_big_endian(bin_header + 22, n_steps, 2); // original samples per trace
+  put_big_endian(bin_header + 24, 5, 2); // format code: IEEE float
+  put_big_endian(bin_header + 300, 0x0100, 2); // SEG-Y revision 1.0
+  put_big_endian(bin_header + 302, 1, 2); // all traces have the same length
+  out.write(bin_header, sizeof(bin_header));
+
+  // the traces
+  std::vector<char> trace(240 + n_steps * sizeof(float));
+  for (unsigned int r = 0; r < n_traces; ++r)
+  {
+    std::fill(trace.begin(), trace.begin() + 240, 0);
+    const int32_t gx = (int32_t)std::floor(_points[r].coord(0) * COORD_SCALE + 0.5);
+    const int32_t gy = (int32_t)std::floor(_points[r].coord(1) * COORD_SCALE + 0.5);
+    put_big_endian(&trace[0], r + 1, 4); // trace sequence number within line
+    put_big_endian(&trace[4], r + 1, 4); // trace sequence number within file
+    put_big_endian(&trace[8], 1, 4); // field record number
+    put_big_endian(&trace[12], r + 1, 4); // trace number within the field record
+    put_big_endian(&trace[28], 1, 2); // trace identification code: seismic data
+    put_big_endian(&trace[70], (uint16_t)(int16_t)(-COORD_SCALE), 2); // scalar to be applied to the coordinates
+    put_big_endian(&trace[80], (uint32_t)gx, 4); // group coordinate X
+    put_big_endian(&trace[84], (uint32_t)gy, 4); // group coordinate Y
+    put_big_endian(&trace[88], 1, 2); // coordinate units: length
+    put_big_endian(&trace[108], (uint16_t)(int16_t)delay_ms, 2); // delay recording time
+    put_big_endian(&trace[114], n_steps, 2); // number of samples
+    put_big_endian(&trace[116], dt_us, 2); // sample interval
+
+    for (unsigned int s = 0; s < n_steps; ++s)
+    {
+      const float value = _samples[s * n_traces + r];
+      uint32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      put_big_endian(&trace[240 + s * sizeof(float)], bits, 4);
+    }
+    out.write(&trace[0], trace.size());
+  }
+  require(out, "Error while writing the file " + filename);
+  out.close();
+}
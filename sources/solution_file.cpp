@@ -0,0 +1,353 @@
+#include "solution_file.h"
+#include "fem/auxiliary_functions.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+const char SolutionFile::MAGIC[8] = { 'F', 'E', 'M', '2', 'D', 'S', 'O', '\0' };
+const uint32_t SolutionFile::VERSION;
+const uint32_t SolutionFile::BYTE_ORDER_MARK;
+
+// the beginning of each record of the snapshot
+struct RecordHead
+{
+  double time;
+  uint64_t step;
+};
+
+
+
+SolutionFile::SolutionFile(const std::string &filename)
+  : _data(NULL),
+    _size(0),
+    _header(NULL)
+{
+  static_assert(sizeof(Header) == 64, "The header of the binary solution file must be 64 bytes long");
+  static_assert(sizeof(IndexEntry) == 24, "The entry of the index of the binary solution file must be 24 bytes long");
+
+  const int fd = open(filename.c_str(), O_RDONLY);
+  require(fd >= 0, "File " + filename + " cannot be opened");
+
+  struct stat file_stat;
+  require(fstat(fd, &file_stat) == 0, "Cannot get the size of the file " + filename);
+  _size = file_stat.st_size;
+  require(_size >= sizeof(Header), "File " + filename + " is too small to be a binary solution file");
+
+  _data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps the file
+  require(_data != MAP_FAILED, "File " + filename + " cannot be mapped into memory");
+
+  _header = static_cast<const Header*>(_data);
+  require(memcmp(_header->magic, MAGIC, sizeof(MAGIC)) == 0, "File " + filename + " is not a binary solution file");
+  require(_header->version == VERSION, "Unsupported version of the binary solution file " + filename +
+          ": " + d2s(_header->version) + " (expected " + d2s(VERSION) + ")");
+  require(_header->byte_order == BYTE_ORDER_MARK, "File " + filename + " was written on a machine with different byte order");
+  require(_header->value_type == FLOAT64 || _header->value_type == FLOAT32, "Unknown type of values in the file " + filename);
+
+  const uint64_t rec_size = record_size(_header->n_values, value_type());
+  if (_header->index_offset != 0) // the file was closed properly
+  {
+    require(_header->index_offset == sizeof(Header) + _header->n_snapshots * rec_size &&
+            _size == _header->index_offset + _header->n_snapshots * sizeof(IndexEntry),
+            "File " + filename + " is truncated or corrupted");
+    const IndexEntry *index = reinterpret_cast<const IndexEntry*>(static_cast<const char*>(_data) + _header->index_offset);
+    _index.assign(index, index + _header->n_snapshots);
+  }
+  else // the writing was interrupted - the complete records are recovered
+  {
+    const uint64_t n_snapshots = (_size - sizeof(Header)) / rec_size;
+    _index.resize(n_snapshots);
+    for (uint64_t s = 0; s < n_snapshots; ++s)
+    {
+      _index[s].offset = sizeof(Header) + s * rec_size;
+      const RecordHead *head = reinterpret_cast<const RecordHead*>(static_cast<const char*>(_data) + _index[s].offset);
+      _index[s].step = head->step;
+      _index[s].time = head->time;
+    }
+    std::stable_sort(_index.begin(), _index.end(), step_less);
+  }
+
+  for (uint64_t s = 0; s < _index.size(); ++s)
+    require(_index[s].offset + rec_size <= _size, "The snapshot " + d2s(s) + " is out of the file " + filename);
+}
+
+
+
+SolutionFile::~SolutionFile()
+{
+  if (_data != NULL)
+    munmap(_data, _size);
+}
+
+
+
+SolutionFile::ValueType SolutionFile::value_type() const
+{
+  return static_cast<ValueType>(_header->value_type);
+}
+
+
+
+unsigned int SolutionFile::nx() const
+{
+  return _header->nx;
+}
+
+
+
+unsigned int SolutionFile::ny() const
+{
+  return _header->ny;
+}
+
+
+
+int SolutionFile::piece() const
+{
+  return _header->piece;
+}
+
+
+
+uint64_t SolutionFile::n_values() const
+{
+  return _header->n_values;
+}
+
+
+
+uint64_t SolutionFile::n_snapshots() const
+{
+  return _index.size();
+}
+
+
+
+uint64_t SolutionFile::step(uint64_t snapshot) const
+{
+  expect(snapshot < _index.size(), "The snapshot " + d2s(snapshot) + " is out of range");
+  return _index[snapshot].step;
+}
+
+
+
+double SolutionFile::time(uint64_t snapshot) const
+{
+  expect(snapshot < _index.size(), "The snapshot " + d2s(snapshot) + " is out of range");
+  return _index[snapshot].time;
+}
+
+
+
+long long SolutionFile::find(uint64_t step) const
+{
+  IndexEntry entry;
+  entry.step = step;
+  const std::vector<IndexEntry>::const_iterator it = std::lower_bound(_index.begin(), _index.end(), entry, step_less);
+  if (it == _index.end() || it->step != step)
+    return -1;
+  return it - _index.begin();
+}
+
+
+
+const double* SolutionFile::values(uint64_t snapshot) const
+{
+  require(value_type() == FLOAT64, "The solution file keeps float values");
+  return reinterpret_cast<const double*>(record_values(snapshot));
+}
+
+
+
+const float* SolutionFile::float_values(uint64_t snapshot) const
+{
+  require(value_type() == FLOAT32, "The solution file keeps double values");
+  return reinterpret_cast<const float*>(record_values(snapshot));
+}
+
+
+
+void SolutionFile::get_values(uint64_t snapshot, std::vector<double> &vals) const
+{
+  if (value_type() == FLOAT64)
+  {
+    const double *v = values(snapshot);
+    vals.assign(v, v + n_values());
+  }
+  else
+  {
+    const float *v = float_values(snapshot);
+    vals.assign(v, v + n_values());
+  }
+}
+
+
+
+const char* SolutionFile::record_values(uint64_t snapshot) const
+{
+  expect(snapshot < _index.size(), "The snapshot " + d2s(snapshot) + " is out of range");
+  return static_cast<const char*>(_data) + _index[snapshot].offset + sizeof(RecordHead);
+}
+
+
+
+uint64_t SolutionFile::record_size(uint64_t n_values, ValueType value_type)
+{
+  const uint64_t values_size = n_values * (value_type == FLOAT64 ? sizeof(double) : sizeof(float));
+  return sizeof(RecordHead) + (values_size + 7) / 8 * 8;
+}
+
+
+
+bool SolutionFile::step_less(const IndexEntry &a, const IndexEntry &b)
+{
+  return a.step < b.step;
+}
+
+
+
+uint64_t SolutionFile::extract(const std::string &filename, const std::string &out_dir)
+{
+  const SolutionFile sol_file(filename);
+  const std::string piece = (sol_file.piece() >= 0 ? "-p" + d2s(sol_file.piece()) : "");
+
+  std::vector<double> vals;
+  for (uint64_t s = 0; s < sol_file.n_snapshots(); ++s)
+  {
+    sol_file.get_values(s, vals);
+    const std::string fname = out_dir + "/sol-" + d2s(sol_file.step(s)) + piece + ".dat";
+    std::ofstream out(fname.c_str());
+    require(out, "File " + fname + " cannot be opened");
+    out.setf(std::ios::scientific);
+    out.precision(16);
+    for (unsigned int i = 0; i < vals.size(); ++i)
+      out << vals[i] << "\n";
+    require(out, "Error while writing the file " + fname);
+    out.close();
+  }
+  return sol_file.n_snapshots();
+}
+
+
+
+//==============================================================================
+//
+// SolutionWriter
+//
+//==============================================================================
+SolutionWriter::SolutionWriter(const std::string &filename, uint64_t n_values, SolutionFile::ValueType value_type,
+                               unsigned int nx, unsigned int ny, int piece)
+  : _filename(filename),
+    _offset(sizeof(SolutionFile::Header))
+{
+  memset(&_header, 0, sizeof(_header));
+  memcpy(_header.magic, SolutionFile::MAGIC, sizeof(SolutionFile::MAGIC));
+  _header.version = SolutionFile::VERSION;
+  _header.byte_order = SolutionFile::BYTE_ORDER_MARK;
+  _header.value_type = value_type;
+  _header.nx = nx;
+  _header.ny = ny;
+  _header.piece = piece;
+  _header.n_values = n_values;
+
+  _out.open(filename.c_str(), std::ios::binary);
+  require(_out, "File " + filename + " cannot be opened");
+  _out.write(reinterpret_cast<const char*>(&_header), sizeof(_header));
+  require(_out, "Error while writing the file " + filename);
+}
+
+
+
+SolutionWriter::~SolutionWriter()
+{
+  try
+  {
+    close();
+  }
+  catch (...) // the destructor mustn't throw, and the records written are read anyway
+  { }
+}
+
+
+
+void SolutionWriter::append(uint64_t step, double time, Vec values, uint64_t first)
+{
+  PetscInt size;
+  VecGetLocalSize(values, &size);
+  require(first + _header.n_values <= (uint64_t)size, "The vector has fewer values than the snapshot requires");
+
+  const double *val;
+  VecGetArrayRead(values, &val);
+  append(step, time, val + first);
+  VecRestoreArrayRead(values, &val);
+}
+
+
+
+void SolutionWriter::append(uint64_t step, double time, const double *values)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  require(_out.is_open(), "The solution file " + _filename + " is closed");
+
+  RecordHead head;
+  head.time = time;
+  head.step = step;
+  _out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+
+  const uint64_t n_values = _header.n_values;
+  uint64_t values_size = 0;
+  if (_header.value_type == SolutionFile::FLOAT64)
+  {
+    _out.write(reinterpret_cast<const char*>(values), n_values * sizeof(double));
+    values_size = n_values * sizeof(double);
+  }
+  else // the values are converted by chunks
+  {
+    const uint64_t chunk = 1024;
+    float converted[chunk];
+    for (uint64_t beg = 0; beg < n_values; beg += chunk)
+    {
+      const uint64_t end = std::min(beg + chunk, n_values);
+      for (uint64_t i = beg; i < end; ++i)
+        converted[i - beg] = values[i];
+      _out.write(reinterpret_cast<const char*>(converted), (end - beg) * sizeof(float));
+    }
+    values_size = n_values * sizeof(float);
+  }
+  const char padding[8] = { 0 };
+  _out.write(padding, (values_size + 7) / 8 * 8 - values_size);
+  require(_out, "Error while writing the file " + _filename);
+
+  SolutionFile::IndexEntry entry;
+  entry.step = step;
+  entry.time = time;
+  entry.offset = _offset;
+  _index.push_back(entry);
+  _offset += SolutionFile::record_size(n_values, static_cast<SolutionFile::ValueType>(_header.value_type));
+}
+
+
+
+void SolutionWriter::close()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (!_out.is_open())
+    return;
+
+  // the snapshots may be appended in any order by several threads
+  std::stable_sort(_index.begin(), _index.end(), SolutionFile::step_less);
+  if (!_index.empty())
+    _out.write(reinterpret_cast<const char*>(&_index[0]), _index.size() * sizeof(SolutionFile::IndexEntry));
+
+  _header.n_snapshots = _index.size();
+  _header.index_offset = _offset;
+  _out.seekp(0);
+  _out.write(reinterpret_cast<const char*>(&_header), sizeof(_header));
+  const bool ok = _out.good();
+  _out.close();
+  require(ok, "Error while writing the file " + _filename);
+}
@@ -0,0 +1,91 @@
+#include "strip_partition.h"
+#include "fem/auxiliary_functions.h"
+#include <algorithm>
+
+
+StripPartition::StripPartition(unsigned int nx, unsigned int ny, unsigned int rank, unsigned int n_ranks)
+  : _nx(nx),
+    _ny(ny),
+    _rank(rank),
+    _n_ranks(n_ranks)
+{
+  require(_nx > 0 && _ny > 0, "The grid is empty");
+  require(_rank < _n_ranks, "The rank " + d2s(_rank) + " is out of the range of the ranks (" + d2s(_n_ranks) + ")");
+  require(_n_ranks <= _ny + 1, "There are more processes (" + d2s(_n_ranks) + ") than the rows of vertices (" + d2s(_ny + 1) + ")");
+
+  // the rows of vertices are distributed evenly
+  const unsigned int n_rows = _ny + 1;
+  _row_beg = (unsigned long long)n_rows * _rank / _n_ranks;
+  _row_end = (unsigned long long)n_rows * (_rank + 1) / _n_ranks;
+
+  // the cells below the first row and above the last row are kept too
+  _cell_row_beg = (_row_beg > 0 ? _row_beg - 1 : 0);
+  _cell_row_end = std::min(_row_end, _ny);
+}
+
+
+
+unsigned int StripPartition::rank() const { return _rank; }
+unsigned int StripPartition::n_ranks() const { return _n_ranks; }
+unsigned int StripPartition::row_length() const { return _nx + 1; }
+unsigned int StripPartition::row_beg() const { return _row_beg; }
+unsigned int StripPartition::row_end() const { return _row_end; }
+unsigned int StripPartition::cell_row_beg() const { return _cell_row_beg; }
+unsigned int StripPartition::cell_row_end() const { return _cell_row_end; }
+unsigned int StripPartition::n_cell_rows() const { return _cell_row_end - _cell_row_beg; }
+unsigned int StripPartition::n_dofs() const { return (_ny + 1) * row_length(); }
+unsigned int StripPartition::first_dof() const { return _row_beg * row_length(); }
+unsigned int StripPartition::n_owned_dofs() const { return (_row_end - _row_beg) * row_length(); }
+unsigned int StripPartition::n_local_vertices() const { return (n_cell_rows() + 1) * row_length(); }
+unsigned int StripPartition::dof_shift() const { return _cell_row_beg * row_length(); }
+unsigned int StripPartition::owned_beg() const { return first_dof() - dof_shift(); }
+unsigned int StripPartition::owned_end() const { return owned_beg() + n_owned_dofs(); }
+unsigned int StripPartition::global_dof(unsigned int local_vertex) const { return local_vertex + dof_shift(); }
+bool StripPartition::owns_dof(unsigned int local_vertex) const { return (local_vertex >= owned_beg() && local_vertex < owned_end()); }
+
+
+
+std::vector<int> StripPartition::ghost_dofs() const
+{
+  std::vector<int> ghosts;
+  for (unsigned int v = 0; v < n_local_vertices(); ++v)
+    if (v < owned_beg() || v >= owned_end())
+      ghosts.push_back(v + dof_shift());
+  return ghosts;
+}
+
+
+
+unsigned int StripPartition::local_form_index(unsigned int local_vertex) const
+{
+  expect(local_vertex < n_local_vertices(), "The vertex " + d2s(local_vertex) + " doesn't belong to the strip");
+  if (local_vertex < owned_beg()) // the ghost row below
+    return n_owned_dofs() + local_vertex;
+  if (local_vertex < owned_end())
+    return local_vertex - owned_beg();
+  return local_vertex; // the ghost row above goes after the owned rows and the ghost row below
+}
+
+
+
+std::vector<int> StripPartition::boundary_dofs() const
+{
+  std::vector<int> b_dofs;
+  for (unsigned int row = _row_beg; row < _row_end; ++row)
+  {
+    for (unsigned int ix = 0; ix <= _nx; ++ix)
+    {
+      if (row == 0 || row == _ny || ix == 0 || ix == _nx)
+        b_dofs.push_back((row - _cell_row_beg) * row_length() + ix);
+    }
+  }
+  return b_dofs;
+}
+
+
+
+bool StripPartition::owns_cell(unsigned int local_cell) const
+{
+  const unsigned int cell_row = _cell_row_beg + local_cell / _nx;
+  return (cell_row >= _row_beg && cell_row < _row_end);
+}
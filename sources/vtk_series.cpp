@@ -0,0 +1,182 @@
+#include "vtk_series.h"
+#include "fem/auxiliary_functions.h"
+#include <fstream>
+#include <algorithm>
+
+
+VTKSeries::VTKSeries(const std::string &dir, const std::string &name,
+                     double x_beg, double y_beg, double hx, double hy,
+                     unsigned int nx, unsigned int cell_row_beg, unsigned int cell_row_end)
+  : _dir(dir),
+    _name(name),
+    _x_beg(x_beg),
+    _y_beg(y_beg),
+    _hx(hx),
+    _hy(hy),
+    _nx(nx),
+    _cell_row_beg(cell_row_beg),
+    _cell_row_end(cell_row_end),
+    _has_coefficients(false),
+    _closed(false)
+{
+  require(_nx > 0 && _cell_row_end > _cell_row_beg, "The grid of the VTK series is empty");
+}
+
+
+
+VTKSeries::~VTKSeries()
+{
+  try
+  {
+    close();
+  }
+  catch (...) // the destructor mustn't throw, and the files of the time steps are kept anyway
+  { }
+}
+
+
+
+unsigned int VTKSeries::n_points() const
+{
+  return (_nx + 1) * (_cell_row_end - _cell_row_beg + 1);
+}
+
+
+
+unsigned int VTKSeries::n_cells() const
+{
+  return _nx * (_cell_row_end - _cell_row_beg);
+}
+
+
+
+std::string VTKSeries::step_file(unsigned int step) const
+{
+  return _name + "-" + d2s(step) + ".vti";
+}
+
+
+
+std::string VTKSeries::coefficients_file() const
+{
+  return _name + "-coef.vti";
+}
+
+
+
+std::string VTKSeries::index_file() const
+{
+  return _name + ".pvd";
+}
+
+
+
+void VTKSeries::write_coefficients(const std::vector<double> &alpha, const std::vector<double> &beta)
+{
+  require(alpha.size() == n_cells() && beta.size() == n_cells(),
+          "The number of the coefficients doesn't correspond to the cells of the VTK series");
+
+  std::vector<std::string> names;
+  names.push_back("coef_alpha");
+  names.push_back("coef_beta");
+  std::vector<const double*> arrays;
+  arrays.push_back(&alpha[0]);
+  arrays.push_back(&beta[0]);
+  write_image(_dir + "/" + coefficients_file(), true, names, arrays, n_cells());
+  _has_coefficients = true;
+}
+
+
+
+void VTKSeries::write_step(unsigned int step, double time, Vec values)
+{
+  PetscInt size;
+  VecGetLocalSize(values, &size);
+  require((unsigned int)size >= n_points(), "The vector has fewer values than the vertices of the VTK series");
+
+  const double *val;
+  VecGetArrayRead(values, &val);
+  write_step(step, time, val);
+  VecRestoreArrayRead(values, &val);
+}
+
+
+
+void VTKSeries::write_step(unsigned int step, double time, const double *values)
+{
+  // the files of different time steps are written independently
+  write_image(_dir + "/" + step_file(step), false, std::vector<std::string>(1, "solution"),
+              std::vector<const double*>(1, values), n_points());
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _steps.push_back(std::make_pair(step, time));
+}
+
+
+
+void VTKSeries::close()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_closed)
+    return;
+  _closed = true;
+
+  std::sort(_steps.begin(), _steps.end()); // the time steps may be written in any order
+
+  const std::string fname = _dir + "/" + index_file();
+  std::ofstream out(fname.c_str());
+  require(out, "File " + fname + " cannot be opened");
+  out.setf(std::ios::scientific);
+  out.precision(16);
+  out << "<?xml version=\"1.0\"?>\n";
+  out << "<VTKFile type=\"Collection\" version=\"0.1\">\n";
+  out << "  <Collection>\n";
+  for (unsigned int s = 0; s < _steps.size(); ++s)
+  {
+    out << "    <DataSet timestep=\"" << _steps[s].second << "\" part=\"0\" file=\"" << step_file(_steps[s].first) << "\"/>\n";
+    if (_has_coefficients) // the same file of the coefficients is the part of each time step
+      out << "    <DataSet timestep=\"" << _steps[s].second << "\" part=\"1\" file=\"" << coefficients_file() << "\"/>\n";
+  }
+  out << "  </Collection>\n";
+  out << "</VTKFile>\n";
+  require(out, "Error while writing the file " + fname);
+  out.close();
+}
+
+
+
+void VTKSeries::write_image(const std::string &fname, bool cell_data, const std::vector<std::string> &names,
+                            const std::vector<const double*> &arrays, uint64_t n_values) const
+{
+  const uint16_t byte_order_test = 1;
+  const bool little_endian = (*reinterpret_cast<const char*>(&byte_order_test) == 1);
+  const std::string extent = "0 " + d2s(_nx) + " " + d2s(_cell_row_beg) + " " + d2s(_cell_row_end) + " 0 0";
+  const uint64_t n_bytes = n_values * sizeof(double);
+
+  std::ofstream out(fname.c_str(), std::ios::binary);
+  require(out, "File " + fname + " cannot be opened");
+  out.precision(16);
+  out << "<?xml version=\"1.0\"?>\n";
+  out << "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\"" << (little_endian ? "LittleEndian" : "BigEndian")
+      << "\" header_type=\"UInt64\">\n";
+  out << "  <ImageData WholeExtent=\"" << extent << "\" Origin=\"" << _x_beg << " " << _y_beg << " 0\" Spacing=\""
+      << _hx << " " << _hy << " 1\">\n";
+  out << "    <Piece Extent=\"" << extent << "\">\n";
+  out << (cell_data ? "      <CellData>\n" : "      <PointData>\n");
+  for (unsigned int a = 0; a < arrays.size(); ++a) // each array is preceded by its size in the appended data
+    out << "        <DataArray type=\"Float64\" Name=\"" << names[a] << "\" format=\"appended\" offset=\""
+        << a * (sizeof(uint64_t) + n_bytes) << "\"/>\n";
+  out << (cell_data ? "      </CellData>\n" : "      </PointData>\n");
+  out << "    </Piece>\n";
+  out << "  </ImageData>\n";
+  out << "  <AppendedData encoding=\"raw\">\n_";
+  for (unsigned int a = 0; a < arrays.size(); ++a)
+  {
+    out.write(reinterpret_cast<const char*>(&n_bytes), sizeof(n_bytes));
+    out.write(reinterpret_cast<const char*>(arrays[a]), n_bytes);
+  }
+  out << "\n  </AppendedData>\n";
+  out << "</VTKFile>\n";
+  require(out, "Error while writing the file " + fname);
+  out.close();
+}